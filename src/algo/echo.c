@@ -719,14 +719,28 @@ echo_small_compress(sph_echo_small_context *sc)
 	COMPRESS_SMALL(sc);
 }
 
-static void
-echo_big_compress(sph_echo_big_context *sc)
+/* see sph_echo.h */
+void (*sph_echo_big_compress_accel)(sph_echo_big_context *sc) = NULL;
+
+/* see sph_echo.h */
+void
+sph_echo_big_compress_portable(sph_echo_big_context *sc)
 {
 	DECL_STATE_BIG
 
 	COMPRESS_BIG(sc);
 }
 
+static void
+echo_big_compress(sph_echo_big_context *sc)
+{
+	if (sph_echo_big_compress_accel != NULL) {
+		sph_echo_big_compress_accel(sc);
+		return;
+	}
+	sph_echo_big_compress_portable(sc);
+}
+
 static void
 echo_small_core(sph_echo_small_context *sc,
 	const unsigned char *data, size_t len)
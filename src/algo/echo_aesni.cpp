@@ -0,0 +1,84 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// ECHO-384/ECHO-512 compression function using AES-NI. This mirrors
+// COMPRESS_BIG in echo.c: every "AES round" of ECHO is a single aesenc.
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <algo/sph_echo.h>
+
+namespace sph_echo_aesni {
+namespace {
+
+__m128i inline Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+__m128i inline Xor(__m128i x, __m128i y, __m128i z) { return Xor(Xor(x, y), z); }
+
+/** Multiply each byte by x in GF(2^8), reduced by the AES polynomial. */
+__m128i inline MulX(__m128i x)
+{
+    const __m128i carry = _mm_cmpgt_epi8(_mm_setzero_si128(), x);
+    return Xor(_mm_add_epi8(x, x), _mm_and_si128(carry, _mm_set1_epi8(0x1b)));
+}
+
+void inline MixColumn(__m128i* W, int ia, int ib, int ic, int id)
+{
+    const __m128i a = W[ia], b = W[ib], c = W[ic], d = W[id];
+    const __m128i ab = Xor(a, b), bc = Xor(b, c), cd = Xor(c, d);
+    const __m128i abx = MulX(ab), bcx = MulX(bc), cdx = MulX(cd);
+    W[ia] = Xor(abx, bc, d);
+    W[ib] = Xor(bcx, a, cd);
+    W[ic] = Xor(cdx, ab, d);
+    W[id] = Xor(Xor(abx, bcx), Xor(cdx, ab), c);
+}
+
+} // namespace
+
+void CompressBig(sph_echo_big_context* sc)
+{
+    __m128i W[16];
+    for (int i = 0; i < 8; ++i) {
+        W[i] = _mm_loadu_si128((const __m128i*)sc->u.Vs[i]);
+        W[i + 8] = _mm_loadu_si128((const __m128i*)(sc->buf + 16 * i));
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t K0 = sc->C0, K1 = sc->C1, K2 = sc->C2, K3 = sc->C3;
+    for (int r = 0; r < 10; ++r) {
+        // BIG_SUB_WORDS: two AES rounds per word, keyed by the running counter.
+        for (int n = 0; n < 16; ++n) {
+            const __m128i key = _mm_set_epi32(K3, K2, K1, K0);
+            W[n] = _mm_aesenc_si128(_mm_aesenc_si128(W[n], key), zero);
+            if (++K0 == 0 && ++K1 == 0 && ++K2 == 0) ++K3;
+        }
+
+        // BIG_SHIFT_ROWS
+        __m128i t = W[1];
+        W[1] = W[5]; W[5] = W[9]; W[9] = W[13]; W[13] = t;
+        t = W[2]; W[2] = W[10]; W[10] = t;
+        t = W[6]; W[6] = W[14]; W[14] = t;
+        t = W[15];
+        W[15] = W[11]; W[11] = W[7]; W[7] = W[3]; W[3] = t;
+
+        // BIG_MIX_COLUMNS
+        MixColumn(W, 0, 1, 2, 3);
+        MixColumn(W, 4, 5, 6, 7);
+        MixColumn(W, 8, 9, 10, 11);
+        MixColumn(W, 12, 13, 14, 15);
+    }
+
+    // FINAL_BIG
+    for (int i = 0; i < 8; ++i) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)sc->u.Vs[i]);
+        const __m128i m = _mm_loadu_si128((const __m128i*)(sc->buf + 16 * i));
+        _mm_storeu_si128((__m128i*)sc->u.Vs[i], Xor(Xor(v, m), Xor(W[i], W[i + 8])));
+    }
+}
+
+} // namespace sph_echo_aesni
+
+#endif
@@ -0,0 +1,244 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/pexa-config.h>
+#endif
+
+#include <algo/hash_algos.h>
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <compat/cpuid.h>
+
+#if defined(ENABLE_AESNI) && !defined(BUILD_PEXA_INTERNAL)
+namespace sph_echo_aesni
+{
+void CompressBig(sph_echo_big_context* sc);
+}
+
+namespace sph_shavite_aesni
+{
+void CompressBig(sph_shavite_big_context* sc, const void* msg);
+}
+#endif
+
+namespace
+{
+/** The sph functions of one primitive, and where its initial state lives. */
+struct X16RPrimitive
+{
+    void (*init)(void*);
+    void (*update)(void*, const void*, size_t);
+    void (*close)(void*, void*);
+    size_t size;
+    int index;
+};
+
+#define X16R_PRIMITIVE(prefix, context, index) {prefix##_init, prefix, prefix##_close, sizeof(context), index}
+
+const X16RPrimitive PRIMITIVES[16] = {
+    X16R_PRIMITIVE(sph_blake512, sph_blake512_context, 0),
+    X16R_PRIMITIVE(sph_bmw512, sph_bmw512_context, 1),
+    X16R_PRIMITIVE(sph_groestl512, sph_groestl512_context, 2),
+    X16R_PRIMITIVE(sph_jh512, sph_jh512_context, 3),
+    X16R_PRIMITIVE(sph_keccak512, sph_keccak512_context, 4),
+    X16R_PRIMITIVE(sph_skein512, sph_skein512_context, 5),
+    X16R_PRIMITIVE(sph_luffa512, sph_luffa512_context, 6),
+    X16R_PRIMITIVE(sph_cubehash512, sph_cubehash512_context, 7),
+    X16R_PRIMITIVE(sph_shavite512, sph_shavite512_context, 8),
+    X16R_PRIMITIVE(sph_simd512, sph_simd512_context, 9),
+    X16R_PRIMITIVE(sph_echo512, sph_echo512_context, 10),
+    X16R_PRIMITIVE(sph_hamsi512, sph_hamsi512_context, 11),
+    X16R_PRIMITIVE(sph_fugue512, sph_fugue512_context, 12),
+    X16R_PRIMITIVE(sph_shabal512, sph_shabal512_context, 13),
+    X16R_PRIMITIVE(sph_whirlpool, sph_whirlpool_context, 14),
+    X16R_PRIMITIVE(sph_sha512, sph_sha512_context, 15),
+};
+
+const X16RPrimitive TIGER = X16R_PRIMITIVE(sph_tiger, sph_tiger_context, 16);
+
+#undef X16R_PRIMITIVE
+
+/** The state of every primitive right after its init function, Tiger last. */
+struct X16RInitialStates
+{
+    X16RContext ctx[17];
+
+    X16RInitialStates()
+    {
+        for (const X16RPrimitive& primitive : PRIMITIVES) {
+            primitive.init(&ctx[primitive.index]);
+        }
+        TIGER.init(&ctx[TIGER.index]);
+    }
+};
+
+const X16RInitialStates& InitialStates()
+{
+    static const X16RInitialStates states;
+    return states;
+}
+
+/** Equivalent to primitive.init(&ctx), copying only the bytes the primitive uses. */
+void Start(X16RContext& ctx, const X16RPrimitive& primitive)
+{
+    memcpy(&ctx, &InitialStates().ctx[primitive.index], primitive.size);
+}
+
+/** X16RV2 runs Tiger in front of Keccak, Luffa and SHA-512. */
+bool TigerFirst(int algo, bool v2)
+{
+    return v2 && (algo == 4 || algo == 6 || algo == 15);
+}
+
+/** The primitive that absorbs the input of round algo. */
+const X16RPrimitive& FirstPrimitive(int algo, bool v2)
+{
+    return TigerFirst(algo, v2) ? TIGER : PRIMITIVES[algo];
+}
+
+/**
+ * Finish round algo once ctx has absorbed its input through FirstPrimitive(),
+ * writing the 64-byte result to out. The input may alias out.
+ */
+void FinishRound(X16RContext& ctx, int algo, bool v2, uint512& out)
+{
+    // Tiger only writes 24 bytes; the rest stays zero as in the reference code.
+    out.SetNull();
+    if (!TigerFirst(algo, v2)) {
+        PRIMITIVES[algo].close(&ctx, out.begin());
+        return;
+    }
+    TIGER.close(&ctx, out.begin());
+    Start(ctx, PRIMITIVES[algo]);
+    PRIMITIVES[algo].update(&ctx, out.begin(), 64);
+    PRIMITIVES[algo].close(&ctx, out.begin());
+}
+
+#if defined(HAVE_GETCPUID) && defined(ENABLE_AESNI) && !defined(BUILD_PEXA_INTERNAL)
+/**
+ * Check that the given compression functions match the portable ones, on a
+ * few chained blocks whose counter carries into the second word. Only local
+ * contexts are used, so this is safe while other threads are hashing.
+ */
+bool SelfTest(void (*echo_compress)(sph_echo_big_context*), void (*shavite_compress)(sph_shavite_big_context*, const void*))
+{
+    sph_echo_big_context echo, echo_expected;
+    sph_shavite_big_context shavite, shavite_expected;
+    memset(&echo, 0, sizeof(echo));
+    memset(&shavite, 0, sizeof(shavite));
+    sph_echo512_init(&echo);
+    sph_shavite512_init(&shavite);
+    memcpy(&echo_expected, &echo, sizeof(echo));
+    memcpy(&shavite_expected, &shavite, sizeof(shavite));
+
+    unsigned char block[128];
+    uint64_t counter = 0xfffffc00;
+    for (int n = 0; n < 4; ++n, counter += 1024) {
+        for (size_t i = 0; i < sizeof(block); ++i) {
+            block[i] = (unsigned char)(i * 131 + n * 17);
+        }
+        echo.C0 = echo_expected.C0 = shavite.count0 = shavite_expected.count0 = (uint32_t)counter;
+        echo.C1 = echo_expected.C1 = shavite.count1 = shavite_expected.count1 = (uint32_t)(counter >> 32);
+        memcpy(echo.buf, block, sizeof(block));
+        memcpy(echo_expected.buf, block, sizeof(block));
+
+        echo_compress(&echo);
+        sph_echo_big_compress_portable(&echo_expected);
+        shavite_compress(&shavite, block);
+        sph_shavite_big_compress_portable(&shavite_expected, block);
+    }
+    return memcmp(&echo, &echo_expected, sizeof(echo)) == 0 &&
+           memcmp(&shavite, &shavite_expected, sizeof(shavite)) == 0;
+}
+#endif
+} // namespace
+
+std::string X16RAutoDetect()
+{
+    std::string ret = "standard";
+#if defined(HAVE_GETCPUID) && defined(ENABLE_AESNI) && !defined(BUILD_PEXA_INTERNAL)
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    const bool have_sse4 = (ecx >> 19) & 1;
+    const bool have_aesni = (ecx >> 25) & 1;
+
+    if (have_sse4 && have_aesni) {
+        assert(SelfTest(sph_echo_aesni::CompressBig, sph_shavite_aesni::CompressBig));
+        sph_echo_big_compress_accel = sph_echo_aesni::CompressBig;
+        sph_shavite_big_compress_accel = sph_shavite_aesni::CompressBig;
+        ret = "aesni(echo,shavite)";
+    }
+#endif
+
+    return ret;
+}
+
+const size_t X16RNonceHasher::LANES;
+
+uint256 X16RHasher::Hash(const void* data, size_t len, const uint256& prev_block_hash, bool v2)
+{
+    for (int i = 0; i < 16; ++i) {
+        const int algo = GetHashSelection(prev_block_hash, i);
+        const X16RPrimitive& first = FirstPrimitive(algo, v2);
+        Start(m_ctx, first);
+        if (i == 0) {
+            first.update(&m_ctx, data, len);
+        } else {
+            first.update(&m_ctx, m_hash.begin(), 64);
+        }
+        FinishRound(m_ctx, algo, v2, m_hash);
+    }
+    return m_hash.trim256();
+}
+
+uint256 X16RHasher::ThreadHash(const void* data, size_t len, const uint256& prev_block_hash, bool v2)
+{
+#if defined(HAVE_THREAD_LOCAL)
+    static thread_local X16RHasher hasher;
+#else
+    X16RHasher hasher;
+#endif
+    return hasher.Hash(data, len, prev_block_hash, v2);
+}
+
+X16RNonceHasher::X16RNonceHasher(const unsigned char* header, const uint256& prev_block_hash, bool v2) : m_v2(v2)
+{
+    for (int i = 0; i < 16; ++i) {
+        m_selection[i] = GetHashSelection(prev_block_hash, i);
+    }
+    const X16RPrimitive& first = FirstPrimitive(m_selection[0], m_v2);
+    Start(m_midstate, first);
+    first.update(&m_midstate, header, 76);
+}
+
+void X16RNonceHasher::Hash(const uint32_t* nonces, size_t count, uint256* hashes) const
+{
+    X16RContext ctx;
+    uint512 hash[LANES];
+    for (size_t base = 0; base < count; base += LANES) {
+        const size_t lanes = std::min(LANES, count - base);
+        for (int i = 0; i < 16; ++i) {
+            const int algo = m_selection[i];
+            const X16RPrimitive& first = FirstPrimitive(algo, m_v2);
+            for (size_t n = 0; n < lanes; ++n) {
+                if (i == 0) {
+                    memcpy(&ctx, &m_midstate, first.size);
+                    first.update(&ctx, &nonces[base + n], sizeof(uint32_t));
+                } else {
+                    Start(ctx, first);
+                    first.update(&ctx, hash[n].begin(), 64);
+                }
+                FinishRound(ctx, algo, m_v2, hash[n]);
+            }
+        }
+        for (size_t n = 0; n < lanes; ++n) {
+            hashes[base + n] = hash[n].trim256();
+        }
+    }
+}
@@ -1550,6 +1550,26 @@ shavite_small_close(sph_shavite_small_context *sc,
 		sph_enc32le((unsigned char *)dst + (u << 2), sc->h[u]);
 }
 
+/* see sph_shavite.h */
+void (*sph_shavite_big_compress_accel)(sph_shavite_big_context *sc, const void *msg) = NULL;
+
+/* see sph_shavite.h */
+void
+sph_shavite_big_compress_portable(sph_shavite_big_context *sc, const void *msg)
+{
+	c512(sc, msg);
+}
+
+static void
+shavite_big_compress(sph_shavite_big_context *sc, const void *msg)
+{
+	if (sph_shavite_big_compress_accel != NULL) {
+		sph_shavite_big_compress_accel(sc, msg);
+		return;
+	}
+	c512(sc, msg);
+}
+
 static void
 shavite_big_init(sph_shavite_big_context *sc, const sph_u32 *iv)
 {
@@ -1590,7 +1610,7 @@ shavite_big_core(sph_shavite_big_context *sc, const void *data, size_t len)
 					}
 				}
 			}
-			c512(sc, buf);
+			shavite_big_compress(sc, buf);
 			ptr = 0;
 		}
 	}
@@ -1624,7 +1644,7 @@ shavite_big_close(sph_shavite_big_context *sc,
 	} else {
 		buf[ptr ++] = z;
 		memset(buf + ptr, 0, 128 - ptr);
-		c512(sc, buf);
+		shavite_big_compress(sc, buf);
 		memset(buf, 0, 110);
 		sc->count0 = sc->count1 = sc->count2 = sc->count3 = 0;
 	}
@@ -1634,7 +1654,7 @@ shavite_big_close(sph_shavite_big_context *sc,
 	sph_enc32le(buf + 122, count3);
 	buf[126] = out_size_w32 << 5;
 	buf[127] = out_size_w32 >> 3;
-	c512(sc, buf);
+	shavite_big_compress(sc, buf);
 	for (u = 0; u < out_size_w32; u ++)
 		sph_enc32le((unsigned char *)dst + (u << 2), sc->h[u]);
 }
@@ -0,0 +1,81 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// SHAvite-384/SHAvite-512 compression function using AES-NI. This mirrors
+// the small-footprint c512() in shavite.c with 128-bit words.
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <algo/sph_shavite.h>
+
+namespace sph_shavite_aesni {
+
+void CompressBig(sph_shavite_big_context* sc, const void* msg)
+{
+    const uint32_t c0 = sc->count0, c1 = sc->count1, c2 = sc->count2, c3 = sc->count3;
+    const __m128i zero = _mm_setzero_si128();
+
+    // Message expansion: 448 words of round keys, as 112 128-bit blocks.
+    __m128i rk[112];
+    for (int i = 0; i < 8; ++i) {
+        rk[i] = _mm_loadu_si128((const __m128i*)((const unsigned char*)msg + 16 * i));
+    }
+    int k = 8;
+    for (;;) {
+        for (int s = 0; s < 8; ++s, ++k) {
+            __m128i x = _mm_aesenc_si128(_mm_shuffle_epi32(rk[k - 8], 0x39), zero);
+            rk[k] = _mm_xor_si128(x, rk[k - 1]);
+            if (k == 8) {
+                rk[k] = _mm_xor_si128(rk[k], _mm_set_epi32(~c3, c2, c1, c0));
+            } else if (k == 41) {
+                rk[k] = _mm_xor_si128(rk[k], _mm_set_epi32(~c0, c1, c2, c3));
+            } else if (k == 79) {
+                rk[k] = _mm_xor_si128(rk[k], _mm_set_epi32(~c1, c0, c3, c2));
+            } else if (k == 110) {
+                rk[k] = _mm_xor_si128(rk[k], _mm_set_epi32(~c2, c3, c0, c1));
+            }
+        }
+        if (k == 112) break;
+        for (int s = 0; s < 8; ++s, ++k) {
+            rk[k] = _mm_xor_si128(rk[k - 8], _mm_alignr_epi8(rk[k - 1], rk[k - 2], 4));
+        }
+    }
+
+    __m128i p0 = _mm_loadu_si128((const __m128i*)&sc->h[0x0]);
+    __m128i p1 = _mm_loadu_si128((const __m128i*)&sc->h[0x4]);
+    __m128i p2 = _mm_loadu_si128((const __m128i*)&sc->h[0x8]);
+    __m128i p3 = _mm_loadu_si128((const __m128i*)&sc->h[0xC]);
+    const __m128i* key = rk;
+    for (int r = 0; r < 14; ++r) {
+        __m128i x = _mm_xor_si128(p1, key[0]);
+        x = _mm_aesenc_si128(x, key[1]);
+        x = _mm_aesenc_si128(x, key[2]);
+        x = _mm_aesenc_si128(x, key[3]);
+        p0 = _mm_xor_si128(p0, _mm_aesenc_si128(x, zero));
+        x = _mm_xor_si128(p3, key[4]);
+        x = _mm_aesenc_si128(x, key[5]);
+        x = _mm_aesenc_si128(x, key[6]);
+        x = _mm_aesenc_si128(x, key[7]);
+        p2 = _mm_xor_si128(p2, _mm_aesenc_si128(x, zero));
+        key += 8;
+
+        const __m128i t = p3;
+        p3 = p2;
+        p2 = p1;
+        p1 = p0;
+        p0 = t;
+    }
+
+    _mm_storeu_si128((__m128i*)&sc->h[0x0], _mm_xor_si128(_mm_loadu_si128((const __m128i*)&sc->h[0x0]), p0));
+    _mm_storeu_si128((__m128i*)&sc->h[0x4], _mm_xor_si128(_mm_loadu_si128((const __m128i*)&sc->h[0x4]), p1));
+    _mm_storeu_si128((__m128i*)&sc->h[0x8], _mm_xor_si128(_mm_loadu_si128((const __m128i*)&sc->h[0x8]), p2));
+    _mm_storeu_si128((__m128i*)&sc->h[0xC], _mm_xor_si128(_mm_loadu_si128((const __m128i*)&sc->h[0xC]), p3));
+}
+
+} // namespace sph_shavite_aesni
+
+#endif
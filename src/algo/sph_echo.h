@@ -312,6 +312,22 @@ void sph_echo512_close(void *cc, void *dst);
  */
 void sph_echo512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
+
+/**
+ * Optional replacement for the ECHO-384/ECHO-512 compression function.
+ * It is installed at startup by <code>X16RAutoDetect()</code> when the
+ * CPU supports a faster implementation (e.g. AES-NI), and must produce
+ * exactly the same output as the portable code. It processes the
+ * 128-byte block held in <code>sc->buf</code>, using the counter already
+ * stored in the context.
+ */
+extern void (*sph_echo_big_compress_accel)(sph_echo_big_context *sc);
+
+/**
+ * The portable ECHO-384/ECHO-512 compression function, which
+ * <code>sph_echo_big_compress_accel</code> replaces.
+ */
+void sph_echo_big_compress_portable(sph_echo_big_context *sc);
 	
 #ifdef __cplusplus
 }
@@ -371,8 +371,9 @@ void sph_sha512_comp(const sph_u64 msg[16], sph_u64 val[8]);
 
 #endif
 
-#endif
 #ifdef __cplusplus
 }
 #endif
 
+#endif
+
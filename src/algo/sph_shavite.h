@@ -306,6 +306,22 @@ void sph_shavite512_close(void *cc, void *dst);
  */
 void sph_shavite512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
+
+/**
+ * Optional replacement for the SHAvite-384/SHAvite-512 compression
+ * function. It is installed at startup by <code>X16RAutoDetect()</code>
+ * when the CPU supports a faster implementation (e.g. AES-NI), and must
+ * produce exactly the same output as the portable code. It compresses
+ * the 128-byte block <code>msg</code> into <code>sc->h</code>, using the
+ * counter already stored in the context.
+ */
+extern void (*sph_shavite_big_compress_accel)(sph_shavite_big_context *sc, const void *msg);
+
+/**
+ * The portable SHAvite-384/SHAvite-512 compression function, which
+ * <code>sph_shavite_big_compress_accel</code> replaces.
+ */
+void sph_shavite_big_compress_portable(sph_shavite_big_context *sc, const void *msg);
 	
 #ifdef __cplusplus
 }
@@ -4,6 +4,7 @@
 
 #include <bench/bench.h>
 
+#include <algo/hash_algos.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 
@@ -74,6 +75,9 @@ int main(int argc, char** argv)
             argsman.GetArg("-plot-height", DEFAULT_PLOT_HEIGHT)));
     }
 
+    // Measure the X16R primitives the node would select at startup.
+    X16RAutoDetect();
+
     benchmark::BenchRunner::RunAll(*printer, evaluations, scaling_factor, regex_filter, is_list_only);
 
     return EXIT_SUCCESS;
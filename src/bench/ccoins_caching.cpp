@@ -5,9 +5,11 @@
 #include <bench/bench.h>
 #include <coins.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <script/signingprovider.h>
 #include <test/util/transaction_utils.h>
 
+#include <unordered_map>
 #include <vector>
 
 // Microbenchmark for simple accesses to a CCoinsViewCache database. Note from
@@ -51,4 +53,78 @@ static void CCoinsCaching(benchmark::State& state)
     ECC_Stop();
 }
 
+
+namespace {
+std::vector<COutPoint> BenchOutpoints(size_t count)
+{
+    FastRandomContext rng(true);
+    std::vector<COutPoint> outpoints;
+    outpoints.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        outpoints.emplace_back(rng.rand256(), rng.randrange(4));
+    }
+    return outpoints;
+}
+
+Coin BenchCoin()
+{
+    CTxOut out(1 * COIN, CScript() << OP_1);
+    return Coin(std::move(out), 1, false);
+}
+
+/** Fill a coins map, look every entry up, then iterate and erase it as BatchWrite does. */
+template <typename Map>
+void FillAndDrain(Map& map, const std::vector<COutPoint>& outpoints)
+{
+    for (const COutPoint& outpoint : outpoints) {
+        map.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(BenchCoin()));
+    }
+    for (const COutPoint& outpoint : outpoints) {
+        assert(map.count(outpoint));
+    }
+    for (auto it = map.begin(); it != map.end(); it = map.erase(it)) {
+    }
+}
+} // namespace
+
+// The same workload on a map with the default allocator, and on CCoinsMap
+// with its pool allocator.
+static void CCoinsMapStdAllocator(benchmark::State& state)
+{
+    const std::vector<COutPoint> outpoints = BenchOutpoints(10000);
+    std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> map;
+    while (state.KeepRunning()) {
+        FillAndDrain(map, outpoints);
+    }
+}
+
+static void CCoinsMapPoolAllocator(benchmark::State& state)
+{
+    const std::vector<COutPoint> outpoints = BenchOutpoints(10000);
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
+    while (state.KeepRunning()) {
+        FillAndDrain(map, outpoints);
+    }
+}
+
+// Add coins to a cache and flush them into its parent, as ConnectTip does.
+static void CCoinsCachingFlush(benchmark::State& state)
+{
+    const std::vector<COutPoint> outpoints = BenchOutpoints(10000);
+    CCoinsView coinsDummy;
+    while (state.KeepRunning()) {
+        CCoinsViewCache parent(&coinsDummy);
+        CCoinsViewCache child(&parent);
+        for (const COutPoint& outpoint : outpoints) {
+            child.AddCoin(outpoint, BenchCoin(), false);
+        }
+        bool flushed = child.Flush();
+        assert(flushed);
+    }
+}
+
 BENCHMARK(CCoinsCaching, 170 * 1000);
+BENCHMARK(CCoinsMapStdAllocator, 50);
+BENCHMARK(CCoinsMapPoolAllocator, 50);
+BENCHMARK(CCoinsCachingFlush, 30);
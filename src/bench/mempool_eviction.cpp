@@ -4,9 +4,11 @@
 
 #include <bench/bench.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <test/util/setup_common.h>
 #include <txmempool.h>
 
+#include <vector>
 
 static void AddTx(const CTransactionRef& tx, const CAmount& nFee, CTxMemPool& pool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
 {
@@ -133,9 +135,58 @@ static void MempoolEviction(benchmark::State& state)
         AddTx(tx5_r, 1000LL, pool);
         AddTx(tx6_r, 1100LL, pool);
         AddTx(tx7_r, 9000LL, pool);
-        pool.TrimToSize(pool.DynamicMemoryUsage() * 3 / 4);
+        pool.TrimToSize(pool.LiveMemoryUsage() * 3 / 4);
         pool.TrimToSize(GetVirtualTransactionSize(*tx1_r));
     }
 }
 
+// Evict from a mempool of a few thousand transactions, chained two to four
+// deep, with random fees. The pool is trimmed in steps of an eighth of its
+// memory usage until it is empty, so the result depends on how much memory
+// each entry takes as well as on the cost of removing it.
+static void MempoolEvictionWide(benchmark::State& state)
+{
+    TestingSetup test_setup{
+        CBaseChainParams::REGTEST,
+        /* extra_args */ {
+            "-nodebuglogfile",
+            "-nodebug",
+        },
+    };
+
+    FastRandomContext det_rand{true};
+    std::vector<std::pair<CTransactionRef, CAmount>> txs;
+    for (int chain = 0; chain < 1000; ++chain) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(det_rand.rand256(), 0);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        const int depth = 2 + det_rand.randrange(3);
+        for (int i = 0; i < depth; ++i) {
+            tx.vout.resize(2);
+            for (auto& out : tx.vout) {
+                out.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+                out.nValue = 10 * COIN;
+            }
+            txs.emplace_back(MakeTransactionRef(tx), 1000 + det_rand.randrange(20000));
+            const uint256 parent = txs.back().first->GetHash();
+            tx.vin[0].prevout = COutPoint(parent, 0);
+        }
+    }
+
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    while (state.KeepRunning()) {
+        for (const auto& tx : txs) {
+            AddTx(tx.first, tx.second, pool);
+        }
+        const size_t usage = pool.LiveMemoryUsage();
+        for (int step = 7; step >= 1; --step) {
+            pool.TrimToSize(usage * step / 8);
+        }
+        pool.TrimToSize(0);
+    }
+}
+
 BENCHMARK(MempoolEviction, 41000);
+BENCHMARK(MempoolEvictionWide, 10);
@@ -26,9 +26,9 @@ struct Available {
     Available(CTransactionRef& ref, size_t tx_count) : ref(ref), tx_count(tx_count){}
 };
 
-static void ComplexMemPool(benchmark::State& state)
+/** A deterministic set of transactions with random dependencies, parents first. */
+static std::vector<CTransactionRef> CreateOrderedCoins(FastRandomContext& det_rand, int childTxs)
 {
-    FastRandomContext det_rand{true};
     std::vector<Available> available_coins;
     std::vector<CTransactionRef> ordered_coins;
     // Create some base transactions
@@ -46,7 +46,7 @@ static void ComplexMemPool(benchmark::State& state)
         ordered_coins.emplace_back(MakeTransactionRef(tx));
         available_coins.emplace_back(ordered_coins.back(), tx_counter++);
     }
-    for (auto x = 0; x < 800 && !available_coins.empty(); ++x) {
+    for (auto x = 0; x < childTxs && !available_coins.empty(); ++x) {
         CMutableTransaction tx = CMutableTransaction();
         size_t n_ancestors = det_rand.randrange(10)+1;
         for (size_t ancestor = 0; ancestor < n_ancestors && !available_coins.empty(); ++ancestor){
@@ -74,6 +74,13 @@ static void ComplexMemPool(benchmark::State& state)
         ordered_coins.emplace_back(MakeTransactionRef(tx));
         available_coins.emplace_back(ordered_coins.back(), tx_counter++);
     }
+    return ordered_coins;
+}
+
+static void ComplexMemPool(benchmark::State& state)
+{
+    FastRandomContext det_rand{true};
+    const std::vector<CTransactionRef> ordered_coins = CreateOrderedCoins(det_rand, 800);
     TestingSetup test_setup;
     CTxMemPool pool;
     LOCK2(cs_main, pool.cs);
@@ -81,9 +88,61 @@ static void ComplexMemPool(benchmark::State& state)
         for (auto& tx : ordered_coins) {
             AddTx(tx, pool);
         }
-        pool.TrimToSize(pool.DynamicMemoryUsage() * 3 / 4);
+        pool.TrimToSize(pool.LiveMemoryUsage() * 3 / 4);
         pool.TrimToSize(GetVirtualTransactionSize(*ordered_coins.front()));
     }
 }
 
+// Add a larger set of dependent transactions and remove them again, parents
+// first, which exercises the links between the entries and the reuse of
+// freed entry memory.
+static void MempoolInsertRemove(benchmark::State& state)
+{
+    FastRandomContext det_rand{true};
+    const std::vector<CTransactionRef> ordered_coins = CreateOrderedCoins(det_rand, 1000);
+    TestingSetup test_setup;
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    while (state.KeepRunning()) {
+        for (auto& tx : ordered_coins) {
+            AddTx(tx, pool);
+        }
+        for (auto& tx : ordered_coins) {
+            pool.removeRecursive(*tx, MemPoolRemovalReason::CONFLICT);
+        }
+        assert(pool.size() == 0);
+    }
+}
+
+// The mempool side of disconnecting a block and connecting it again: its
+// transactions are added back, linked to their descendants that stayed in the
+// mempool, and removed again together. AcceptToMemoryPool, which validates
+// every transaction added back on its own, is not part of this.
+static void MempoolReorg(benchmark::State& state)
+{
+    FastRandomContext det_rand{true};
+    const std::vector<CTransactionRef> ordered_coins = CreateOrderedCoins(det_rand, 1000);
+    const auto block_end = ordered_coins.begin() + ordered_coins.size() / 2;
+    const std::vector<CTransactionRef> block_txs(ordered_coins.begin(), block_end);
+    std::vector<uint256> block_hashes;
+    for (const auto& tx : block_txs) {
+        block_hashes.push_back(tx->GetHash());
+    }
+    TestingSetup test_setup;
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    for (auto it = block_end; it != ordered_coins.end(); ++it) {
+        AddTx(*it, pool);
+    }
+    while (state.KeepRunning()) {
+        for (auto& tx : block_txs) {
+            AddTx(tx, pool);
+        }
+        pool.UpdateTransactionsFromBlock(block_hashes);
+        pool.removeForBlock(block_txs, 1);
+    }
+}
+
 BENCHMARK(ComplexMemPool, 1);
+BENCHMARK(MempoolInsertRemove, 1);
+BENCHMARK(MempoolReorg, 1);
@@ -0,0 +1,142 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <algo/hash_algos.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <uint256.h>
+#include <util/strencodings.h>
+
+#include <string.h>
+
+namespace {
+
+/** A header with the layout of a mainnet header; only nNonce changes between hashes. */
+CBlockHeader BenchHeader()
+{
+    FastRandomContext rng(true);
+    CBlockHeader header;
+    header.nVersion = 0x30000000;
+    header.hashPrevBlock = rng.rand256();
+    header.hashMerkleRoot = rng.rand256();
+    header.nTime = 1600000000;
+    header.nBits = 0x1b0404cb;
+    header.nNonce = 0;
+    return header;
+}
+
+/** A hashPrevBlock that makes all 16 rounds use the same primitive. */
+uint256 FixedSelection(int algo)
+{
+    // The selection nibbles (48..63) live in the first 8 bytes.
+    uint256 prev = FastRandomContext(true).rand256();
+    memset(prev.begin(), algo * 0x11, 8);
+    return prev;
+}
+
+void X16RHeaders(benchmark::State& state, const uint256& prev, bool v2)
+{
+    CBlockHeader header = BenchHeader();
+    header.hashPrevBlock = prev;
+    while (state.KeepRunning()) {
+        ++header.nNonce;
+        if (v2) {
+            HashX16RV2(BEGIN(header.nVersion), END(header.nNonce), header.hashPrevBlock);
+        } else {
+            HashX16R(BEGIN(header.nVersion), END(header.nNonce), header.hashPrevBlock);
+        }
+    }
+}
+
+/** Time one X16R round: a primitive hashing the 64-byte output of the previous one. */
+template <typename Context>
+void SphHash64(benchmark::State& state, void (*init)(void*), void (*update)(void*, const void*, size_t), void (*close)(void*, void*))
+{
+    Context ctx;
+    uint512 hash;
+    while (state.KeepRunning()) {
+        init(&ctx);
+        update(&ctx, hash.begin(), 64);
+        close(&ctx, hash.begin());
+    }
+}
+
+} // namespace
+
+static void X16R(benchmark::State& state) { X16RHeaders(state, BenchHeader().hashPrevBlock, false); }
+static void X16RV2(benchmark::State& state) { X16RHeaders(state, BenchHeader().hashPrevBlock, true); }
+
+/** Mining-style hashing: one iteration hashes a batch of LANES nonces. */
+static void X16R_NonceHasher(benchmark::State& state)
+{
+    const CBlockHeader header = BenchHeader();
+    const X16RNonceHasher hasher((const unsigned char*)BEGIN(header.nVersion), header.hashPrevBlock, false);
+    uint32_t nonces[X16RNonceHasher::LANES];
+    uint256 hashes[X16RNonceHasher::LANES];
+    uint32_t nonce = 0;
+    while (state.KeepRunning()) {
+        for (uint32_t& n : nonces) {
+            n = ++nonce;
+        }
+        hasher.Hash(nonces, X16RNonceHasher::LANES, hashes);
+    }
+}
+
+// Every round on one of the fastest (Skein) or on the slowest (CubeHash)
+// primitive, as measured with the per-primitive benchmarks below.
+static void X16R_BestCase(benchmark::State& state) { X16RHeaders(state, FixedSelection(5), false); }
+static void X16R_WorstCase(benchmark::State& state) { X16RHeaders(state, FixedSelection(7), false); }
+static void X16RV2_BestCase(benchmark::State& state) { X16RHeaders(state, FixedSelection(5), true); }
+static void X16RV2_WorstCase(benchmark::State& state) { X16RHeaders(state, FixedSelection(7), true); }
+
+#define SPH_BENCHMARK(name, context, prefix) \
+    static void name(benchmark::State& state) { SphHash64<context>(state, prefix##_init, prefix, prefix##_close); }
+
+SPH_BENCHMARK(X16R_0_Blake512, sph_blake512_context, sph_blake512)
+SPH_BENCHMARK(X16R_1_BMW512, sph_bmw512_context, sph_bmw512)
+SPH_BENCHMARK(X16R_2_Groestl512, sph_groestl512_context, sph_groestl512)
+SPH_BENCHMARK(X16R_3_JH512, sph_jh512_context, sph_jh512)
+SPH_BENCHMARK(X16R_4_Keccak512, sph_keccak512_context, sph_keccak512)
+SPH_BENCHMARK(X16R_5_Skein512, sph_skein512_context, sph_skein512)
+SPH_BENCHMARK(X16R_6_Luffa512, sph_luffa512_context, sph_luffa512)
+SPH_BENCHMARK(X16R_7_CubeHash512, sph_cubehash512_context, sph_cubehash512)
+SPH_BENCHMARK(X16R_8_SHAvite512, sph_shavite512_context, sph_shavite512)
+SPH_BENCHMARK(X16R_9_SIMD512, sph_simd512_context, sph_simd512)
+SPH_BENCHMARK(X16R_A_Echo512, sph_echo512_context, sph_echo512)
+SPH_BENCHMARK(X16R_B_Hamsi512, sph_hamsi512_context, sph_hamsi512)
+SPH_BENCHMARK(X16R_C_Fugue512, sph_fugue512_context, sph_fugue512)
+SPH_BENCHMARK(X16R_D_Shabal512, sph_shabal512_context, sph_shabal512)
+SPH_BENCHMARK(X16R_E_Whirlpool, sph_whirlpool_context, sph_whirlpool)
+SPH_BENCHMARK(X16R_F_SHA512, sph_sha512_context, sph_sha512)
+SPH_BENCHMARK(X16RV2_Tiger, sph_tiger_context, sph_tiger)
+
+#undef SPH_BENCHMARK
+
+BENCHMARK(X16R, 20 * 1000);
+BENCHMARK(X16RV2, 20 * 1000);
+BENCHMARK(X16R_NonceHasher, 2500);
+BENCHMARK(X16R_BestCase, 100 * 1000);
+BENCHMARK(X16R_WorstCase, 5 * 1000);
+BENCHMARK(X16RV2_BestCase, 100 * 1000);
+BENCHMARK(X16RV2_WorstCase, 5 * 1000);
+
+BENCHMARK(X16R_0_Blake512, 1000 * 1000);
+BENCHMARK(X16R_1_BMW512, 1000 * 1000);
+BENCHMARK(X16R_2_Groestl512, 150 * 1000);
+BENCHMARK(X16R_3_JH512, 150 * 1000);
+BENCHMARK(X16R_4_Keccak512, 350 * 1000);
+BENCHMARK(X16R_5_Skein512, 1000 * 1000);
+BENCHMARK(X16R_6_Luffa512, 120 * 1000);
+BENCHMARK(X16R_7_CubeHash512, 50 * 1000);
+BENCHMARK(X16R_8_SHAvite512, 1000 * 1000);
+BENCHMARK(X16R_9_SIMD512, 100 * 1000);
+BENCHMARK(X16R_A_Echo512, 1000 * 1000);
+BENCHMARK(X16R_B_Hamsi512, 80 * 1000);
+BENCHMARK(X16R_C_Fugue512, 100 * 1000);
+BENCHMARK(X16R_D_Shabal512, 450 * 1000);
+BENCHMARK(X16R_E_Whirlpool, 350 * 1000);
+BENCHMARK(X16R_F_SHA512, 1000 * 1000);
+BENCHMARK(X16RV2_Tiger, 1400 * 1000);
@@ -128,6 +128,10 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
+
+    //! Below the base of a loaded UTXO snapshot: treated as having its transactions
+    //! and being valid, though neither has been checked locally yet.
+    BLOCK_ASSUMED_VALID      =  512,
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -352,6 +356,7 @@ public:
         READWRITE(obj.nNonce);
     }
 
+    //! Recompute the block hash from the header fields. This runs the full proof-of-work hash.
     uint256 GetBlockHash() const
     {
         CBlockHeader block;
@@ -158,6 +158,9 @@ public:
             0
         };
 
+        // No snapshot has been audited for this chain yet.
+        m_assumeutxo_data = MapAssumeutxo{};
+
         /** PEXA Start **/
 
         // DGW Activation.
@@ -257,6 +260,9 @@ public:
             /* dTxRate  */ 0,
         };
 
+        // No snapshot has been audited for this chain yet.
+        m_assumeutxo_data = MapAssumeutxo{};
+
         /** PEXA Start **/
 
         // DGW Activation
@@ -341,6 +347,14 @@ public:
             0
         };
 
+        m_assumeutxo_data = MapAssumeutxo{
+            {
+                // The deterministic chain of TestChain100Setup(true), extended to height 110.
+                110,
+                {uint256S("0x0fd0d77f9f6e8355e1d2c604b60f6ac5db66d733d77e0202bd123c3e79a6ec11"), 111},
+            },
+        };
+
         base58Prefixes[PUBKEY_ADDRESS] = std::vector<unsigned char>(1,111);
         base58Prefixes[SCRIPT_ADDRESS] = std::vector<unsigned char>(1,196);
         base58Prefixes[SECRET_KEY] =     std::vector<unsigned char>(1,239);
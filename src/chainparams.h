@@ -11,6 +11,7 @@
 #include <primitives/block.h>
 #include <protocol.h>
 
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -25,6 +26,20 @@ struct CCheckpointData {
     MapCheckpoints mapCheckpoints;
 };
 
+/**
+ * The UTXO set a snapshot taken at some height must contain to be loaded.
+ * These values are security critical: they decide which snapshots the node
+ * trusts until it has validated the chain up to them itself.
+ */
+struct AssumeutxoData {
+    //! The hash_serialized_2 of the UTXO set (as reported by gettxoutsetinfo).
+    uint256 hash_serialized;
+    //! The nChainTx of the snapshot base block, used to estimate sync progress.
+    unsigned int nChainTx;
+};
+
+typedef std::map<int, AssumeutxoData> MapAssumeutxo;
+
 /**
  * Holds various statistics on transactions within a chain. Used to estimate
  * verification progress during chain sync.
@@ -88,6 +103,8 @@ public:
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
     const ChainTxData& TxData() const { return chainTxData; }
+    /** UTXO snapshots that may be loaded, by base block height */
+    const MapAssumeutxo& Assumeutxo() const { return m_assumeutxo_data; }
 
     /** PEXA START **/
 
@@ -117,6 +134,7 @@ protected:
     bool m_is_mockable_chain;
     CCheckpointData checkpointData;
     ChainTxData chainTxData;
+    MapAssumeutxo m_assumeutxo_data;
 
     /** PEXA Start **/
 
@@ -0,0 +1,278 @@
+// Copyright (c) 2017-2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/muhash.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+
+#include <assert.h>
+#include <limits>
+
+namespace {
+
+using limb_t = Num3072::limb_t;
+using double_limb_t = Num3072::double_limb_t;
+constexpr int LIMB_SIZE = Num3072::LIMB_SIZE;
+constexpr int LIMBS = Num3072::LIMBS;
+/** 2^3072 - 1103717, the largest 3072-bit safe prime number, is used as the modulus. */
+constexpr limb_t MAX_PRIME_DIFF = 1103717;
+
+/** The modular inverse is computed as a^(p - 2). The exponent is split as
+ *  (2^3051 - 1) * 2^21 + INVERSE_EXP_LOW, so that all but the low 21 bits are
+ *  set and can be produced by an addition chain of repunits. */
+constexpr int INVERSE_EXP_ONES = 3051;
+constexpr int INVERSE_EXP_LOW_BITS = 21;
+constexpr uint32_t INVERSE_EXP_LOW = (uint32_t{1} << INVERSE_EXP_LOW_BITS) - MAX_PRIME_DIFF - 2;
+
+/** [c0,c1,c2] += a * b */
+inline void muladd3(limb_t& c0, limb_t& c1, limb_t& c2, const limb_t& a, const limb_t& b)
+{
+    double_limb_t t = (double_limb_t)a * b;
+    limb_t th = t >> LIMB_SIZE;
+    limb_t tl = t;
+
+    c0 += tl;
+    th += (c0 < tl) ? 1 : 0;
+    c1 += th;
+    c2 += (c1 < th) ? 1 : 0;
+}
+
+/** [c0,c1,c2] += 2 * a * b */
+inline void muldbladd3(limb_t& c0, limb_t& c1, limb_t& c2, const limb_t& a, const limb_t& b)
+{
+    double_limb_t t = (double_limb_t)a * b;
+    limb_t th = t >> LIMB_SIZE;
+    limb_t tl = t;
+
+    c0 += tl;
+    limb_t tt = th + ((c0 < tl) ? 1 : 0);
+    c1 += tt;
+    c2 += (c1 < tt) ? 1 : 0;
+    c0 += tl;
+    th += (c0 < tl) ? 1 : 0;
+    c1 += th;
+    c2 += (c1 < th) ? 1 : 0;
+}
+
+/** Reduce a 6144-bit product below 2^3072 into out. As 2^3072 = MAX_PRIME_DIFF
+ *  (mod p), high * 2^3072 + low is congruent to high * MAX_PRIME_DIFF + low. */
+void Reduce(limb_t (&out)[LIMBS], const limb_t (&product)[2 * LIMBS])
+{
+    limb_t carry = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        double_limb_t t = (double_limb_t)product[LIMBS + i] * MAX_PRIME_DIFF + product[i] + carry;
+        out[i] = (limb_t)t;
+        carry = t >> LIMB_SIZE;
+    }
+    // Fold what is left above 2^3072 back in the same way, until nothing is.
+    while (carry) {
+        double_limb_t t = (double_limb_t)carry * MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS && t; ++i) {
+            t += out[i];
+            out[i] = (limb_t)t;
+            t >>= LIMB_SIZE;
+        }
+        carry = (limb_t)t;
+    }
+}
+
+} // namespace
+
+/** Indicates whether the value is not below the modulus. */
+bool Num3072::IsOverflow() const
+{
+    if (this->limbs[0] <= std::numeric_limits<limb_t>::max() - MAX_PRIME_DIFF) return false;
+    for (int i = 1; i < LIMBS; ++i) {
+        if (this->limbs[i] != std::numeric_limits<limb_t>::max()) return false;
+    }
+    return true;
+}
+
+/** Subtract the modulus once, which is enough as the value is below 2^3072. */
+void Num3072::FullReduce()
+{
+    double_limb_t t = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; ++i) {
+        t += this->limbs[i];
+        this->limbs[i] = (limb_t)t;
+        t >>= LIMB_SIZE;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    limb_t tmp[2 * LIMBS];
+
+    // Multiply into a 6144-bit product column by column, accumulating each
+    // column in the three limbs [c0,c1,c2].
+    limb_t c0 = 0, c1 = 0, c2 = 0;
+    for (int k = 0; k < 2 * LIMBS - 1; ++k) {
+        const int begin = k < LIMBS ? 0 : k - LIMBS + 1;
+        const int end = k < LIMBS ? k : LIMBS - 1;
+        for (int i = begin; i <= end; ++i) {
+            muladd3(c0, c1, c2, this->limbs[i], a.limbs[k - i]);
+        }
+        tmp[k] = c0;
+        c0 = c1;
+        c1 = c2;
+        c2 = 0;
+    }
+    tmp[2 * LIMBS - 1] = c0;
+
+    Reduce(this->limbs, tmp);
+}
+
+void Num3072::Square()
+{
+    limb_t tmp[2 * LIMBS];
+
+    // As Multiply(), but every product of two different limbs appears twice.
+    limb_t c0 = 0, c1 = 0, c2 = 0;
+    for (int k = 0; k < 2 * LIMBS - 1; ++k) {
+        for (int i = k < LIMBS ? 0 : k - LIMBS + 1; i < k - i; ++i) {
+            muldbladd3(c0, c1, c2, this->limbs[i], this->limbs[k - i]);
+        }
+        if (k % 2 == 0) muladd3(c0, c1, c2, this->limbs[k / 2], this->limbs[k / 2]);
+        tmp[k] = c0;
+        c0 = c1;
+        c1 = c2;
+        c2 = 0;
+    }
+    tmp[2 * LIMBS - 1] = c0;
+
+    Reduce(this->limbs, tmp);
+}
+
+void Num3072::SetToOne()
+{
+    this->limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i) this->limbs[i] = 0;
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Raise to p - 2 (Fermat's little theorem). First compute the repunit
+    // a^(2^INVERSE_EXP_ONES - 1) by walking the bits of INVERSE_EXP_ONES from
+    // the top, using a^(2^2k - 1) = (a^(2^k - 1))^(2^k) * a^(2^k - 1) and
+    // a^(2^(k+1) - 1) = (a^(2^k - 1))^2 * a.
+    Num3072 out = *this;
+    int ones = 1;
+    int top_bit = 0;
+    while ((INVERSE_EXP_ONES >> (top_bit + 1)) != 0) ++top_bit;
+    for (int bit = top_bit - 1; bit >= 0; --bit) {
+        const Num3072 repunit = out;
+        for (int j = 0; j < ones; ++j) out.Square();
+        out.Multiply(repunit);
+        ones *= 2;
+        if ((INVERSE_EXP_ONES >> bit) & 1) {
+            out.Square();
+            out.Multiply(*this);
+            ++ones;
+        }
+    }
+    assert(ones == INVERSE_EXP_ONES);
+
+    // Then shift in the low bits with plain square-and-multiply.
+    for (int bit = INVERSE_EXP_LOW_BITS - 1; bit >= 0; --bit) {
+        out.Square();
+        if ((INVERSE_EXP_LOW >> bit) & 1) out.Multiply(*this);
+    }
+    return out;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    if (this->IsOverflow()) this->FullReduce();
+
+    Num3072 inv{};
+    if (a.IsOverflow()) {
+        Num3072 b = a;
+        b.FullReduce();
+        inv = b.GetInverse();
+    } else {
+        inv = a.GetInverse();
+    }
+
+    this->Multiply(inv);
+    if (this->IsOverflow()) this->FullReduce();
+}
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            this->limbs[i] = ReadLE32(data + 4 * i);
+        } else if (sizeof(limb_t) == 8) {
+            this->limbs[i] = ReadLE64(data + 8 * i);
+        }
+    }
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE])
+{
+    if (this->IsOverflow()) this->FullReduce();
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            WriteLE32(out + i * 4, this->limbs[i]);
+        } else if (sizeof(limb_t) == 8) {
+            WriteLE64(out + i * 8, this->limbs[i]);
+        }
+    }
+}
+
+Num3072 MuHash3072::ToNum3072(Span<const unsigned char> in)
+{
+    unsigned char tmp[Num3072::BYTE_SIZE];
+
+    unsigned char hashed_in[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(in.data(), in.size()).Finalize(hashed_in);
+    ChaCha20(hashed_in, sizeof(hashed_in)).Keystream(tmp, Num3072::BYTE_SIZE);
+    Num3072 out{tmp};
+
+    return out;
+}
+
+MuHash3072::MuHash3072(Span<const unsigned char> in) noexcept
+{
+    m_numerator = ToNum3072(in);
+}
+
+void MuHash3072::Finalize(uint256& out) const noexcept
+{
+    Num3072 result = m_numerator;
+    result.Divide(m_denominator);
+
+    unsigned char data[Num3072::BYTE_SIZE];
+    result.ToBytes(data);
+
+    CSHA256().Write(data, sizeof(data)).Finalize(out.begin());
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul) noexcept
+{
+    m_numerator.Multiply(mul.m_numerator);
+    m_denominator.Multiply(mul.m_denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div) noexcept
+{
+    m_numerator.Multiply(div.m_denominator);
+    m_denominator.Multiply(div.m_numerator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::Insert(Span<const unsigned char> in) noexcept
+{
+    m_numerator.Multiply(ToNum3072(in));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(Span<const unsigned char> in) noexcept
+{
+    m_denominator.Multiply(ToNum3072(in));
+    return *this;
+}
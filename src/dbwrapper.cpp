@@ -6,6 +6,8 @@
 
 #include <memory>
 #include <random.h>
+#include <sync.h>
+#include <util/strencodings.h>
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -13,6 +15,9 @@
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <set>
 
 class CPexaLevelDBLogger : public leveldb::Logger {
 public:
@@ -72,7 +77,7 @@ public:
     }
 };
 
-static void SetMaxOpenFiles(leveldb::Options *options) {
+static int DefaultMaxOpenFiles() {
     // On most platforms the default setting of max_open_files (which is 1000)
     // is optimal. On Windows using a large file count is OK because the handles
     // do not interfere with select() loops. On 64-bit Unix hosts this value is
@@ -87,42 +92,152 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
     //
     // See PR #12495 for further discussion.
 
-    int default_open_files = options->max_open_files;
+    int max_open_files = leveldb::Options().max_open_files;
 #ifndef WIN32
     if (sizeof(void*) < 8) {
-        options->max_open_files = 64;
+        max_open_files = 64;
     }
 #endif
-    LogPrint(BCLog::LEVELDB, "LevelDB using max_open_files=%d (default=%d)\n",
-             options->max_open_files, default_open_files);
+    return max_open_files;
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+//! Settings -dboption accepts, with the largest value each may take.
+static const std::map<std::string, int64_t> DB_OPTION_LIMITS{
+    {"cache", 1 << 20},
+    {"block_cache", 1 << 20},
+    {"write_buffer", 1024},
+    {"bloom_bits", 32},
+    {"max_file_size", 1024},
+    {"max_open_files", 1 << 20},
+};
+
+/** Split a -dboption value of the form <name>:<setting>=<value>. */
+static bool ParseDBOption(const std::string& arg, std::string& name, std::string& setting, int64_t& value)
+{
+    const size_t colon = arg.find(':');
+    const size_t equals = arg.find('=', colon == std::string::npos ? 0 : colon);
+    if (colon == std::string::npos || colon == 0 || equals == std::string::npos) return false;
+    name = arg.substr(0, colon);
+    setting = arg.substr(colon + 1, equals - colon - 1);
+    const auto limit = DB_OPTION_LIMITS.find(setting);
+    return limit != DB_OPTION_LIMITS.end() && ParseInt64(arg.substr(equals + 1), &value) &&
+           value >= 0 && value <= limit->second;
+}
+
+bool CheckDBOptions(const std::set<std::string>& names, std::string& error)
+{
+    for (const std::string& arg : gArgs.GetArgs("-dboption")) {
+        std::string name, setting;
+        int64_t value;
+        if (!ParseDBOption(arg, name, setting, value)) {
+            error = strprintf("Invalid -dboption '%s'", arg);
+            return false;
+        }
+        if (!names.count(name)) {
+            error = strprintf("Unknown database '%s' in -dboption '%s'", name, arg);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** The LevelDB settings of the database with the given name: derived from
+ *  nCacheSize, unless -dboption overrides them. */
+static DBTuning GetDBTuning(const std::string& name, size_t nCacheSize)
+{
+    std::map<std::string, int64_t> settings;
+    for (const std::string& arg : gArgs.GetArgs("-dboption")) {
+        std::string arg_name, setting;
+        int64_t value;
+        if (ParseDBOption(arg, arg_name, setting, value) && arg_name == name) {
+            settings[setting] = value;
+        }
+    }
+    if (!settings.empty()) {
+        LogPrintf("Applying %u -dboption setting(s) to the %s database\n", settings.size(), name);
+    }
+    if (settings.count("cache")) nCacheSize = settings["cache"] << 20;
+
+    DBTuning tuning;
+    tuning.block_cache_size = nCacheSize / 2;
+    tuning.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+    tuning.max_file_size = leveldb::Options().max_file_size;
+    tuning.max_open_files = DefaultMaxOpenFiles();
+    if (settings.count("block_cache")) tuning.block_cache_size = settings["block_cache"] << 20;
+    if (settings.count("write_buffer")) tuning.write_buffer_size = settings["write_buffer"] << 20;
+    if (settings.count("bloom_bits")) tuning.bloom_bits = settings["bloom_bits"];
+    if (settings.count("max_file_size")) tuning.max_file_size = settings["max_file_size"] << 20;
+    if (settings.count("max_open_files")) tuning.max_open_files = settings["max_open_files"];
+    return tuning;
+}
+
+static leveldb::Options GetOptions(const DBTuning& tuning)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.block_cache = leveldb::NewLRUCache(tuning.block_cache_size);
+    options.write_buffer_size = tuning.write_buffer_size;
+    options.filter_policy = tuning.bloom_bits > 0 ? leveldb::NewBloomFilterPolicy(tuning.bloom_bits) : nullptr;
     options.compression = leveldb::kNoCompression;
+    options.max_file_size = tuning.max_file_size;
+    options.max_open_files = tuning.max_open_files;
     options.info_log = new CPexaLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
         options.paranoid_checks = true;
     }
-    SetMaxOpenFiles(&options);
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
-    : m_name{path.stem().string()}
+static Mutex g_dbwrappers_mutex;
+//! Every open database, for ForEachDBWrapper.
+static std::set<CDBWrapper*> g_dbwrappers GUARDED_BY(g_dbwrappers_mutex);
+//! Number of ForEachDBWrapperNamed calls using each database; it is not closed until they are done.
+static std::map<const CDBWrapper*, int> g_dbwrapper_users GUARDED_BY(g_dbwrappers_mutex);
+static std::condition_variable g_dbwrappers_cv;
+
+void ForEachDBWrapper(const std::function<void(CDBWrapper&)>& fn)
+{
+    LOCK(g_dbwrappers_mutex);
+    for (CDBWrapper* dbw : g_dbwrappers) {
+        fn(*dbw);
+    }
+}
+
+bool ForEachDBWrapperNamed(const std::string& name, const std::function<void(CDBWrapper&)>& fn)
+{
+    std::vector<CDBWrapper*> dbws;
+    {
+        LOCK(g_dbwrappers_mutex);
+        for (CDBWrapper* dbw : g_dbwrappers) {
+            if (dbw->GetName() != name) continue;
+            dbws.push_back(dbw);
+            ++g_dbwrapper_users[dbw];
+        }
+    }
+    for (CDBWrapper* dbw : dbws) {
+        fn(*dbw);
+        LOCK(g_dbwrappers_mutex);
+        if (--g_dbwrapper_users[dbw] == 0) {
+            g_dbwrapper_users.erase(dbw);
+            g_dbwrappers_cv.notify_all();
+        }
+    }
+    return !dbws.empty();
+}
+
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const std::string& name)
+    : m_name{name.empty() ? path.stem().string() : name}, m_path{path}, m_tuning{GetDBTuning(m_name, nCacheSize)}
 {
     penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(m_tuning);
+    LogPrint(BCLog::LEVELDB, "LevelDB settings for %s: block_cache=%.1fMiB write_buffer=%.1fMiB bloom_bits=%d max_file_size=%.1fMiB max_open_files=%d\n",
+             m_name, m_tuning.block_cache_size * (1.0 / 1024 / 1024), m_tuning.write_buffer_size * (1.0 / 1024 / 1024),
+             m_tuning.bloom_bits, m_tuning.max_file_size * (1.0 / 1024 / 1024), m_tuning.max_open_files);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -141,9 +256,7 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     LogPrintf("Opened LevelDB successfully\n");
 
     if (gArgs.GetBoolArg("-forcecompactdb", false)) {
-        LogPrintf("Starting database compaction of %s\n", path.string());
-        pdb->CompactRange(nullptr, nullptr);
-        LogPrintf("Finished database compaction of %s\n", path.string());
+        CompactFull();
     }
 
     // The base-case obfuscation key, which is a noop.
@@ -164,10 +277,18 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     }
 
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
+
+    LOCK(g_dbwrappers_mutex);
+    g_dbwrappers.insert(this);
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    {
+        WAIT_LOCK(g_dbwrappers_mutex, lock);
+        g_dbwrappers.erase(this);
+        g_dbwrappers_cv.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(g_dbwrappers_mutex) { return g_dbwrapper_users.count(this) == 0; });
+    }
     delete pdb;
     pdb = nullptr;
     delete options.filter_policy;
@@ -206,6 +327,18 @@ size_t CDBWrapper::DynamicMemoryUsage() const {
     return stoul(memory);
 }
 
+bool CDBWrapper::GetProperty(const std::string& property, std::string& value) const
+{
+    return pdb->GetProperty(property, &value);
+}
+
+void CDBWrapper::CompactFull() const
+{
+    LogPrintf("Starting database compaction of %s\n", m_path.string());
+    pdb->CompactRange(nullptr, nullptr);
+    LogPrintf("Finished database compaction of %s\n", m_path.string());
+}
+
 // Prefixed with null character to avoid collisions with other keys
 //
 // We must use a string constructor which specifies length so that we copy
@@ -15,6 +15,9 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+#include <functional>
+#include <set>
+
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 
@@ -26,6 +29,27 @@ public:
 
 class CDBWrapper;
 
+/** The LevelDB settings of a database, which can be overridden per database with -dboption. */
+struct DBTuning {
+    //! Size of the LevelDB block cache, in bytes.
+    size_t block_cache_size{0};
+    //! Size of the LevelDB write buffer, in bytes. Up to two may be held in memory.
+    size_t write_buffer_size{0};
+    //! Bits per key of the bloom filter, or 0 to build no filters.
+    int bloom_bits{10};
+    //! Size at which LevelDB starts a new table file, in bytes.
+    size_t max_file_size{0};
+    //! Number of table files LevelDB may keep open.
+    int max_open_files{0};
+};
+
+/**
+ * Check the syntax of the -dboption settings, and that each names one of the
+ * given databases.
+ * @returns false, with error set, if one of them is invalid
+ */
+bool CheckDBOptions(const std::set<std::string>& names, std::string& error);
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -200,6 +224,12 @@ private:
     //! the name of this database
     std::string m_name;
 
+    //! the location of this database
+    fs::path m_path;
+
+    //! the LevelDB settings in use
+    DBTuning m_tuning;
+
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
@@ -219,8 +249,10 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] name        Name under which -dboption settings apply to the database, and which
+     *                        logs and RPCs refer to it by. Defaults to the last component of path.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const std::string& name = {});
     ~CDBWrapper();
 
     CDBWrapper(const CDBWrapper&) = delete;
@@ -314,6 +346,21 @@ public:
      */
     bool IsEmpty();
 
+    const std::string& GetName() const { return m_name; }
+
+    const fs::path& GetPath() const { return m_path; }
+
+    const DBTuning& GetTuning() const { return m_tuning; }
+
+    /**
+     * Read a LevelDB property of the database, e.g. "leveldb.stats".
+     * @returns false if the property is not known
+     */
+    bool GetProperty(const std::string& property, std::string& value) const;
+
+    /** Compact the whole database. This may take a long time on large databases. */
+    void CompactFull() const;
+
     template<typename K>
     size_t EstimateSize(const K& key_begin, const K& key_end) const
     {
@@ -348,4 +395,17 @@ public:
 
 };
 
+/**
+ * Call fn on every open database. Databases cannot be closed while this runs,
+ * so fn should not wait on anything that may be closing one.
+ */
+void ForEachDBWrapper(const std::function<void(CDBWrapper&)>& fn);
+
+/**
+ * Call fn on every open database with the given name, without keeping other
+ * databases from being opened or closed meanwhile; closing one of those
+ * databases waits for fn to return. Returns whether any database had the name.
+ */
+bool ForEachDBWrapperNamed(const std::string& name, const std::function<void(CDBWrapper&)>& fn);
+
 #endif // PEXA_DBWRAPPER_H
@@ -0,0 +1,53 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <headerhashcache.h>
+
+#include <crypto/siphash.h>
+#include <random.h>
+#include <util/strencodings.h>
+
+#include <assert.h>
+#include <string.h>
+
+#include <limits>
+
+HeaderHashCache::HeaderHashCache(size_t sets) : m_k0(GetRand(std::numeric_limits<uint64_t>::max())), m_k1(GetRand(std::numeric_limits<uint64_t>::max())), m_sets(sets), m_entries(2 * sets), m_recent(sets, 0)
+{
+    assert(sets > 0);
+}
+
+uint256 HeaderHashCache::GetHash(const CBlockHeader& header)
+{
+    const unsigned char* bytes = (const unsigned char*)BEGIN(header.nVersion);
+    const size_t set = CSipHasher(m_k0, m_k1).Write(bytes, sizeof(Entry::header)).Finalize() % m_sets;
+
+    {
+        LOCK(m_mutex);
+        for (int way = 0; way < 2; ++way) {
+            const Entry& entry = m_entries[2 * set + way];
+            if (entry.valid && memcmp(entry.header, bytes, sizeof(entry.header)) == 0) {
+                m_recent[set] = way;
+                return entry.hash;
+            }
+        }
+    }
+
+    const uint256 hash = header.GetHash();
+
+    LOCK(m_mutex);
+    const int victim = 1 - m_recent[set];
+    Entry& entry = m_entries[2 * set + victim];
+    memcpy(entry.header, bytes, sizeof(entry.header));
+    entry.hash = hash;
+    entry.valid = true;
+    m_recent[set] = victim;
+    return hash;
+}
+
+uint256 GetCachedHeaderHash(const CBlockHeader& header)
+{
+    static HeaderHashCache cache(HEADER_HASH_CACHE_SETS);
+    return cache.GetHash(header);
+}
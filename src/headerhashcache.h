@@ -0,0 +1,55 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PEXA_HEADERHASHCACHE_H
+#define PEXA_HEADERHASHCACHE_H
+
+#include <primitives/block.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <vector>
+
+/** Number of two-entry sets in the global header hash cache (about 2MB) */
+static const size_t HEADER_HASH_CACHE_SETS = 1 << 13;
+
+/**
+ * Bounded map from the 80 header bytes to the header's proof-of-work hash,
+ * so that the same header relayed by many peers (in headers, cmpctblock and
+ * block messages) is only hashed once.
+ *
+ * The cache is two-way set associative with least-recently-used replacement
+ * within each set. Sets are picked by a SipHash of the header with a random
+ * key, so peers cannot aim headers at one set to evict others.
+ */
+class HeaderHashCache
+{
+private:
+    struct Entry {
+        unsigned char header[80];
+        uint256 hash;
+        bool valid{false};
+    };
+
+    const uint64_t m_k0;
+    const uint64_t m_k1;
+    const size_t m_sets;
+
+    mutable Mutex m_mutex;
+    std::vector<Entry> m_entries GUARDED_BY(m_mutex);
+    //! Per set, the way that was used most recently
+    std::vector<uint8_t> m_recent GUARDED_BY(m_mutex);
+
+public:
+    explicit HeaderHashCache(size_t sets);
+
+    /** Return the hash of header, computing it only if it is not cached. */
+    uint256 GetHash(const CBlockHeader& header);
+};
+
+/** Return the hash of header through the global header hash cache. */
+uint256 GetCachedHeaderHash(const CBlockHeader& header);
+
+#endif // PEXA_HEADERHASHCACHE_H
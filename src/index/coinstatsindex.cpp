@@ -0,0 +1,369 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <coins.h>
+#include <index/coinstatsindex.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* The index database stores the UTXO set statistics of each block. Like in the
+ * block filter index, entries of blocks on the active chain are keyed by height,
+ * and those of blocks that were reorganized out of it by block hash.
+ *
+ * The MuHash3072 of the UTXO set at the best block of the index is stored under
+ * DB_MUHASH, so that syncing can continue from there.
+ *
+ * Keys for the height index have the type [DB_BLOCK_HEIGHT, uint32 (BE)].
+ * Keys for the hash index have the type [DB_BLOCK_HASH, uint256].
+ */
+constexpr char DB_BLOCK_HASH = 's';
+constexpr char DB_BLOCK_HEIGHT = 't';
+constexpr char DB_MUHASH = 'M';
+
+namespace {
+
+struct DBVal {
+    uint256 muhash;
+    uint64_t transaction_output_count;
+    uint64_t bogo_size;
+    CAmount total_amount;
+    CAmount total_subsidy;
+    CAmount total_unspendable_amount;
+    CAmount total_prevout_spent_amount;
+    CAmount total_new_outputs_ex_coinbase_amount;
+    CAmount total_coinbase_amount;
+    CAmount total_unspendables_genesis_block;
+    CAmount total_unspendables_scripts;
+    CAmount total_unspendables_unclaimed_rewards;
+
+    SERIALIZE_METHODS(DBVal, obj)
+    {
+        READWRITE(obj.muhash);
+        READWRITE(obj.transaction_output_count);
+        READWRITE(obj.bogo_size);
+        READWRITE(obj.total_amount);
+        READWRITE(obj.total_subsidy);
+        READWRITE(obj.total_unspendable_amount);
+        READWRITE(obj.total_prevout_spent_amount);
+        READWRITE(obj.total_new_outputs_ex_coinbase_amount);
+        READWRITE(obj.total_coinbase_amount);
+        READWRITE(obj.total_unspendables_genesis_block);
+        READWRITE(obj.total_unspendables_scripts);
+        READWRITE(obj.total_unspendables_unclaimed_rewards);
+    }
+};
+
+struct DBHeightKey {
+    int height;
+
+    explicit DBHeightKey(int height_in) : height(height_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_BLOCK_HEIGHT);
+        ser_writedata32be(s, height);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_BLOCK_HEIGHT) {
+            throw std::ios_base::failure("Invalid format for coinstatsindex DB height key");
+        }
+        height = ser_readdata32be(s);
+    }
+};
+
+struct DBHashKey {
+    uint256 block_hash;
+
+    explicit DBHashKey(const uint256& hash_in) : block_hash(hash_in) {}
+
+    SERIALIZE_METHODS(DBHashKey, obj) {
+        char prefix = DB_BLOCK_HASH;
+        READWRITE(prefix);
+        if (prefix != DB_BLOCK_HASH) {
+            throw std::ios_base::failure("Invalid format for coinstatsindex DB hash key");
+        }
+
+        READWRITE(obj.block_hash);
+    }
+};
+
+}; // namespace
+
+std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
+
+CoinStatsIndex::CoinStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+{
+    fs::path path = GetDataDir() / "indexes" / "coinstats";
+    fs::create_directories(path);
+
+    m_db = MakeUnique<BaseIndex::DB>(path / "db", n_cache_size, f_memory, f_wipe, false, "coinstatsindex");
+}
+
+bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    const CAmount block_subsidy = GetBlockSubsidy(pindex->nHeight, Params().GetConsensus());
+    m_total_subsidy += block_subsidy;
+
+    if (pindex->nHeight == 0) {
+        // The genesis block outputs are not added to the UTXO set.
+        m_total_unspendable_amount += block_subsidy;
+        m_total_unspendables_genesis_block += block_subsidy;
+    } else {
+        CBlockUndo block_undo;
+        if (!UndoReadFromDisk(block_undo, pindex)) {
+            return false;
+        }
+
+        std::pair<uint256, DBVal> read_out;
+        if (!m_db->Read(DBHeightKey(pindex->nHeight - 1), read_out)) {
+            return false;
+        }
+
+        uint256 expected_block_hash = pindex->pprev->GetBlockHash();
+        if (read_out.first != expected_block_hash) {
+            return error("%s: previous block header belongs to unexpected block %s; expected %s",
+                         __func__, read_out.first.ToString(), expected_block_hash.ToString());
+        }
+
+        if (!m_stats.ApplyBlock(block, block_undo, pindex->nHeight, /* connect */ true)) {
+            return error("%s: undo data of block %s does not match the block",
+                         __func__, pindex->GetBlockHash().ToString());
+        }
+
+        CAmount block_prevout_spent_amount = 0;
+        CAmount block_created_amount = 0;
+        for (size_t i = 0; i < block.vtx.size(); ++i) {
+            const CTransaction& tx = *block.vtx[i];
+            for (const CTxOut& out : tx.vout) {
+                block_created_amount += out.nValue;
+                if (out.scriptPubKey.IsUnspendable()) {
+                    m_total_unspendable_amount += out.nValue;
+                    m_total_unspendables_scripts += out.nValue;
+                } else if (tx.IsCoinBase()) {
+                    m_total_coinbase_amount += out.nValue;
+                } else {
+                    m_total_new_outputs_ex_coinbase_amount += out.nValue;
+                }
+            }
+            if (tx.IsCoinBase()) continue;
+            for (const Coin& coin : block_undo.vtxundo[i - 1].vprevout) {
+                block_prevout_spent_amount += coin.out.nValue;
+            }
+        }
+        m_total_prevout_spent_amount += block_prevout_spent_amount;
+
+        // Whatever the coinbase left of the subsidy and the fees is gone for good.
+        const CAmount unclaimed_rewards = block_prevout_spent_amount + block_subsidy - block_created_amount;
+        m_total_unspendable_amount += unclaimed_rewards;
+        m_total_unspendables_unclaimed_rewards += unclaimed_rewards;
+    }
+
+    std::pair<uint256, DBVal> value;
+    value.first = pindex->GetBlockHash();
+    m_stats.m_muhash.Finalize(value.second.muhash);
+    value.second.transaction_output_count = m_stats.m_coins_count;
+    value.second.bogo_size = m_stats.m_bogo_size;
+    value.second.total_amount = m_stats.m_total_amount;
+    value.second.total_subsidy = m_total_subsidy;
+    value.second.total_unspendable_amount = m_total_unspendable_amount;
+    value.second.total_prevout_spent_amount = m_total_prevout_spent_amount;
+    value.second.total_new_outputs_ex_coinbase_amount = m_total_new_outputs_ex_coinbase_amount;
+    value.second.total_coinbase_amount = m_total_coinbase_amount;
+    value.second.total_unspendables_genesis_block = m_total_unspendables_genesis_block;
+    value.second.total_unspendables_scripts = m_total_unspendables_scripts;
+    value.second.total_unspendables_unclaimed_rewards = m_total_unspendables_unclaimed_rewards;
+
+    return m_db->Write(DBHeightKey(pindex->nHeight), value);
+}
+
+static bool CopyHeightIndexToHashIndex(CDBIterator& db_it, CDBBatch& batch,
+                                       const std::string& index_name,
+                                       int start_height, int stop_height)
+{
+    DBHeightKey key(start_height);
+    db_it.Seek(key);
+
+    for (int height = start_height; height <= stop_height; ++height) {
+        if (!db_it.GetKey(key) || key.height != height) {
+            return error("%s: unexpected key in %s: expected (%c, %d)",
+                         __func__, index_name, DB_BLOCK_HEIGHT, height);
+        }
+
+        std::pair<uint256, DBVal> value;
+        if (!db_it.GetValue(value)) {
+            return error("%s: unable to read value in %s at key (%c, %d)",
+                         __func__, index_name, DB_BLOCK_HEIGHT, height);
+        }
+
+        batch.Write(DBHashKey(value.first), std::move(value.second));
+
+        db_it.Next();
+    }
+    return true;
+}
+
+bool CoinStatsIndex::ReverseBlock(const CBlockIndex* pindex)
+{
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+        return error("%s: Failed to read block %s from disk",
+                     __func__, pindex->GetBlockHash().ToString());
+    }
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        return error("%s: Failed to read undo data of block %s from disk",
+                     __func__, pindex->GetBlockHash().ToString());
+    }
+    if (!m_stats.ApplyBlock(block, block_undo, pindex->nHeight, /* connect */ false)) {
+        return error("%s: undo data of block %s does not match the block",
+                     __func__, pindex->GetBlockHash().ToString());
+    }
+    return true;
+}
+
+bool CoinStatsIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    CDBBatch batch(*m_db);
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+
+    // During a reorg, we need to copy all stats for blocks that are getting disconnected from the
+    // height index to the hash index so we can still find them when the height index entries are
+    // overwritten.
+    if (!CopyHeightIndexToHashIndex(*db_it, batch, GetName(), new_tip->nHeight, current_tip->nHeight)) {
+        return false;
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        if (!ReverseBlock(pindex)) return false;
+    }
+    if (!LoadTotals(new_tip)) return false;
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+static bool LookUpOne(const CDBWrapper& db, const CBlockIndex* block_index, DBVal& result)
+{
+    // First check if the result is stored under the height index and the value there matches the
+    // block hash. This should be the case if the block is on the active chain.
+    std::pair<uint256, DBVal> read_out;
+    if (!db.Read(DBHeightKey(block_index->nHeight), read_out)) {
+        return false;
+    }
+    if (read_out.first == block_index->GetBlockHash()) {
+        result = std::move(read_out.second);
+        return true;
+    }
+
+    // If value at the height index corresponds to an different block, the result will be stored in
+    // the hash index.
+    return db.Read(DBHashKey(block_index->GetBlockHash()), result);
+}
+
+bool CoinStatsIndex::LoadTotals(const CBlockIndex* pindex)
+{
+    DBVal entry;
+    if (!LookUpOne(*m_db, pindex, entry)) {
+        return error("%s: Cannot read the %s entry of block %s",
+                     __func__, GetName(), pindex->GetBlockHash().ToString());
+    }
+
+    uint256 muhash;
+    m_stats.m_muhash.Finalize(muhash);
+    if (muhash != entry.muhash) {
+        return error("%s: UTXO set hash of the %s does not match block %s; index may be corrupted",
+                     __func__, GetName(), pindex->GetBlockHash().ToString());
+    }
+
+    m_stats.m_coins_count = entry.transaction_output_count;
+    m_stats.m_bogo_size = entry.bogo_size;
+    m_stats.m_total_amount = entry.total_amount;
+    m_total_subsidy = entry.total_subsidy;
+    m_total_unspendable_amount = entry.total_unspendable_amount;
+    m_total_prevout_spent_amount = entry.total_prevout_spent_amount;
+    m_total_new_outputs_ex_coinbase_amount = entry.total_new_outputs_ex_coinbase_amount;
+    m_total_coinbase_amount = entry.total_coinbase_amount;
+    m_total_unspendables_genesis_block = entry.total_unspendables_genesis_block;
+    m_total_unspendables_scripts = entry.total_unspendables_scripts;
+    m_total_unspendables_unclaimed_rewards = entry.total_unspendables_unclaimed_rewards;
+    return true;
+}
+
+bool CoinStatsIndex::LookUpStats(const CBlockIndex* block_index, CCoinsStats& coins_stats) const
+{
+    DBVal entry;
+    if (!LookUpOne(*m_db, block_index, entry)) {
+        return false;
+    }
+
+    coins_stats.hashBlock = block_index->GetBlockHash();
+    coins_stats.nHeight = block_index->nHeight;
+    coins_stats.hashSerialized = entry.muhash;
+    coins_stats.nTransactionOutputs = entry.transaction_output_count;
+    coins_stats.coins_count = entry.transaction_output_count;
+    coins_stats.nBogoSize = entry.bogo_size;
+    coins_stats.nTotalAmount = entry.total_amount;
+    coins_stats.index_used = true;
+    coins_stats.total_subsidy = entry.total_subsidy;
+    coins_stats.total_unspendable_amount = entry.total_unspendable_amount;
+    coins_stats.total_prevout_spent_amount = entry.total_prevout_spent_amount;
+    coins_stats.total_new_outputs_ex_coinbase_amount = entry.total_new_outputs_ex_coinbase_amount;
+    coins_stats.total_coinbase_amount = entry.total_coinbase_amount;
+    coins_stats.total_unspendables_genesis_block = entry.total_unspendables_genesis_block;
+    coins_stats.total_unspendables_scripts = entry.total_unspendables_scripts;
+    coins_stats.total_unspendables_unclaimed_rewards = entry.total_unspendables_unclaimed_rewards;
+    return true;
+}
+
+bool CoinStatsIndex::Init()
+{
+    if (!m_db->Read(DB_MUHASH, m_stats.m_muhash)) {
+        // Check that the cause of the read failure is that the key does not exist. Any other errors
+        // indicate database corruption or a disk failure, and starting the index would cause
+        // further corruption.
+        if (m_db->Exists(DB_MUHASH)) {
+            return error("%s: Cannot read current %s state; index may be corrupted",
+                         __func__, GetName());
+        }
+    }
+
+    CBlockLocator locator;
+    if (!GetDB().ReadBestBlock(locator)) {
+        locator.SetNull();
+    }
+    if (!BaseIndex::Init()) return false;
+
+    const CBlockIndex* pindex = CurrentIndex();
+    if (!pindex) return true;
+
+    // DB_MUHASH was committed along with the locator. If the chain was
+    // reorganized while the index was not running, take the blocks that are
+    // no longer on the active chain back out of it.
+    const CBlockIndex* committed_tip = WITH_LOCK(cs_main, return LookupBlockIndex(locator.vHave.front()));
+    if (!committed_tip || committed_tip->GetAncestor(pindex->nHeight) != pindex) {
+        return error("%s: Best block of the %s is not known", __func__, GetName());
+    }
+    for (const CBlockIndex* block = committed_tip; block != pindex; block = block->pprev) {
+        if (!ReverseBlock(block)) return false;
+    }
+
+    return LoadTotals(pindex);
+}
+
+bool CoinStatsIndex::CommitInternal(CDBBatch& batch)
+{
+    // DB_MUHASH should always be committed in a batch together with the best
+    // block locator, so that the two stay in step.
+    batch.Write(DB_MUHASH, m_stats.m_muhash);
+    return BaseIndex::CommitInternal(batch);
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PEXA_INDEX_COINSTATSINDEX_H
+#define PEXA_INDEX_COINSTATSINDEX_H
+
+#include <chain.h>
+#include <index/base.h>
+#include <node/coinstats.h>
+
+static constexpr bool DEFAULT_COINSTATSINDEX{false};
+
+/**
+ * CoinStatsIndex maintains statistics on the UTXO set for every block of the
+ * chain: the MuHash of the set, its output count, bogo size and total amount,
+ * and running totals of the subsidy, of the amounts spent and created, and of
+ * the amounts that became unspendable. It makes gettxoutsetinfo at any height
+ * a single database lookup instead of a scan of the coins database.
+ */
+class CoinStatsIndex final : public BaseIndex
+{
+private:
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+    //! The UTXO set at the current best block of the index.
+    RollingCoinsStats m_stats;
+
+    //! Running totals up to the current best block of the index.
+    CAmount m_total_subsidy{0};
+    CAmount m_total_unspendable_amount{0};
+    CAmount m_total_prevout_spent_amount{0};
+    CAmount m_total_new_outputs_ex_coinbase_amount{0};
+    CAmount m_total_coinbase_amount{0};
+    CAmount m_total_unspendables_genesis_block{0};
+    CAmount m_total_unspendables_scripts{0};
+    CAmount m_total_unspendables_unclaimed_rewards{0};
+
+    //! Take the coins of a disconnected block out of m_stats.
+    bool ReverseBlock(const CBlockIndex* pindex);
+
+    //! Reset the running totals to the entry stored for pindex, and check that
+    //! m_stats matches it.
+    bool LoadTotals(const CBlockIndex* pindex);
+
+protected:
+    bool Init() override;
+
+    bool CommitInternal(CDBBatch& batch) override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "coinstatsindex"; }
+
+public:
+    /** Constructs the index, which becomes available to be queried. */
+    explicit CoinStatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /** Look up the statistics of the UTXO set after block_index was connected. */
+    bool LookUpStats(const CBlockIndex* block_index, CCoinsStats& coins_stats) const;
+};
+
+/// The global UTXO set statistics index. May be null.
+extern std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
+
+#endif // PEXA_INDEX_COINSTATSINDEX_H
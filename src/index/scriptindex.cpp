@@ -0,0 +1,255 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <compressor.h>
+#include <hash.h>
+#include <index/scriptindex.h>
+#include <script/script.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* The index database stores two tables, both keyed by the Hash160 of the
+ * output script so that all entries of a script are adjacent:
+ *
+ * - the history, with an entry for every output paying to the script and for
+ *   every input spending such an output. Keys have the type
+ *   [DB_HISTORY, uint160, uint32 height (BE), uint32 tx position (BE),
+ *   uint8 spending, uint32 n (BE)], so that entries sort in the order they
+ *   were confirmed. Values hold the txid and the compressed amount.
+ *
+ * - the outputs paying to the script that are unspent at the best block of the
+ *   index. Keys have the type [DB_UNSPENT, uint160, COutPoint], and values
+ *   hold the height and coinbase flag as in Coin, and the compressed amount.
+ *
+ * Entries of blocks that are disconnected are removed, so only the active
+ * chain is indexed. Outputs with provably unspendable scripts and the genesis
+ * block are not indexed.
+ */
+constexpr char DB_HISTORY = 'h';
+constexpr char DB_UNSPENT = 'u';
+
+namespace {
+
+struct DBHistoryKey {
+    uint160 script_id;
+    uint32_t height;
+    uint32_t tx_pos;
+    uint8_t spending;
+    uint32_t n;
+
+    DBHistoryKey(const uint160& script_id_in, int height_in, uint32_t tx_pos_in, bool spending_in, uint32_t n_in) :
+        script_id(script_id_in), height(height_in), tx_pos(tx_pos_in), spending(spending_in), n(n_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_HISTORY);
+        s << script_id;
+        ser_writedata32be(s, height);
+        ser_writedata32be(s, tx_pos);
+        ser_writedata8(s, spending);
+        ser_writedata32be(s, n);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_HISTORY) {
+            throw std::ios_base::failure("Invalid format for scriptindex DB history key");
+        }
+        s >> script_id;
+        height = ser_readdata32be(s);
+        tx_pos = ser_readdata32be(s);
+        spending = ser_readdata8(s);
+        n = ser_readdata32be(s);
+    }
+};
+
+struct DBHistoryVal {
+    uint256 txid;
+    CAmount amount;
+
+    SERIALIZE_METHODS(DBHistoryVal, obj) { READWRITE(obj.txid, Using<AmountCompression>(obj.amount)); }
+};
+
+struct DBUnspentKey {
+    uint160 script_id;
+    COutPoint outpoint;
+
+    DBUnspentKey(const uint160& script_id_in, const COutPoint& outpoint_in) :
+        script_id(script_id_in), outpoint(outpoint_in) {}
+
+    SERIALIZE_METHODS(DBUnspentKey, obj) {
+        char prefix = DB_UNSPENT;
+        READWRITE(prefix);
+        if (prefix != DB_UNSPENT) {
+            throw std::ios_base::failure("Invalid format for scriptindex DB unspent key");
+        }
+
+        READWRITE(obj.script_id, obj.outpoint);
+    }
+};
+
+struct DBUnspentVal {
+    uint32_t code; //!< height * 2 + coinbase, as in Coin
+    CAmount amount;
+
+    SERIALIZE_METHODS(DBUnspentVal, obj) { READWRITE(VARINT(obj.code), Using<AmountCompression>(obj.amount)); }
+};
+
+uint160 GetScriptId(const CScript& script)
+{
+    return Hash160(script.begin(), script.end());
+}
+
+}; // namespace
+
+std::unique_ptr<ScriptIndex> g_script_index;
+
+ScriptIndex::ScriptIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+{
+    m_db = MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "scriptindex", n_cache_size, f_memory, f_wipe, false, "scriptindex");
+}
+
+bool ScriptIndex::ApplyBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex, bool connect) const
+{
+    CBlockUndo block_undo;
+    if (block.vtx.size() > 1 && !UndoReadFromDisk(block_undo, pindex)) {
+        return error("%s: Failed to read undo data of block %s from disk",
+                     __func__, pindex->GetBlockHash().ToString());
+    }
+    if (block.vtx.size() > 1 && block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: undo data of block %s does not match the block",
+                     __func__, pindex->GetBlockHash().ToString());
+    }
+
+    const int height = pindex->nHeight;
+    // Disconnect transactions in reverse order, so that outputs spent within
+    // the block are restored before they are removed.
+    for (size_t k = 0; k < block.vtx.size(); ++k) {
+        const uint32_t i = connect ? k : block.vtx.size() - 1 - k;
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& txid = tx.GetHash();
+
+        if (!connect) {
+            for (uint32_t n = 0; n < tx.vout.size(); ++n) {
+                const CTxOut& out = tx.vout[n];
+                if (out.scriptPubKey.IsUnspendable()) continue;
+                const uint160 script_id = GetScriptId(out.scriptPubKey);
+                batch.Erase(DBHistoryKey(script_id, height, i, false, n));
+                batch.Erase(DBUnspentKey(script_id, COutPoint(txid, n)));
+            }
+        }
+
+        if (!tx.IsCoinBase()) {
+            const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+            if (tx_undo.vprevout.size() != tx.vin.size()) {
+                return error("%s: undo data of block %s does not match the block",
+                             __func__, pindex->GetBlockHash().ToString());
+            }
+            for (uint32_t n = 0; n < tx.vin.size(); ++n) {
+                const Coin& coin = tx_undo.vprevout[n];
+                const uint160 script_id = GetScriptId(coin.out.scriptPubKey);
+                const DBHistoryKey history_key(script_id, height, i, true, n);
+                const DBUnspentKey unspent_key(script_id, tx.vin[n].prevout);
+                if (connect) {
+                    batch.Write(history_key, DBHistoryVal{txid, coin.out.nValue});
+                    batch.Erase(unspent_key);
+                } else {
+                    batch.Erase(history_key);
+                    batch.Write(unspent_key, DBUnspentVal{uint32_t(coin.nHeight) * 2 + coin.fCoinBase, coin.out.nValue});
+                }
+            }
+        }
+
+        if (connect) {
+            for (uint32_t n = 0; n < tx.vout.size(); ++n) {
+                const CTxOut& out = tx.vout[n];
+                if (out.scriptPubKey.IsUnspendable()) continue;
+                const uint160 script_id = GetScriptId(out.scriptPubKey);
+                batch.Write(DBHistoryKey(script_id, height, i, false, n), DBHistoryVal{txid, out.nValue});
+                batch.Write(DBUnspentKey(script_id, COutPoint(txid, n)),
+                            DBUnspentVal{uint32_t(height) * 2 + tx.IsCoinBase(), out.nValue});
+            }
+        }
+    }
+    return true;
+}
+
+bool ScriptIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // Exclude genesis block transaction because outputs are not spendable.
+    if (pindex->nHeight == 0) return true;
+
+    CDBBatch batch(*m_db);
+    if (!ApplyBlock(batch, block, pindex, /* connect */ true)) return false;
+    return m_db->WriteBatch(batch);
+}
+
+bool ScriptIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    CDBBatch batch(*m_db);
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk",
+                         __func__, pindex->GetBlockHash().ToString());
+        }
+        if (!ApplyBlock(batch, block, pindex, /* connect */ false)) return false;
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+bool ScriptIndex::FindScriptHistory(const CScript& script, int from_height, size_t max_entries, std::vector<ScriptHistoryEntry>& entries,
+                                    const ScriptHistoryEntry* after) const
+{
+    const uint160 script_id = GetScriptId(script);
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+
+    from_height = std::max(from_height, 0);
+    const bool resume = after && after->height >= from_height;
+    DBHistoryKey key = resume ? DBHistoryKey(script_id, after->height, after->tx_pos, after->spending, after->n)
+                              : DBHistoryKey(script_id, from_height, 0, false, 0);
+    for (db_it->Seek(key); db_it->Valid() && entries.size() < max_entries; db_it->Next()) {
+        if (!db_it->GetKey(key) || key.script_id != script_id) break;
+        if (resume && int(key.height) == after->height && key.tx_pos == after->tx_pos &&
+            (key.spending != 0) == after->spending && key.n == after->n) continue;
+
+        DBHistoryVal value;
+        if (!db_it->GetValue(value)) {
+            return error("%s: unable to read value in %s at key (%c, %s)",
+                         __func__, GetName(), DB_HISTORY, script_id.ToString());
+        }
+        entries.push_back({int(key.height), key.tx_pos, value.txid, key.n, key.spending != 0, value.amount});
+    }
+    return true;
+}
+
+bool ScriptIndex::FindScriptUnspent(const CScript& script, size_t max_entries, std::vector<ScriptUnspent>& unspents,
+                                    const COutPoint* after) const
+{
+    const uint160 script_id = GetScriptId(script);
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+
+    DBUnspentKey key(script_id, after ? *after : COutPoint(uint256(), 0));
+    for (db_it->Seek(key); db_it->Valid() && unspents.size() < max_entries; db_it->Next()) {
+        if (!db_it->GetKey(key) || key.script_id != script_id) break;
+        if (after && key.outpoint == *after) continue;
+
+        DBUnspentVal value;
+        if (!db_it->GetValue(value)) {
+            return error("%s: unable to read value in %s at key (%c, %s)",
+                         __func__, GetName(), DB_UNSPENT, script_id.ToString());
+        }
+        unspents.push_back({key.outpoint, int(value.code >> 1), (value.code & 1) != 0, value.amount});
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PEXA_INDEX_SCRIPTINDEX_H
+#define PEXA_INDEX_SCRIPTINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <index/base.h>
+#include <primitives/transaction.h>
+
+#include <vector>
+
+class CScript;
+
+static constexpr bool DEFAULT_SCRIPTINDEX{false};
+
+/** A transaction in the history of a script: one that pays to it, or spends an output paying to it. */
+struct ScriptHistoryEntry {
+    int height;
+    //! Position of the transaction in its block.
+    uint32_t tx_pos;
+    uint256 txid;
+    //! Index of the output paying to the script, or of the input spending such an output.
+    uint32_t n;
+    bool spending;
+    CAmount amount;
+};
+
+/** An unspent output paying to a script. */
+struct ScriptUnspent {
+    COutPoint outpoint;
+    int height;
+    bool coinbase;
+    CAmount amount;
+};
+
+/**
+ * ScriptIndex is used to look up the history and the unspent outputs of an
+ * output script. Scripts are keyed by their Hash160, and history entries by
+ * the height and position in the block of the transaction, so that they are
+ * returned in the order they were confirmed.
+ */
+class ScriptIndex final : public BaseIndex
+{
+private:
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+    //! Add the entries of a block to batch, or remove them when connect is false.
+    bool ApplyBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex, bool connect) const;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "scriptindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit ScriptIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Look up the history of a script in the active chain.
+    ///
+    /// @param[in]   script  The output script.
+    /// @param[in]   from_height  Skip blocks below this height.
+    /// @param[in]   max_entries  Stop after this many entries.
+    /// @param[out]  entries  The transactions paying to or spending from the script, oldest first.
+    /// @param[in]   after  If set, resume after this entry (only its height, tx_pos, spending and n are used).
+    /// @return  false on a database error
+    bool FindScriptHistory(const CScript& script, int from_height, size_t max_entries, std::vector<ScriptHistoryEntry>& entries,
+                           const ScriptHistoryEntry* after = nullptr) const;
+
+    /// Look up the unspent outputs paying to a script at the best block of the
+    /// index, at most max_entries of them, resuming after the outpoint after if set.
+    bool FindScriptUnspent(const CScript& script, size_t max_entries, std::vector<ScriptUnspent>& unspents,
+                           const COutPoint* after = nullptr) const;
+};
+
+/// The global script index. May be null.
+extern std::unique_ptr<ScriptIndex> g_script_index;
+
+#endif // PEXA_INDEX_SCRIPTINDEX_H
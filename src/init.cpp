@@ -10,6 +10,7 @@
 #include <init.h>
 
 #include <addrman.h>
+#include <algo/hash_algos.h>
 #include <amount.h>
 #include <banman.h>
 #include <blockfilter.h>
@@ -22,6 +23,8 @@
 #include <httprpc.h>
 #include <httpserver.h>
 #include <index/blockfilterindex.h>
+#include <index/coinstatsindex.h>
+#include <index/scriptindex.h>
 #include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <key.h>
@@ -31,6 +34,7 @@
 #include <net_processing.h>
 #include <netbase.h>
 #include <node/context.h>
+#include <node/utxo_snapshot.h>
 #include <policy/feerate.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
@@ -43,7 +47,9 @@
 #include <script/sigcache.h>
 #include <script/standard.h>
 #include <shutdown.h>
+#include <streams.h>
 #include <sync.h>
+#include <threadinterrupt.h>
 #include <timedata.h>
 #include <torcontrol.h>
 #include <txdb.h>
@@ -100,6 +106,9 @@ static const char* FEE_ESTIMATES_FILENAME="fee_estimates.dat";
 
 static const char* DEFAULT_ASMAP_FILENAME="ip_asn.map";
 
+//! Names of the databases -dboption settings can refer to.
+static const std::set<std::string> DB_NAMES{"blockfilterindex", "blockindex", "chainstate", "coinstatsindex", "scriptindex", "txindex"};
+
 /**
  * The PID file facilities.
  */
@@ -154,6 +163,10 @@ static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
 
 static std::thread g_load_block;
 
+//! Writes mempool.dat every -persistmempoolinterval minutes.
+static std::thread g_mempool_dump;
+static CThreadInterrupt g_mempool_dump_interrupt;
+
 static boost::thread_group threadGroup;
 
 void Interrupt(NodeContext& node)
@@ -169,6 +182,12 @@ void Interrupt(NodeContext& node)
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    if (g_coin_stats_index) {
+        g_coin_stats_index->Interrupt();
+    }
+    if (g_script_index) {
+        g_script_index->Interrupt();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Interrupt(); });
 }
 
@@ -198,6 +217,7 @@ void Shutdown(NodeContext& node)
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (node.peer_logic) UnregisterValidationInterface(node.peer_logic.get());
+    if (node.block_template_builder) UnregisterValidationInterface(node.block_template_builder.get());
     // Follow the lock order requirements:
     // * CheckForStaleTipAndEvictPeers locks cs_main before indirectly calling GetExtraOutboundCount
     //   which locks cs_vNodes.
@@ -219,12 +239,16 @@ void Shutdown(NodeContext& node)
     // CScheduler/checkqueue, threadGroup and load block thread.
     if (node.scheduler) node.scheduler->stop();
     if (g_load_block.joinable()) g_load_block.join();
+    g_mempool_dump_interrupt();
+    if (g_mempool_dump.joinable()) g_mempool_dump.join();
+    if (node.chainman) node.chainman->StopBackgroundValidation();
     threadGroup.interrupt_all();
     threadGroup.join_all();
 
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
     node.peer_logic.reset();
+    node.block_template_builder.reset();
     node.connman.reset();
     node.banman.reset();
 
@@ -263,6 +287,14 @@ void Shutdown(NodeContext& node)
         g_txindex->Stop();
         g_txindex.reset();
     }
+    if (g_coin_stats_index) {
+        g_coin_stats_index->Stop();
+        g_coin_stats_index.reset();
+    }
+    if (g_script_index) {
+        g_script_index->Stop();
+        g_script_index.reset();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); });
     DestroyAllBlockFilterIndexes();
 
@@ -274,6 +306,7 @@ void Shutdown(NodeContext& node)
 
     if (node.chainman) {
         LOCK(cs_main);
+        node.chainman->CleanUpValidatedSnapshot();
         for (CChainState* chainstate : node.chainman->GetAll()) {
             if (chainstate->CanFlushToDisk()) {
                 chainstate->ForceFlushStateToDisk();
@@ -390,20 +423,30 @@ void SetupServerArgs(NodeContext& node)
     gArgs.AddArg("-alertnotify=<cmd>", "Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #endif
     gArgs.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-bgvalidationdbcache=<n>", strprintf("Percentage of the in-memory UTXO set cache given to validating the blocks below a UTXO snapshot in the background (0 to 50, default: %d)", DEFAULT_BACKGROUND_VALIDATION_CACHE_PERCENT), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-bgvalidationpar=<n>", strprintf("Set the number of script verification threads for validating the blocks below a UTXO snapshot in the background (0 to %d, 0 = half of -par, default: %d)", MAX_SCRIPTCHECK_THREADS, DEFAULT_BACKGROUND_SCRIPTCHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksdir=<dir>", "Specify directory to hold blocks subdirectory for *.dat files (default: <datadir>)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockindexpowdepth=<n>", strprintf("With -trustblockindex, number of most recent block index entries whose hash is recomputed at startup (default: %d)", DEFAULT_BLOCK_INDEX_POW_DEPTH), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockindexpowsample=<n>", strprintf("With -trustblockindex, recompute the hash of a random 1 in <n> older block index entries at startup (0 = none, default: %d)", DEFAULT_BLOCK_INDEX_POW_SAMPLE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #if HAVE_SYSTEM
     gArgs.AddArg("-blocknotify=<cmd>", "Execute command when the best block changes (%s in cmd is replaced by block hash)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #endif
     gArgs.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksonly", strprintf("Whether to reject transactions from network peers. Automatic broadcast and rebroadcast of any transactions from inbound peers is disabled, unless '-whitelistforcerelay' is '1', in which case whitelisted peers' transactions will be relayed. RPC transactions are not affected. (default: %u)", DEFAULT_BLOCKSONLY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-coinstatsindex", strprintf("Maintain coinstats index used by the gettxoutsetinfo RPC (default: %u)", DEFAULT_COINSTATSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", PEXA_CONF_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dboption=<name>:<setting>=<value>", "Override a LevelDB setting of one database. <name> is one of " + Join(std::vector<std::string>(DB_NAMES.begin(), DB_NAMES.end()), std::string(", ")) + ". <setting> is one of "
+                 "cache (MiB, replaces the share of -dbcache the database gets; the block cache and write buffer default to a half and a quarter of it), "
+                 "block_cache (MiB), write_buffer (MiB), bloom_bits (bits per key of the bloom filters, 0 to disable them), "
+                 "max_file_size (MiB) or max_open_files. Memory set with cache, block_cache or write_buffer comes on top of -dbcache. Can be specified multiple times", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external file on startup", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-loadutxosnapshot=<file>", "Load a UTXO set written by dumptxoutset on startup, once the header of its base block is known, and sync from there. The set must match the one known for its height. Cannot be used with -prune. If relative, the path is prefixed by datadir.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -411,18 +454,21 @@ void SetupServerArgs(NodeContext& node)
     gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-persistmempoolinterval=<n>", strprintf("With -persistmempool, also save the mempool every <n> minutes while running, so that it survives a crash (0 = only on shutdown, default: %u)", DEFAULT_PERSIST_MEMPOOL_INTERVAL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", PEXA_PID_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
-    gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
+    gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex, -coinstatsindex, -scriptindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks. When in pruning mode or if blocks on disk might be corrupted, use full -reindex instead.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-scriptindex", strprintf("Maintain an index of the history and unspent outputs of every output script, used by the getscripthistory and getscriptunspent rpc calls (default: %u)", DEFAULT_SCRIPTINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #ifndef WIN32
     gArgs.AddArg("-sysperms", "Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #else
     hidden_args.emplace_back("-sysperms");
 #endif
     gArgs.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-trustblockindex", strprintf("Trust the block hashes the block index is keyed by at startup instead of re-hashing every header. Only the last -blockindexpowdepth entries and a random sample of the others are re-hashed (default: %u)", DEFAULT_TRUST_BLOCK_INDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockfilterindex=<type>",
                  strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
                  " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled.",
@@ -549,6 +595,7 @@ void SetupServerArgs(NodeContext& node)
     gArgs.AddArg("-blockmaxweight=<n>", strprintf("Set maximum BIP141 block weight (default: %d)", DEFAULT_BLOCK_MAX_WEIGHT), ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-blockmintxfee=<amt>", strprintf("Set lowest fee rate (in %s/kB) for transactions to be included in block creation. (default: %s)", CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)), ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-blockversion=<n>", "Override block version to test forking scenarios", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-genproclimit=<n>", strprintf("Set the number of threads the generate RPCs search for a block on (-1 = all cores, at most %d per core, default: %d)", MAX_GENERATE_THREADS_PER_CORE, DEFAULT_GENERATE_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
 
     gArgs.AddArg("-rest", strprintf("Accept public REST requests (default: %u)", DEFAULT_REST_ENABLE), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     gArgs.AddArg("-rpcallowip=<ip>", "Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
@@ -680,6 +727,33 @@ static void CleanupBlockRevFiles()
     }
 }
 
+static void LoadUTXOSnapshot(ChainstateManager& chainman, const fs::path& path)
+{
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Warning: Could not open UTXO snapshot %s\n", path.string());
+        return;
+    }
+    SnapshotMetadata metadata;
+    try {
+        file >> metadata;
+    } catch (const std::exception& e) {
+        LogPrintf("Warning: Could not read UTXO snapshot %s: %s\n", path.string(), e.what());
+        return;
+    }
+
+    LogPrintf("Waiting for the header of snapshot base block %s...\n", metadata.m_base_blockhash.ToString());
+    while (!WITH_LOCK(::cs_main, return LookupBlockIndex(metadata.m_base_blockhash))) {
+        if (ShutdownRequested()) return;
+        UninterruptibleSleep(std::chrono::milliseconds{500});
+    }
+
+    LogPrintf("Loading UTXO snapshot %s...\n", path.string());
+    if (!chainman.ActivateSnapshot(file, metadata, /* in_memory */ false)) {
+        LogPrintf("Warning: Could not load UTXO snapshot %s\n", path.string());
+    }
+}
+
 static void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImportFiles)
 {
     const CChainParams& chainparams = Params();
@@ -748,6 +822,17 @@ static void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImp
         return;
     }
     } // End scope of CImportingNow
+
+    // -loadutxosnapshot=
+    // Headers are only requested once importing is done, so wait for the
+    // snapshot base outside of CImportingNow.
+    if (gArgs.IsArgSet("-loadutxosnapshot") && !WITH_LOCK(::cs_main, return chainman.IsSnapshotActive())) {
+        LoadUTXOSnapshot(chainman, fs::absolute(gArgs.GetArg("-loadutxosnapshot", ""), GetDataDir()));
+        if (ShutdownRequested()) {
+            LogPrintf("Shutdown requested. Exit %s\n", __func__);
+            return;
+        }
+    }
     if (gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         LoadMempool(::mempool);
     }
@@ -1009,6 +1094,15 @@ bool AppInitParameterInteraction()
         if (!g_enabled_filter_types.empty()) {
             return InitError(_("Prune mode is incompatible with -blockfilterindex."));
         }
+        if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+            return InitError(_("Prune mode is incompatible with -coinstatsindex."));
+        }
+        if (gArgs.GetBoolArg("-scriptindex", DEFAULT_SCRIPTINDEX)) {
+            return InitError(_("Prune mode is incompatible with -scriptindex."));
+        }
+        if (gArgs.IsArgSet("-loadutxosnapshot")) {
+            return InitError(_("Prune mode is incompatible with -loadutxosnapshot."));
+        }
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -1131,6 +1225,11 @@ bool AppInitParameterInteraction()
         return InitError(Untranslated("peertimeout cannot be configured with a negative value."));
     }
 
+    std::string db_option_error;
+    if (!CheckDBOptions(DB_NAMES, db_option_error)) {
+        return InitError(Untranslated(db_option_error));
+    }
+
     if (gArgs.IsArgSet("-minrelaytxfee")) {
         CAmount n = 0;
         if (!ParseMoney(gArgs.GetArg("-minrelaytxfee", ""), n)) {
@@ -1212,6 +1311,8 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string x16r_algo = X16RAutoDetect();
+    LogPrintf("Using the '%s' X16R implementation\n", x16r_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1305,11 +1406,23 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
     // Number of script-checking threads <= MAX_SCRIPTCHECK_THREADS
     script_threads = std::min(script_threads, MAX_SCRIPTCHECK_THREADS);
 
-    LogPrintf("Script verification uses %d additional threads\n", script_threads);
+    LogPrintf("Script verification, header hashing and input prefetching use %d additional threads\n", script_threads);
     if (script_threads >= 1) {
         g_parallel_script_checks = true;
         for (int i = 0; i < script_threads; ++i) {
             threadGroup.create_thread([i]() { return ThreadScriptCheck(i); });
+            threadGroup.create_thread([i]() { return ThreadMempoolScriptCheck(i); });
+            threadGroup.create_thread([i]() { return ThreadHeaderHashCheck(i); });
+            threadGroup.create_thread([i]() { return ThreadCoinPrefetch(i); });
+        }
+
+        // Background validation of a UTXO snapshot gets its own, lower
+        // priority script check threads.
+        int background_script_threads = gArgs.GetArg("-bgvalidationpar", DEFAULT_BACKGROUND_SCRIPTCHECK_THREADS);
+        if (background_script_threads <= 0) background_script_threads = (script_threads + 1) / 2;
+        background_script_threads = std::min(background_script_threads, MAX_SCRIPTCHECK_THREADS);
+        for (int i = 0; i < background_script_threads; ++i) {
+            threadGroup.create_thread([i]() { return ThreadBackgroundScriptCheck(i); });
         }
     }
 
@@ -1384,6 +1497,11 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
     node.peer_logic.reset(new PeerLogicValidation(node.connman.get(), node.banman.get(), *node.scheduler, *node.chainman, *node.mempool));
     RegisterValidationInterface(node.peer_logic.get());
 
+    // Keeps the getblocktemplate template current; getblocktemplate clients
+    // supply their own coinbase.
+    node.block_template_builder = MakeUnique<BlockTemplateBuilder>(*node.mempool, chainparams, CScript() << OP_TRUE);
+    RegisterValidationInterface(node.block_template_builder.get());
+
     // sanitize comments per BIP-0014, format user agent and check total size
     std::vector<std::string> uacomments;
     for (const std::string& cmt : gArgs.GetArgs("-uacomment")) {
@@ -1529,10 +1647,13 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
         filter_index_cache = max_cache / n_indexes;
         nTotalCache -= filter_index_cache * n_indexes;
     }
+    int64_t script_index_cache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-scriptindex", DEFAULT_SCRIPTINDEX) ? max_script_index_cache << 20 : 0);
+    nTotalCache -= script_index_cache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
+    chainman.m_background_cache_percent = std::max(0, std::min<int>(50, gArgs.GetArg("-bgvalidationdbcache", DEFAULT_BACKGROUND_VALIDATION_CACHE_PERCENT)));
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1f MiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
@@ -1543,6 +1664,9 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
         LogPrintf("* Using %.1f MiB for %s block filter index database\n",
                   filter_index_cache * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
     }
+    if (gArgs.GetBoolArg("-scriptindex", DEFAULT_SCRIPTINDEX)) {
+        LogPrintf("* Using %.1f MiB for script index database\n", script_index_cache * (1.0 / 1024 / 1024));
+    }
     LogPrintf("* Using %.1f MiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for in-memory UTXO set (plus up to %.1f MiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
@@ -1561,6 +1685,9 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
             try {
                 LOCK(cs_main);
                 chainman.InitializeChainstate();
+                // A snapshot chainstate loaded in an earlier run becomes the
+                // active chainstate again. Rebuilding the chainstate discards it.
+                chainman.DetectSnapshotChainstate(/* wipe */ fReset || fReindexChainState);
                 UnloadBlockIndex();
 
                 // new CBlockTreeDB tries to delete the existing file, which
@@ -1617,8 +1744,15 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
 
                 for (CChainState* chainstate : chainman.GetAll()) {
                     LogPrintf("Initializing chainstate %s\n", chainstate->ToString());
+                    // While a snapshot is validated in the background, the
+                    // background chainstate gets its share of the cache.
+                    int64_t coinsdb_cache = nCoinDBCache;
+                    if (chainman.IsSnapshotActive()) {
+                        const int64_t background_cache = nCoinDBCache / 100 * chainman.m_background_cache_percent;
+                        coinsdb_cache = chainman.IsBackgroundIBD(chainstate) ? background_cache : nCoinDBCache - background_cache;
+                    }
                     chainstate->InitCoinsDB(
-                        /* cache_size_bytes */ nCoinDBCache,
+                        /* cache_size_bytes */ coinsdb_cache,
                         /* in_memory */ false,
                         /* should_wipe */ fReset || fReindexChainState);
 
@@ -1657,6 +1791,7 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
                         assert(chainstate->m_chain.Tip() != nullptr);
                     }
                 }
+                chainman.MaybeRebalanceCaches();
 
                 if (failed_chainstate_init) {
                     break; // out of the chainstate activation do-while
@@ -1785,6 +1920,16 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
         GetBlockFilterIndex(filter_type)->Start();
     }
 
+    if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        g_coin_stats_index = MakeUnique<CoinStatsIndex>(/* cache size */ 0, false, fReindex);
+        g_coin_stats_index->Start();
+    }
+
+    if (gArgs.GetBoolArg("-scriptindex", DEFAULT_SCRIPTINDEX)) {
+        g_script_index = MakeUnique<ScriptIndex>(script_index_cache, false, fReindex);
+        g_script_index->Start();
+    }
+
     // ********************************************************* Step 9: load wallet
     for (const auto& client : node.chain_clients) {
         if (!client->load()) {
@@ -1845,6 +1990,7 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
     }
 
     g_load_block = std::thread(&TraceThread<std::function<void()>>, "loadblk", [=, &chainman]{ ThreadImport(chainman, vImportFiles); });
+    chainman.StartBackgroundValidation();
 
     // Wait for genesis block to be processed
     {
@@ -1952,5 +2098,20 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
         banman->DumpBanlist();
     }, DUMP_BANS_INTERVAL);
 
+    const int64_t mempool_dump_interval = gArgs.GetArg("-persistmempoolinterval", DEFAULT_PERSIST_MEMPOOL_INTERVAL);
+    if (gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL) && mempool_dump_interval > 0) {
+        // Writing a large mempool takes a while, so it gets a thread of its
+        // own rather than holding up the scheduler's other tasks.
+        g_mempool_dump_interrupt.reset();
+        g_mempool_dump = std::thread(&TraceThread<std::function<void()>>, "mempooldump", [mempool_dump_interval] {
+            while (g_mempool_dump_interrupt.sleep_for(std::chrono::minutes{mempool_dump_interval})) {
+                // Don't replace the last snapshot with a partially loaded mempool
+                if (::mempool.IsLoaded()) {
+                    DumpMempool(::mempool);
+                }
+            }
+        });
+    }
+
     return true;
 }
@@ -453,3 +453,286 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
     pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
+
+BlockTemplateBuilder::BlockTemplateBuilder(const CTxMemPool& mempool, const CChainParams& params, const CScript& coinbase_script)
+    : m_mempool(mempool), m_params(params), m_coinbase_script(coinbase_script)
+{
+    const BlockAssembler::Options options = DefaultOptions();
+    // Same sanity limits as BlockAssembler
+    m_block_max_weight = std::max<size_t>(4000, std::min<size_t>(MAX_BLOCK_WEIGHT - 4000, options.nBlockMaxWeight));
+    m_block_min_fee_rate = options.blockMinFeeRate;
+}
+
+std::shared_ptr<const CBlockTemplate> BlockTemplateBuilder::GetTemplate()
+{
+    LOCK2(cs_main, m_mempool.cs);
+    LOCK(m_mutex);
+    m_active = true;
+    if (m_tip != ::ChainActive().Tip()) Rebuild();
+    if (m_dirty) {
+        Requeue();
+        Publish();
+    }
+    return m_template;
+}
+
+void BlockTemplateBuilder::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    if (!m_active) return;
+    LOCK2(cs_main, m_mempool.cs);
+    LOCK(m_mutex);
+    if (m_tip == ::ChainActive().Tip()) return;
+    if (fInitialDownload) {
+        // Assemble on request only while syncing.
+        m_tip = nullptr;
+        m_template.reset();
+        return;
+    }
+    try {
+        Rebuild();
+    } catch (const std::runtime_error& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+}
+
+void BlockTemplateBuilder::TransactionAddedToMempool(const CTransactionRef& tx)
+{
+    if (!m_active) return;
+    // A template that must be assembled again anyway does not need the
+    // transaction, so do not wait for cs_main for it.
+    if (WITH_LOCK(m_mutex, return !m_tip || m_txids.count(tx->GetHash()))) return;
+    LOCK2(cs_main, m_mempool.cs);
+    LOCK(m_mutex);
+    // A template on top of an old tip is assembled again anyway.
+    if (!m_tip || m_tip != ::ChainActive().Tip()) return;
+    // The notification may arrive after the transaction left the mempool again.
+    CTxMemPool::txiter entry = m_mempool.mapTx.find(tx->GetHash());
+    if (entry == m_mempool.mapTx.end() || m_txids.count(tx->GetHash())) return;
+    if (AddPackage(entry)) m_dirty = true;
+}
+
+void BlockTemplateBuilder::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason)
+{
+    if (!m_active) return;
+    LOCK(m_mutex);
+    if (!m_tip) return;
+    if (Remove(tx->GetHash())) m_dirty = true;
+}
+
+void BlockTemplateBuilder::Rebuild()
+{
+    const int64_t time_start = GetTimeMicros();
+    m_tip = nullptr;
+    m_template.reset();
+    m_txs.clear();
+    m_txids.clear();
+    m_spent.clear();
+    m_leaves.clear();
+    m_evicted.clear();
+
+    std::unique_ptr<CBlockTemplate> block_template = BlockAssembler(m_mempool, m_params).CreateNewBlock(m_coinbase_script);
+    const CBlock& block = block_template->block;
+    const CBlockIndex* tip = ::ChainActive().Tip();
+    assert(block.hashPrevBlock == tip->GetBlockHash());
+
+    m_header = block.GetBlockHeader();
+    m_coinbase = CMutableTransaction(*block.vtx[0]);
+    const int commitpos = GetWitnessCommitmentIndex(block);
+    if (commitpos != -1) m_coinbase.vout.erase(m_coinbase.vout.begin() + commitpos);
+    m_coinbase_sigops_cost = block_template->vTxSigOpsCost[0];
+    m_height = tip->nHeight + 1;
+    m_lock_time_cutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+                         ? tip->GetMedianTimePast()
+                         : block.GetBlockTime();
+    m_include_witness = IsWitnessEnabled(tip, m_params.GetConsensus());
+
+    // Reserve space for coinbase tx, as BlockAssembler does
+    m_weight = 4000;
+    m_sigops_cost = 400;
+    m_fees = 0;
+    for (size_t i = 1; i < block.vtx.size(); ++i) {
+        const CTransactionRef& tx = block.vtx[i];
+        CTxMemPool::txiter entry = m_mempool.mapTx.find(tx->GetHash());
+        assert(entry != m_mempool.mapTx.end());
+        Append({tx, block_template->vTxFees[i], entry->GetModifiedFee(), entry->GetTxSize(), int64_t(entry->GetTxWeight()), block_template->vTxSigOpsCost[i]});
+    }
+    m_tip = tip;
+    m_dirty = true;
+    LogPrint(BCLog::BENCH, "BlockTemplateBuilder: assembled template on %s with %u txs in %.2fms\n",
+             tip->GetBlockHash().ToString(), m_txs.size(), 0.001 * (GetTimeMicros() - time_start));
+}
+
+bool BlockTemplateBuilder::AddPackage(CTxMemPool::txiter entry)
+{
+    CTxMemPool::setEntries ancestors;
+    uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    std::string dummy;
+    m_mempool.CalculateMemPoolAncestors(*entry, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+    ancestors.insert(entry);
+
+    std::vector<CTxMemPool::txiter> package;
+    size_t package_size = 0;
+    int64_t package_weight = 0;
+    int64_t package_sigops_cost = 0;
+    CAmount package_fees = 0;
+    for (CTxMemPool::txiter it : ancestors) {
+        if (m_txids.count(it->GetTx().GetHash())) continue;
+        if (!IsFinalTx(it->GetTx(), m_height, m_lock_time_cutoff)) return false;
+        if (!m_include_witness && it->GetTx().HasWitness()) return false;
+        for (const CTxIn& txin : it->GetTx().vin) {
+            // Notifications of the transactions this one replaced are still queued.
+            if (m_spent.count(txin.prevout)) return false;
+        }
+        package.push_back(it);
+        package_size += it->GetTxSize();
+        package_weight += it->GetTxWeight();
+        package_sigops_cost += it->GetSigOpCost();
+        package_fees += it->GetModifiedFee();
+    }
+    if (package_fees < m_block_min_fee_rate.GetFee(package_size)) return false;
+    const CFeeRate package_fee_rate(package_fees, package_size);
+
+    // Make room by evicting the lowest feerate transactions nothing else in
+    // the template depends on, as long as they pay less than the package.
+    const auto fits = [&](int64_t freed_weight, int64_t freed_sigops_cost) EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+        return m_weight - freed_weight + package_weight < m_block_max_weight &&
+               m_sigops_cost - freed_sigops_cost + package_sigops_cost < MAX_BLOCK_SIGOPS_COST;
+    };
+    if (!fits(0, 0)) {
+        std::set<uint256> parents;
+        for (CTxMemPool::txiter it : package) {
+            for (const CTxIn& txin : it->GetTx().vin) parents.insert(txin.prevout.hash);
+        }
+        int64_t freed_weight = 0;
+        int64_t freed_sigops_cost = 0;
+        std::vector<std::pair<CFeeRate, uint256>> evict;
+        for (auto leaf = m_leaves.begin(); leaf != m_leaves.end() && leaf->first < package_fee_rate; ++leaf) {
+            if (fits(freed_weight, freed_sigops_cost)) break;
+            if (parents.count(leaf->second)) continue;
+            const TemplateTx& template_tx = m_txs.at(m_txids.at(leaf->second));
+            freed_weight += template_tx.weight;
+            freed_sigops_cost += template_tx.sigops_cost;
+            evict.push_back(*leaf);
+        }
+        if (!fits(freed_weight, freed_sigops_cost)) return false;
+        for (const auto& leaf : evict) {
+            Remove(leaf.second);
+            m_evicted.insert(leaf);
+        }
+    }
+
+    std::sort(package.begin(), package.end(), CompareTxIterByAncestorCount());
+    for (CTxMemPool::txiter it : package) {
+        Append({it->GetSharedTx(), it->GetFee(), it->GetModifiedFee(), it->GetTxSize(), int64_t(it->GetTxWeight()), it->GetSigOpCost()});
+    }
+    return true;
+}
+
+void BlockTemplateBuilder::Requeue()
+{
+    // Re-adding may evict others again, so give up after one pass.
+    for (size_t tries = m_evicted.size(); tries > 0 && !m_evicted.empty(); --tries) {
+        const std::pair<CFeeRate, uint256> best = *m_evicted.rbegin();
+        m_evicted.erase(best);
+        CTxMemPool::txiter entry = m_mempool.mapTx.find(best.second);
+        if (entry == m_mempool.mapTx.end() || m_txids.count(best.second)) continue;
+        if (!AddPackage(entry)) {
+            // Worse transactions are unlikely to fit either.
+            m_evicted.insert(best);
+            break;
+        }
+    }
+}
+
+bool BlockTemplateBuilder::Remove(const uint256& txid)
+{
+    if (!m_txids.count(txid)) return false;
+
+    // Find the descendants through the outputs they spend.
+    std::set<uint256> removed{txid};
+    std::vector<uint256> todo{txid};
+    while (!todo.empty()) {
+        const uint256 hash = todo.back();
+        todo.pop_back();
+        for (auto it = m_spent.lower_bound(COutPoint(hash, 0)); it != m_spent.end() && it->first.hash == hash; ++it) {
+            if (removed.insert(it->second).second) todo.push_back(it->second);
+        }
+    }
+
+    std::set<uint256> parents;
+    for (const uint256& hash : removed) {
+        const auto seq = m_txids.find(hash);
+        const auto it = m_txs.find(seq->second);
+        const TemplateTx& template_tx = it->second;
+        for (const CTxIn& txin : template_tx.tx->vin) {
+            m_spent.erase(txin.prevout);
+            if (!removed.count(txin.prevout.hash) && m_txids.count(txin.prevout.hash)) parents.insert(txin.prevout.hash);
+        }
+        m_leaves.erase({template_tx.GetFeeRate(), hash});
+        m_weight -= template_tx.weight;
+        m_sigops_cost -= template_tx.sigops_cost;
+        m_fees -= template_tx.fee;
+        m_txs.erase(it);
+        m_txids.erase(seq);
+    }
+    for (const uint256& hash : parents) {
+        if (!HasChildren(hash)) m_leaves.emplace(m_txs.at(m_txids.at(hash)).GetFeeRate(), hash);
+    }
+    return true;
+}
+
+void BlockTemplateBuilder::Append(const TemplateTx& entry)
+{
+    const uint256& txid = entry.tx->GetHash();
+    for (const CTxIn& txin : entry.tx->vin) {
+        m_spent.emplace(txin.prevout, txid);
+        const auto parent = m_txids.find(txin.prevout.hash);
+        if (parent != m_txids.end()) m_leaves.erase({m_txs.at(parent->second).GetFeeRate(), parent->first});
+    }
+    m_txids.emplace(txid, m_next_sequence);
+    m_txs.emplace(m_next_sequence++, entry);
+    m_leaves.emplace(entry.GetFeeRate(), txid);
+    m_weight += entry.weight;
+    m_sigops_cost += entry.sigops_cost;
+    m_fees += entry.fee;
+}
+
+bool BlockTemplateBuilder::HasChildren(const uint256& txid) const
+{
+    const auto it = m_spent.lower_bound(COutPoint(txid, 0));
+    return it != m_spent.end() && it->first.hash == txid;
+}
+
+void BlockTemplateBuilder::Publish()
+{
+    auto block_template = std::make_shared<CBlockTemplate>();
+    CBlock& block = block_template->block;
+    static_cast<CBlockHeader&>(block) = m_header;
+    CMutableTransaction coinbase{m_coinbase};
+    coinbase.vout[0].nValue = m_fees + GetBlockSubsidy(m_height, m_params.GetConsensus());
+    block.vtx.reserve(m_txs.size() + 1);
+    block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+    block_template->vTxFees.reserve(m_txs.size() + 1);
+    block_template->vTxFees.push_back(-m_fees);
+    block_template->vTxSigOpsCost.reserve(m_txs.size() + 1);
+    block_template->vTxSigOpsCost.push_back(m_coinbase_sigops_cost);
+    for (const auto& template_tx : m_txs) {
+        block.vtx.push_back(template_tx.second.tx);
+        block_template->vTxFees.push_back(template_tx.second.fee);
+        block_template->vTxSigOpsCost.push_back(template_tx.second.sigops_cost);
+    }
+    block_template->vchCoinbaseCommitment = GenerateCoinbaseCommitment(block, m_tip, m_params.GetConsensus());
+
+    if (m_params.DefaultConsistencyChecks()) {
+        assert(m_tip == ::ChainActive().Tip());
+        BlockValidationState state;
+        if (!TestBlockValidity(state, m_params, block, ::ChainActive().Tip(), false, false)) {
+            // Assemble from scratch on the next request.
+            m_tip = nullptr;
+            m_template.reset();
+            throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, state.ToString()));
+        }
+    }
+    m_template = std::move(block_template);
+    m_dirty = false;
+}
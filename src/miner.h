@@ -8,10 +8,15 @@
 
 #include <optional.h>
 #include <primitives/block.h>
+#include <sync.h>
 #include <txmempool.h>
 #include <validation.h>
+#include <validationinterface.h>
 
+#include <atomic>
+#include <map>
 #include <memory>
+#include <set>
 #include <stdint.h>
 
 #include <boost/multi_index_container.hpp>
@@ -24,6 +29,10 @@ class CScript;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Default for -genproclimit, the number of threads the generate RPCs search nonces on */
+static const int DEFAULT_GENERATE_THREADS = 1;
+/** -genproclimit is capped at this many threads per core */
+static const int MAX_GENERATE_THREADS_PER_CORE = 4;
 
 struct CBlockTemplate
 {
@@ -199,6 +208,103 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set& mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
 };
 
+/**
+ * Keeps a block template on top of the active chain current as transactions
+ * enter and leave the mempool, so that getblocktemplate does not assemble a
+ * block on every call.
+ *
+ * The template is assembled from scratch by BlockAssembler only when the tip
+ * changes. A transaction added to the mempool is appended together with its
+ * ancestors that are not in the template yet, evicting template transactions
+ * with lower feerates that nothing in the template depends on if the block is
+ * full. Evicted transactions are tried again, best first, the next time a
+ * template is requested. A transaction removed from the mempool is removed
+ * from the template together with its descendants. The CBlockTemplate itself
+ * is only built when requested after a change.
+ *
+ * Nothing is tracked until the first template is requested, so nodes that do
+ * not serve templates pay nothing.
+ */
+class BlockTemplateBuilder final : public CValidationInterface
+{
+public:
+    BlockTemplateBuilder(const CTxMemPool& mempool, const CChainParams& params, const CScript& coinbase_script);
+
+    /** The template on top of the current tip, assembled first if the tip changed. */
+    std::shared_ptr<const CBlockTemplate> GetTemplate() LOCKS_EXCLUDED(m_mutex);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef& tx) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason) override;
+
+private:
+    //! A non-coinbase transaction of the template, with what selection needs to know about it.
+    struct TemplateTx {
+        CTransactionRef tx;
+        CAmount fee;
+        CAmount modified_fee;
+        size_t vsize;
+        int64_t weight;
+        int64_t sigops_cost;
+
+        CFeeRate GetFeeRate() const { return CFeeRate(modified_fee, vsize); }
+    };
+
+    const CTxMemPool& m_mempool;
+    const CChainParams& m_params;
+    const CScript m_coinbase_script;
+    unsigned int m_block_max_weight;
+    CFeeRate m_block_min_fee_rate;
+
+    //! Whether a template was ever requested. Checked before taking any lock.
+    std::atomic<bool> m_active{false};
+
+    Mutex m_mutex;
+    //! The tip the template builds on, or nullptr if it must be assembled again.
+    const CBlockIndex* m_tip GUARDED_BY(m_mutex){nullptr};
+    //! The header and the coinbase (without witness commitment) from the last assembly.
+    CBlockHeader m_header GUARDED_BY(m_mutex);
+    CMutableTransaction m_coinbase GUARDED_BY(m_mutex);
+    int64_t m_coinbase_sigops_cost GUARDED_BY(m_mutex){0};
+    int m_height GUARDED_BY(m_mutex){0};
+    int64_t m_lock_time_cutoff GUARDED_BY(m_mutex){0};
+    bool m_include_witness GUARDED_BY(m_mutex){false};
+
+    //! The transactions of the template by sequence number, which is their block order.
+    std::map<uint64_t, TemplateTx> m_txs GUARDED_BY(m_mutex);
+    uint64_t m_next_sequence GUARDED_BY(m_mutex){0};
+    //! The sequence number of every transaction of the template.
+    std::map<uint256, uint64_t> m_txids GUARDED_BY(m_mutex);
+    //! The outputs spent by the template and the transactions spending them.
+    std::map<COutPoint, uint256> m_spent GUARDED_BY(m_mutex);
+    //! The transactions nothing else in the template spends from, lowest feerate first.
+    std::set<std::pair<CFeeRate, uint256>> m_leaves GUARDED_BY(m_mutex);
+    //! Transactions evicted to make room for better ones, lowest feerate first.
+    std::set<std::pair<CFeeRate, uint256>> m_evicted GUARDED_BY(m_mutex);
+    uint64_t m_weight GUARDED_BY(m_mutex){0};
+    int64_t m_sigops_cost GUARDED_BY(m_mutex){0};
+    CAmount m_fees GUARDED_BY(m_mutex){0};
+
+    //! The template handed out by GetTemplate(), and whether it lags behind the above.
+    std::shared_ptr<const CBlockTemplate> m_template GUARDED_BY(m_mutex);
+    bool m_dirty GUARDED_BY(m_mutex){false};
+
+    /** Assemble the template from scratch on top of the current tip. */
+    void Rebuild() EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_mempool.cs, m_mutex);
+    /** Add a mempool transaction and its missing ancestors, if they are worth their space. */
+    bool AddPackage(CTxMemPool::txiter entry) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_mempool.cs, m_mutex);
+    /** Add evicted transactions that are still in the mempool again, until one does not fit. */
+    void Requeue() EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_mempool.cs, m_mutex);
+    /** Remove a transaction and its descendants. */
+    bool Remove(const uint256& txid) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    void Append(const TemplateTx& entry) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    /** Whether a transaction of the template is spent by another one. */
+    bool HasChildren(const uint256& txid) const EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    /** Build m_template from the transactions, checking it when consistency checks are on. */
+    void Publish() EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_mutex);
+};
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
@@ -12,6 +12,7 @@
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <hash.h>
+#include <headerhashcache.h>
 #include <index/blockfilterindex.h>
 #include <validation.h>
 #include <merkleblock.h>
@@ -724,6 +725,41 @@ static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vec
     }
 }
 
+/**
+ * Add up to count blocks the background chainstate needs to validate an
+ * active UTXO snapshot to vBlocks, in order from its tip towards the snapshot
+ * base, if the peer has them. Like for the active chain, nothing further than
+ * BLOCK_DOWNLOAD_WINDOW ahead of the background tip is requested.
+ */
+static void FindNextHistoricalBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (count == 0 || !g_chainman.IsSnapshotActive() || g_chainman.IsSnapshotValidated()) return;
+
+    CNodeState* state = State(nodeid);
+    assert(state != nullptr);
+    const CBlockIndex* base = LookupBlockIndex(*g_chainman.SnapshotBlockhash());
+    if (!base || !state->pindexBestKnownBlock || state->pindexBestKnownBlock->GetAncestor(base->nHeight) != base) {
+        return;
+    }
+
+    const CBlockIndex* fork = g_chainman.ValidatedChain().FindFork(base);
+    const int window_end = std::min<int>(base->nHeight, fork->nHeight + BLOCK_DOWNLOAD_WINDOW);
+    std::vector<const CBlockIndex*> vToFetch;
+    for (const CBlockIndex* pindex = base->GetAncestor(window_end); pindex != fork; pindex = pindex->pprev) {
+        vToFetch.push_back(pindex);
+    }
+    for (const CBlockIndex* pindex : reverse_iterate(vToFetch)) {
+        if (!State(nodeid)->fHaveWitness && IsWitnessEnabled(pindex->pprev, consensusParams)) {
+            // We wouldn't download this block or its descendants from this peer.
+            return;
+        }
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA) && mapBlocksInFlight.count(pindex->GetBlockHash()) == 0) {
+            vBlocks.push_back(pindex);
+            if (vBlocks.size() == count) return;
+        }
+    }
+}
+
 void EraseTxRequest(const uint256& txid) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     g_already_asked_for.erase(txid);
@@ -1592,7 +1628,7 @@ void static ProcessGetBlockData(CNode& pfrom, const CChainParams& chainparams, c
                 bool fPeerWantsWitness = State(pfrom.GetId())->fWantsCmpctWitness;
                 int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
                 if (CanDirectFetch(consensusParams) && pindex->nHeight >= ::ChainActive().Height() - MAX_CMPCTBLOCK_DEPTH) {
-                    if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
+                    if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && GetCachedHeaderHash(a_recent_compact_block->header) == pindex->GetBlockHash()) {
                         connman->PushMessage(&pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
                     } else {
                         CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness);
@@ -1773,14 +1809,14 @@ static void ProcessHeadersMessage(CNode& pfrom, CConnman* connman, ChainstateMan
             nodestate->nUnconnectingHeaders++;
             connman->PushMessage(&pfrom, msgMaker.Make(NetMsgType::GETHEADERS, ::ChainActive().GetLocator(pindexBestHeader), uint256()));
             LogPrint(BCLog::NET, "received header %s: missing prev block %s, sending getheaders (%d) to end (peer=%d, nUnconnectingHeaders=%d)\n",
-                    headers[0].GetHash().ToString(),
+                    GetCachedHeaderHash(headers[0]).ToString(),
                     headers[0].hashPrevBlock.ToString(),
                     pindexBestHeader->nHeight,
                     pfrom.GetId(), nodestate->nUnconnectingHeaders);
             // Set hashLastUnknownBlock for this peer, so that if we
             // eventually get the headers - even from a different peer -
             // we can use this peer to download.
-            UpdateBlockAvailability(pfrom.GetId(), headers.back().GetHash());
+            UpdateBlockAvailability(pfrom.GetId(), GetCachedHeaderHash(headers.back()));
 
             if (nodestate->nUnconnectingHeaders % MAX_UNCONNECTING_HEADERS == 0) {
                 Misbehaving(pfrom.GetId(), 20);
@@ -1794,7 +1830,7 @@ static void ProcessHeadersMessage(CNode& pfrom, CConnman* connman, ChainstateMan
                 Misbehaving(pfrom.GetId(), 20, "non-continuous headers sequence");
                 return;
             }
-            hashLastBlock = header.GetHash();
+            hashLastBlock = GetCachedHeaderHash(header);
         }
 
         // If we don't have the last header, then they'll have given us
@@ -2813,19 +2849,27 @@ void ProcessMessage(
         CInv inv(MSG_TX, tx.GetHash());
         pfrom.AddInventoryKnown(inv);
 
-        LOCK2(cs_main, g_cs_orphans);
-
         TxValidationState state;
+        std::list<CTransactionRef> lRemovedTxn;
+        bool already_have;
+        {
+            LOCK(cs_main);
+            CNodeState* nodestate = State(pfrom.GetId());
+            nodestate->m_tx_download.m_tx_announced.erase(inv.hash);
+            nodestate->m_tx_download.m_tx_in_flight.erase(inv.hash);
+            EraseTxRequest(inv.hash);
+            already_have = AlreadyHave(inv, mempool);
+        }
 
-        CNodeState* nodestate = State(pfrom.GetId());
-        nodestate->m_tx_download.m_tx_announced.erase(inv.hash);
-        nodestate->m_tx_download.m_tx_in_flight.erase(inv.hash);
-        EraseTxRequest(inv.hash);
+        // The scripts are verified without holding cs_main, so that blocks,
+        // RPC calls and the wallet are not held up meanwhile. Transactions
+        // from peers are still accepted one at a time on this thread.
+        const bool accepted = !already_have &&
+            AcceptToMemoryPoolStaged(mempool, state, ptx, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */);
 
-        std::list<CTransactionRef> lRemovedTxn;
+        LOCK2(cs_main, g_cs_orphans);
 
-        if (!AlreadyHave(inv, mempool) &&
-            AcceptToMemoryPool(mempool, state, ptx, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
+        if (accepted) {
             mempool.check(&::ChainstateActive().CoinsTip());
             RelayTransaction(tx.GetHash(), *connman);
             for (unsigned int i = 0; i < tx.vout.size(); i++) {
@@ -2949,6 +2993,8 @@ void ProcessMessage(
         vRecv >> cmpctblock;
 
         bool received_new_header = false;
+        // Peers relay the same block, so this is usually a cache hit.
+        const uint256 cmpctblock_hash = GetCachedHeaderHash(cmpctblock.header);
 
         {
         LOCK(cs_main);
@@ -2960,7 +3006,7 @@ void ProcessMessage(
             return;
         }
 
-        if (!LookupBlockIndex(cmpctblock.header.GetHash())) {
+        if (!LookupBlockIndex(cmpctblock_hash)) {
             received_new_header = true;
         }
         }
@@ -3016,7 +3062,7 @@ void ProcessMessage(
                 // We requested this block for some reason, but our mempool will probably be useless
                 // so we just grab the block via normal getdata
                 std::vector<CInv> vInv(1);
-                vInv[0] = CInv(MSG_BLOCK | GetFetchFlags(pfrom), cmpctblock.header.GetHash());
+                vInv[0] = CInv(MSG_BLOCK | GetFetchFlags(pfrom), cmpctblock_hash);
                 connman->PushMessage(&pfrom, msgMaker.Make(NetMsgType::GETDATA, vInv));
             }
             return;
@@ -3057,7 +3103,7 @@ void ProcessMessage(
                 } else if (status == READ_STATUS_FAILED) {
                     // Duplicate txindexes, the block is now in-flight, so just request it
                     std::vector<CInv> vInv(1);
-                    vInv[0] = CInv(MSG_BLOCK | GetFetchFlags(pfrom), cmpctblock.header.GetHash());
+                    vInv[0] = CInv(MSG_BLOCK | GetFetchFlags(pfrom), cmpctblock_hash);
                     connman->PushMessage(&pfrom, msgMaker.Make(NetMsgType::GETDATA, vInv));
                     return;
                 }
@@ -3070,7 +3116,7 @@ void ProcessMessage(
                 if (req.indexes.empty()) {
                     // Dirty hack to jump to BLOCKTXN code (TODO: move message handling into their own functions)
                     BlockTransactions txn;
-                    txn.blockhash = cmpctblock.header.GetHash();
+                    txn.blockhash = cmpctblock_hash;
                     blockTxnMsg << txn;
                     fProcessBLOCKTXN = true;
                 } else {
@@ -3100,7 +3146,7 @@ void ProcessMessage(
                 // We requested this block, but its far into the future, so our
                 // mempool will probably be useless - request the block normally
                 std::vector<CInv> vInv(1);
-                vInv[0] = CInv(MSG_BLOCK | GetFetchFlags(pfrom), cmpctblock.header.GetHash());
+                vInv[0] = CInv(MSG_BLOCK | GetFetchFlags(pfrom), cmpctblock_hash);
                 connman->PushMessage(&pfrom, msgMaker.Make(NetMsgType::GETDATA, vInv));
                 return;
             } else {
@@ -3276,6 +3322,7 @@ void ProcessMessage(
 
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         vRecv >> *pblock;
+        pblock->SetCachedHash(GetCachedHeaderHash(*pblock));
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom.GetId());
 
@@ -4306,6 +4353,10 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
             FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            if (!pto->m_limited_node) {
+                // Fill the rest of the peer's slots with blocks for background validation.
+                FindNextHistoricalBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight - vToDownload.size(), vToDownload, consensusParams);
+            }
             for (const CBlockIndex *pindex : vToDownload) {
                 uint32_t nFetchFlags = GetFetchFlags(*pto);
                 vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindex->GetBlockHash()));
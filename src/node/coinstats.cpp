@@ -7,13 +7,91 @@
 
 #include <coins.h>
 #include <hash.h>
+#include <primitives/block.h>
 #include <serialize.h>
+#include <undo.h>
 #include <validation.h>
 #include <uint256.h>
 #include <util/system.h>
 
 #include <map>
 
+static uint64_t GetBogoSize(const CScript& script_pub_key)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + script_pub_key.size() /* scriptPubKey */;
+}
+
+//! Serialize a coin the way it is committed to by the rolling MuHash.
+static void TxOutSer(CDataStream& ss, const COutPoint& outpoint, const Coin& coin)
+{
+    ss << outpoint;
+    ss << static_cast<uint32_t>(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+}
+
+void RollingCoinsStats::AddCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    TxOutSer(ss, outpoint, coin);
+    m_muhash.Insert({(const unsigned char*)ss.data(), ss.size()});
+    ++m_coins_count;
+    m_bogo_size += GetBogoSize(coin.out.scriptPubKey);
+    m_total_amount += coin.out.nValue;
+}
+
+void RollingCoinsStats::RemoveCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    TxOutSer(ss, outpoint, coin);
+    m_muhash.Remove({(const unsigned char*)ss.data(), ss.size()});
+    --m_coins_count;
+    m_bogo_size -= GetBogoSize(coin.out.scriptPubKey);
+    m_total_amount -= coin.out.nValue;
+}
+
+bool RollingCoinsStats::ApplyBlock(const CBlock& block, const CBlockUndo& blockundo, int height, bool connect)
+{
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size()) return false;
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const CTransaction& tx = *block.vtx[i];
+        const bool is_coinbase = tx.IsCoinBase();
+        for (size_t j = 0; j < tx.vout.size(); ++j) {
+            // Mirrors AddCoins(), which never adds unspendable outputs.
+            if (tx.vout[j].scriptPubKey.IsUnspendable()) continue;
+            const COutPoint outpoint(tx.GetHash(), j);
+            const Coin coin(tx.vout[j], height, is_coinbase);
+            if (connect) {
+                AddCoin(outpoint, coin);
+            } else {
+                RemoveCoin(outpoint, coin);
+            }
+        }
+        if (is_coinbase) continue;
+
+        const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+        if (txundo.vprevout.size() != tx.vin.size()) return false;
+        for (size_t j = 0; j < tx.vin.size(); ++j) {
+            if (connect) {
+                RemoveCoin(tx.vin[j].prevout, txundo.vprevout[j]);
+            } else {
+                AddCoin(tx.vin[j].prevout, txundo.vprevout[j]);
+            }
+        }
+    }
+    return true;
+}
+
+void RollingCoinsStats::GetStats(CCoinsStats& stats) const
+{
+    m_muhash.Finalize(stats.hashSerialized);
+    stats.nTransactionOutputs = m_coins_count;
+    stats.coins_count = m_coins_count;
+    stats.nBogoSize = m_bogo_size;
+    stats.nTotalAmount = m_total_amount;
+    stats.from_rolling_stats = true;
+}
+
 static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
 {
     assert(!outputs.empty());
@@ -26,8 +104,7 @@ static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash,
         ss << VARINT_MODE(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
         stats.nTransactionOutputs++;
         stats.nTotalAmount += output.second.out.nValue;
-        stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
-                           2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
+        stats.nBogoSize += GetBogoSize(output.second.out.scriptPubKey);
     }
     ss << VARINT(0u);
 }
@@ -72,3 +149,24 @@ bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, const std::function<void
     stats.nDiskSize = view->EstimateSize();
     return true;
 }
+
+bool ComputeRollingCoinsStats(CCoinsView* view, RollingCoinsStats& stats, uint256& best_block, const std::function<void()>& interruption_point)
+{
+    stats = RollingCoinsStats();
+    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
+    assert(pcursor);
+
+    best_block = pcursor->GetBestBlock();
+    while (pcursor->Valid()) {
+        interruption_point();
+        COutPoint key;
+        Coin coin;
+        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+            stats.AddCoin(key, coin);
+        } else {
+            return error("%s: unable to read value", __func__);
+        }
+        pcursor->Next();
+    }
+    return true;
+}
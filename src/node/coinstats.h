@@ -7,12 +7,18 @@
 #define PEXA_NODE_COINSTATS_H
 
 #include <amount.h>
+#include <crypto/muhash.h>
+#include <serialize.h>
 #include <uint256.h>
 
 #include <cstdint>
 #include <functional>
 
+class CBlock;
+class CBlockUndo;
 class CCoinsView;
+class COutPoint;
+class Coin;
 
 struct CCoinsStats
 {
@@ -27,9 +33,67 @@ struct CCoinsStats
 
     //! The number of coins contained.
     uint64_t coins_count{0};
+
+    //! Whether the statistics came from RollingCoinsStats rather than a scan
+    //! of the coins database. nTransactions is not known in that case, and
+    //! hashSerialized holds the MuHash of the set.
+    bool from_rolling_stats{false};
+
+    //! Whether the statistics came from the coin statistics index, which also
+    //! fills in the running totals below.
+    bool index_used{false};
+
+    //! Total block subsidy up to and including this block.
+    CAmount total_subsidy{0};
+    //! Amounts that left the UTXO set for good: the sum of the three below.
+    CAmount total_unspendable_amount{0};
+    //! Amounts of the coins spent by transactions.
+    CAmount total_prevout_spent_amount{0};
+    //! Amounts of spendable outputs created by transactions other than coinbases.
+    CAmount total_new_outputs_ex_coinbase_amount{0};
+    //! Amounts of spendable outputs created by coinbases.
+    CAmount total_coinbase_amount{0};
+    //! The genesis block outputs, which are never added to the UTXO set.
+    CAmount total_unspendables_genesis_block{0};
+    //! Outputs with unspendable scripts, e.g. OP_RETURN.
+    CAmount total_unspendables_scripts{0};
+    //! Subsidy and fees coinbases did not claim.
+    CAmount total_unspendables_unclaimed_rewards{0};
+};
+
+/**
+ * Statistics about the UTXO set that can be kept up to date coin by coin:
+ * a MuHash3072 commitment to the set and its totals. Unlike the
+ * hashSerialized of a scan, they can be updated as blocks are connected and
+ * disconnected instead of being recomputed from the whole coins database.
+ */
+class RollingCoinsStats
+{
+public:
+    MuHash3072 m_muhash;
+    uint64_t m_coins_count{0};
+    uint64_t m_bogo_size{0};
+    CAmount m_total_amount{0};
+
+    void AddCoin(const COutPoint& outpoint, const Coin& coin);
+    void RemoveCoin(const COutPoint& outpoint, const Coin& coin);
+
+    //! Apply the coins a block at the given height creates and spends, or
+    //! revert them when connect is false. Returns false, leaving the
+    //! statistics partially updated, if blockundo does not match the block.
+    bool ApplyBlock(const CBlock& block, const CBlockUndo& blockundo, int height, bool connect);
+
+    //! Fill in the fields of stats covered by these statistics.
+    void GetStats(CCoinsStats& stats) const;
+
+    SERIALIZE_METHODS(RollingCoinsStats, obj) { READWRITE(obj.m_muhash, obj.m_coins_count, obj.m_bogo_size, obj.m_total_amount); }
 };
 
 //! Calculate statistics about the unspent transaction output set
 bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, const std::function<void()>& interruption_point = {});
 
+//! Compute RollingCoinsStats from scratch by scanning the coins in view. Sets
+//! best_block to the block the scanned coins correspond to.
+bool ComputeRollingCoinsStats(CCoinsView* view, RollingCoinsStats& stats, uint256& best_block, const std::function<void()>& interruption_point = {});
+
 #endif // PEXA_NODE_COINSTATS_H
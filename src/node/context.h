@@ -11,6 +11,7 @@
 
 class ArgsManager;
 class BanMan;
+class BlockTemplateBuilder;
 class CConnman;
 class CScheduler;
 class CTxMemPool;
@@ -41,6 +42,7 @@ struct NodeContext {
     std::unique_ptr<interfaces::Chain> chain;
     std::vector<std::unique_ptr<interfaces::ChainClient>> chain_clients;
     std::unique_ptr<CScheduler> scheduler;
+    std::unique_ptr<BlockTemplateBuilder> block_template_builder;
 
     //! Declare default constructor and destructor that are not inline, so code
     //! instantiating the NodeContext struct doesn't need to #include class
@@ -24,6 +24,7 @@ TransactionError BroadcastTransaction(NodeContext& node, const CTransactionRef t
     uint256 hashTx = tx->GetHash();
     bool callback_set = false;
 
+    bool in_mempool;
     { // cs_main scope
     LOCK(cs_main);
     // If the transaction is already confirmed in the chain, don't do anything
@@ -35,11 +36,17 @@ TransactionError BroadcastTransaction(NodeContext& node, const CTransactionRef t
         // So if the output does exist, then this transaction exists in the chain.
         if (!existingCoin.IsSpent()) return TransactionError::ALREADY_IN_CHAIN;
     }
-    if (!node.mempool->exists(hashTx)) {
-        // Transaction is not already in the mempool. Submit it.
+    in_mempool = node.mempool->exists(hashTx);
+    } // cs_main
+
+    if (!in_mempool) {
+        // Transaction is not already in the mempool. Submit it, verifying its
+        // scripts without holding cs_main. A concurrent submission of the same
+        // transaction may have added it meanwhile, which is not an error.
         TxValidationState state;
-        if (!AcceptToMemoryPool(*node.mempool, state, std::move(tx),
-                nullptr /* plTxnReplaced */, false /* bypass_limits */, max_tx_fee)) {
+        if (!AcceptToMemoryPoolStaged(*node.mempool, state, std::move(tx),
+                nullptr /* plTxnReplaced */, false /* bypass_limits */, max_tx_fee) &&
+            state.GetRejectReason() != "txn-already-in-mempool") {
             err_string = state.ToString();
             if (state.IsInvalid()) {
                 if (state.GetResult() == TxValidationResult::TX_MISSING_INPUTS) {
@@ -69,8 +76,6 @@ TransactionError BroadcastTransaction(NodeContext& node, const CTransactionRef t
         }
     }
 
-    } // cs_main
-
     if (callback_set) {
         // Wait until Validation Interface clients have been notified of the
         // transaction entering the mempool.
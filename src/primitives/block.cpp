@@ -13,6 +13,9 @@
 #include <util/strencodings.h>
 #include <crypto/common.h>
 
+#include <cstddef>
+#include <string.h>
+
 
 static const uint32_t MAINNET_X16RV2ACTIVATIONTIME = 1568678400;
 static const uint32_t TESTNET_X16RV2ACTIVATIONTIME = 1568158500;
@@ -35,7 +38,7 @@ void BlockNetwork::SetNetwork(const std::string& net)
     }
 }
 
-uint256 CBlockHeader::GetHash() const
+bool CBlockHeader::IsX16RV2() const
 {
     uint32_t nTimeToUse = MAINNET_X16RV2ACTIVATIONTIME;
     if (bNetwork.fOnTestnet) {
@@ -43,7 +46,12 @@ uint256 CBlockHeader::GetHash() const
     } else if (bNetwork.fOnRegtest) {
         nTimeToUse = REGTEST_X16RV2ACTIVATIONTIME;
     }
-    if (nTime >= nTimeToUse) {
+    return nTime >= nTimeToUse;
+}
+
+uint256 CBlockHeader::GetHash() const
+{
+    if (IsX16RV2()) {
         return HashX16RV2(BEGIN(nVersion), END(nNonce), hashPrevBlock);
     }
 
@@ -60,6 +68,63 @@ uint256 CBlockHeader::GetX16RV2Hash() const
     return HashX16RV2(BEGIN(nVersion), END(nNonce), hashPrevBlock);
 }
 
+// The hash cache compares the header fields as the 80 bytes from nVersion to nNonce.
+static_assert(offsetof(CBlockHeader, nNonce) + sizeof(uint32_t) - offsetof(CBlockHeader, nVersion) == 80, "the header fields must be contiguous");
+
+CBlock::HashCache::HashCache(const HashCache& other)
+{
+    *this = other;
+}
+
+CBlock::HashCache& CBlock::HashCache::operator=(const HashCache& other)
+{
+    if (this == &other) return *this;
+    bool valid;
+    unsigned char header[sizeof(m_header)];
+    uint256 hash;
+    {
+        std::lock_guard<std::mutex> lock(other.m_mutex);
+        valid = other.m_valid;
+        memcpy(header, other.m_header, sizeof(header));
+        hash = other.m_hash;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_valid = valid;
+    memcpy(m_header, header, sizeof(m_header));
+    m_hash = hash;
+    return *this;
+}
+
+bool CBlock::HashCache::Get(const unsigned char* header, uint256& hash) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_valid || memcmp(m_header, header, sizeof(m_header)) != 0) return false;
+    hash = m_hash;
+    return true;
+}
+
+void CBlock::HashCache::Set(const unsigned char* header, const uint256& hash)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    memcpy(m_header, header, sizeof(m_header));
+    m_hash = hash;
+    m_valid = true;
+}
+
+uint256 CBlock::GetHash() const
+{
+    uint256 hash;
+    if (m_hash_cache.Get((const unsigned char*)BEGIN(nVersion), hash)) return hash;
+    hash = ComputeHash();
+    SetCachedHash(hash);
+    return hash;
+}
+
+void CBlock::SetCachedHash(const uint256& hash) const
+{
+    m_hash_cache.Set((const unsigned char*)BEGIN(nVersion), hash);
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
@@ -10,6 +10,8 @@
 #include <serialize.h>
 #include <uint256.h>
 
+#include <mutex>
+
 class BlockNetwork
 {
 public:
@@ -62,6 +64,8 @@ public:
     }
 
     uint256 GetHash() const;
+    /** Whether the proof-of-work hash of this header is X16RV2 rather than X16R. */
+    bool IsX16RV2() const;
     uint256 GetX16RHash() const;
     uint256 GetX16RV2Hash() const;
 
@@ -79,6 +83,26 @@ public:
 
 class CBlock : public CBlockHeader
 {
+private:
+    /** A proof-of-work hash and the header bytes it was computed for. Copies of a block take it along. */
+    class HashCache
+    {
+    public:
+        HashCache() {}
+        HashCache(const HashCache& other);
+        HashCache& operator=(const HashCache& other);
+
+        /** Set hash to the cached hash, if it was computed for these header bytes. */
+        bool Get(const unsigned char* header, uint256& hash) const;
+        void Set(const unsigned char* header, const uint256& hash);
+
+    private:
+        mutable std::mutex m_mutex;
+        bool m_valid{false};
+        unsigned char m_header[80];
+        uint256 m_hash;
+    };
+
 public:
     // network and disk
     std::vector<CTransactionRef> vtx;
@@ -122,7 +146,18 @@ public:
         return block;
     }
 
+    /** Return the proof-of-work hash, reusing the last result while the header fields are unchanged. */
+    uint256 GetHash() const;
+    /** Hash the header without consulting or updating the cached hash. */
+    uint256 ComputeHash() const { return CBlockHeader::GetHash(); }
+    /** Record an already known hash (e.g. from the block index) for the current header fields. */
+    void SetCachedHash(const uint256& hash) const;
+
     std::string ToString() const;
+
+private:
+    // memory only
+    mutable HashCache m_hash_cache;
 };
 
 /** Describes a place in the block chain to another node such that if the
@@ -309,6 +309,100 @@ static bool rest_chaininfo(const util::Ref& context, HTTPRequest* req, const std
     }
 }
 
+UniValue getscripthistory(const JSONRPCRequest& request);
+UniValue getscriptunspent(const JSONRPCRequest& request);
+
+/** The REST status for an error thrown by the script index RPCs. */
+static HTTPStatusCode ScriptRPCErrorStatus(const UniValue& objError)
+{
+    switch (find_value(objError, "code").get_int()) {
+    case RPC_INVALID_PARAMETER:
+    case RPC_INVALID_ADDRESS_OR_KEY:
+    case RPC_TYPE_ERROR:
+        return HTTP_BAD_REQUEST;
+    case RPC_MISC_ERROR: // the script index is disabled or still syncing
+        return HTTP_SERVICE_UNAVAILABLE;
+    default:
+        return HTTP_INTERNAL_SERVER_ERROR;
+    }
+}
+
+/**
+ * Answer a request for the history (/<script>[/<count>[/<height>/<tx_pos>/<vin|vout>/<n>]])
+ * or the unspent outputs (/<script>[/<count>[/<txid>/<vout>]]) of a script
+ * with the matching RPC. The trailing parts are the entry to resume after.
+ */
+static bool rest_script_rpc(const util::Ref& context, HTTPRequest* req, const std::string& strURIPart, bool history)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    const size_t after_parts = history ? 4 : 2;
+    if (path.size() != 1 && path.size() != 2 && path.size() != 2 + after_parts) {
+        return RESTERR(req, HTTP_BAD_REQUEST, history ? "Use /rest/scripthistory/<script>[/<count>[/<height>/<tx_pos>/<vin|vout>/<n>]].json"
+                                                      : "Use /rest/scriptunspent/<script>[/<count>[/<txid>/<vout>]].json");
+    }
+
+    JSONRPCRequest jsonRequest(context);
+    jsonRequest.params = UniValue(UniValue::VARR);
+    jsonRequest.params.push_back(path[0]);
+    if (history) jsonRequest.params.push_back(0); // from_height
+    if (path.size() > 1) {
+        int32_t count;
+        if (!ParseInt32(path[1], &count)) return RESTERR(req, HTTP_BAD_REQUEST, "Invalid count: " + path[1]);
+        jsonRequest.params.push_back(count);
+    }
+    if (path.size() > 2) {
+        UniValue after(UniValue::VOBJ);
+        int32_t height, tx_pos, n;
+        if (history) {
+            if (!ParseInt32(path[2], &height) || !ParseInt32(path[3], &tx_pos) || (path[4] != "vin" && path[4] != "vout") || !ParseInt32(path[5], &n)) {
+                return RESTERR(req, HTTP_BAD_REQUEST, "Invalid entry to resume after");
+            }
+            after.pushKV("height", height);
+            after.pushKV("tx_pos", tx_pos);
+            after.pushKV(path[4], n);
+        } else {
+            if (!ParseInt32(path[3], &n)) return RESTERR(req, HTTP_BAD_REQUEST, "Invalid output to resume after");
+            after.pushKV("txid", path[2]);
+            after.pushKV("vout", n);
+        }
+        jsonRequest.params.push_back(after);
+    }
+
+    switch (rf) {
+    case RetFormat::JSON: {
+        UniValue result;
+        try {
+            result = history ? getscripthistory(jsonRequest) : getscriptunspent(jsonRequest);
+        } catch (const UniValue& objError) {
+            return RESTERR(req, ScriptRPCErrorStatus(objError), find_value(objError, "message").get_str());
+        }
+        std::string strJSON = result.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+}
+
+static bool rest_script_history(const util::Ref& context, HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_script_rpc(context, req, strURIPart, /* history */ true);
+}
+
+static bool rest_script_unspent(const util::Ref& context, HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_script_rpc(context, req, strURIPart, /* history */ false);
+}
+
 static bool rest_mempool_info(const util::Ref& context, HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -657,6 +751,8 @@ static const struct {
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      {"/rest/scripthistory/", rest_script_history},
+      {"/rest/scriptunspent/", rest_script_unspent},
 };
 
 void StartREST(const util::Ref& context)
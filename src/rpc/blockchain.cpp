@@ -14,6 +14,9 @@
 #include <core_io.h>
 #include <hash.h>
 #include <index/blockfilterindex.h>
+#include <index/coinstatsindex.h>
+#include <index/scriptindex.h>
+#include <key_io.h>
 #include <node/coinstats.h>
 #include <node/context.h>
 #include <node/utxo_snapshot.h>
@@ -24,6 +27,7 @@
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
+#include <script/standard.h>
 #include <streams.h>
 #include <sync.h>
 #include <txdb.h>
@@ -460,9 +464,8 @@ static void entryToJSON(const CTxMemPool& pool, UniValue& info, const CTxMemPool
 
     UniValue spent(UniValue::VARR);
     const CTxMemPool::txiter& it = pool.mapTx.find(tx.GetHash());
-    const CTxMemPool::setEntries& setChildren = pool.GetMemPoolChildren(it);
-    for (CTxMemPool::txiter childiter : setChildren) {
-        spent.push_back(childiter->GetTx().GetHash().ToString());
+    for (const CTxMemPoolEntry* child : pool.GetMemPoolChildren(it)) {
+        spent.push_back(child->GetTx().GetHash().ToString());
     }
 
     info.pushKV("spentby", spent);
@@ -967,45 +970,165 @@ static UniValue pruneblockchain(const JSONRPCRequest& request)
     return uint64_t(block->nHeight);
 }
 
+static CBlockIndex* ParseHashOrHeight(const UniValue& param) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    CBlockIndex* pindex;
+    if (param.isNum()) {
+        const int height = param.get_int();
+        const int current_tip = ::ChainActive().Height();
+        if (height < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is negative", height));
+        }
+        if (height > current_tip) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d after current tip %d", height, current_tip));
+        }
+
+        pindex = ::ChainActive()[height];
+    } else {
+        const uint256 hash(ParseHashV(param, "hash_or_height"));
+        pindex = LookupBlockIndex(hash);
+        if (!pindex) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        if (!::ChainActive().Contains(pindex)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block is not in chain %s", Params().NetworkIDString()));
+        }
+    }
+
+    CHECK_NONFATAL(pindex != nullptr);
+    return pindex;
+}
+
 static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
             RPCHelpMan{"gettxoutsetinfo",
                 "\nReturns statistics about the unspent transaction output set.\n"
-                "Note this call may take some time.\n",
-                {},
+                "Note this call may take some time, unless the muhash hash_type is used, or the coinstatsindex is.\n",
+                {
+                    {"hash_type", RPCArg::Type::STR, /* default */ "hash_serialized_2", "Which UTXO set hash should be calculated. Options: 'hash_serialized_2' (the legacy algorithm, which scans the whole set), 'muhash' (kept up to date as blocks are connected and disconnected)."},
+                    {"hash_or_height", RPCArg::Type::NUM, /* default */ "the current best block", "The block hash or height of the target height (only available with coinstatsindex and the muhash hash_type).", "", {"", "string or numeric"}},
+                    {"use_index", RPCArg::Type::BOOL, /* default */ "true", "Use coinstatsindex, if available."},
+                },
                 RPCResult{
                     RPCResult::Type::OBJ, "", "",
                     {
-                        {RPCResult::Type::NUM, "height", "The current block height (index)"},
-                        {RPCResult::Type::STR_HEX, "bestblock", "The hash of the block at the tip of the chain"},
-                        {RPCResult::Type::NUM, "transactions", "The number of transactions with unspent outputs"},
+                        {RPCResult::Type::NUM, "height", "The block height (index) of the returned statistics"},
+                        {RPCResult::Type::STR_HEX, "bestblock", "The hash of the block at which these statistics are calculated"},
+                        {RPCResult::Type::NUM, "transactions", /* optional */ true, "The number of transactions with unspent outputs (not available when hash_type is 'muhash')"},
                         {RPCResult::Type::NUM, "txouts", "The number of unspent transaction outputs"},
                         {RPCResult::Type::NUM, "bogosize", "A meaningless metric for UTXO set size"},
-                        {RPCResult::Type::STR_HEX, "hash_serialized_2", "The serialized hash"},
-                        {RPCResult::Type::NUM, "disk_size", "The estimated size of the chainstate on disk"},
-                        {RPCResult::Type::STR_AMOUNT, "total_amount", "The total amount"},
+                        {RPCResult::Type::STR_HEX, "hash_serialized_2", /* optional */ true, "The serialized hash (only present if 'hash_serialized_2' hash_type is chosen)"},
+                        {RPCResult::Type::STR_HEX, "muhash", /* optional */ true, "The MuHash3072 of the set (only present if 'muhash' hash_type is chosen)"},
+                        {RPCResult::Type::NUM, "disk_size", /* optional */ true, "The estimated size of the chainstate on disk (not available when coinstatsindex is used)"},
+                        {RPCResult::Type::STR_AMOUNT, "total_amount", "The total amount of coins in the UTXO set"},
+                        {RPCResult::Type::STR_AMOUNT, "total_unspendable_amount", /* optional */ true, "The total amount of coins permanently excluded from the UTXO set (only available if coinstatsindex is used)"},
+                        {RPCResult::Type::OBJ, "block_info", /* optional */ true, "Info on amounts in the block at this block height (only available if coinstatsindex is used)",
+                        {
+                            {RPCResult::Type::STR_AMOUNT, "prevout_spent", "Total amount of all prevouts spent in this block"},
+                            {RPCResult::Type::STR_AMOUNT, "coinbase", "Coinbase subsidy amount of this block"},
+                            {RPCResult::Type::STR_AMOUNT, "new_outputs_ex_coinbase", "Total amount of new outputs created by this block"},
+                            {RPCResult::Type::STR_AMOUNT, "unspendable", "Total amount of unspendable outputs created in this block"},
+                            {RPCResult::Type::OBJ, "unspendables", "Detailed view of the unspendable categories",
+                            {
+                                {RPCResult::Type::STR_AMOUNT, "genesis_block", "The unspendable amount of the Genesis block subsidy"},
+                                {RPCResult::Type::STR_AMOUNT, "scripts", "Amounts sent to scripts that are unspendable (for example OP_RETURN outputs)"},
+                                {RPCResult::Type::STR_AMOUNT, "unclaimed_rewards", "Fee rewards that miners did not claim in their coinbase transaction"},
+                            }}
+                        }},
                     }},
                 RPCExamples{
                     HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", R"("muhash")")
+            + HelpExampleCli("gettxoutsetinfo", R"("muhash" 1000)")
+            + HelpExampleCli("gettxoutsetinfo", R"("muhash" '"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09"')")
             + HelpExampleRpc("gettxoutsetinfo", "")
+            + HelpExampleRpc("gettxoutsetinfo", R"("muhash", 1000)")
                 },
             }.Check(request);
 
     UniValue ret(UniValue::VOBJ);
 
+    const std::string hash_type = request.params[0].isNull() ? "hash_serialized_2" : request.params[0].get_str();
+    if (hash_type != "hash_serialized_2" && hash_type != "muhash") {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("%s is not a valid hash_type", hash_type));
+    }
+    const bool index_requested = request.params[2].isNull() || request.params[2].get_bool();
+    // The index only commits to the MuHash of the set.
+    const bool use_index = index_requested && hash_type == "muhash" && g_coin_stats_index;
+
     CCoinsStats stats;
-    ::ChainstateActive().ForceFlushStateToDisk();
+    bool found;
+    if (!request.params[1].isNull()) {
+        if (!g_coin_stats_index) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Querying specific block heights requires coinstatsindex");
+        }
+        if (hash_type != "muhash") {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "hash_serialized_2 hash type cannot be queried for a specific block");
+        }
+        if (!index_requested) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Querying specific block heights requires use_index");
+        }
+    }
 
-    CCoinsView* coins_view = WITH_LOCK(cs_main, return &ChainstateActive().CoinsDB());
-    if (GetUTXOStats(coins_view, stats, RpcInterruptionPoint)) {
+    if (use_index) {
+        // Let the index catch up with the blocks connected so far, so that
+        // the tip can be looked up in it.
+        g_coin_stats_index->BlockUntilSyncedToCurrentChain();
+        const CBlockIndex* pindex = WITH_LOCK(cs_main, return request.params[1].isNull() ? ::ChainActive().Tip() : ParseHashOrHeight(request.params[1]));
+        found = g_coin_stats_index->LookUpStats(pindex, stats);
+        if (!found && request.params[1].isNull()) {
+            // The index is still syncing; answer from the rolling statistics.
+            found = ::ChainstateActive().GetRollingCoinsStats(stats, RpcInterruptionPoint);
+        } else if (!found) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set statistics; coinstatsindex may still be syncing");
+        }
+    } else if (hash_type == "muhash") {
+        found = ::ChainstateActive().GetRollingCoinsStats(stats, RpcInterruptionPoint);
+    } else {
+        ::ChainstateActive().ForceFlushStateToDisk();
+        CCoinsView* coins_view = WITH_LOCK(cs_main, return &ChainstateActive().CoinsDB());
+        found = GetUTXOStats(coins_view, stats, RpcInterruptionPoint);
+    }
+    if (found) {
         ret.pushKV("height", (int64_t)stats.nHeight);
         ret.pushKV("bestblock", stats.hashBlock.GetHex());
-        ret.pushKV("transactions", (int64_t)stats.nTransactions);
+        if (!stats.from_rolling_stats && !stats.index_used) {
+            ret.pushKV("transactions", (int64_t)stats.nTransactions);
+        }
         ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
         ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
-        ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
-        ret.pushKV("disk_size", stats.nDiskSize);
+        ret.pushKV(hash_type, stats.hashSerialized.GetHex());
+        if (!stats.index_used) {
+            ret.pushKV("disk_size", stats.nDiskSize);
+        }
         ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+        if (stats.index_used) {
+            // The per-block amounts are the differences between the running
+            // totals of this block and of its parent.
+            CCoinsStats prev_stats;
+            if (stats.nHeight > 0) {
+                const CBlockIndex* pprev = WITH_LOCK(cs_main, return LookupBlockIndex(stats.hashBlock)->pprev);
+                if (!g_coin_stats_index->LookUpStats(pprev, prev_stats)) {
+                    throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set statistics of the previous block");
+                }
+            }
+
+            ret.pushKV("total_unspendable_amount", ValueFromAmount(stats.total_unspendable_amount));
+
+            UniValue block_info(UniValue::VOBJ);
+            block_info.pushKV("prevout_spent", ValueFromAmount(stats.total_prevout_spent_amount - prev_stats.total_prevout_spent_amount));
+            block_info.pushKV("coinbase", ValueFromAmount(stats.total_coinbase_amount - prev_stats.total_coinbase_amount));
+            block_info.pushKV("new_outputs_ex_coinbase", ValueFromAmount(stats.total_new_outputs_ex_coinbase_amount - prev_stats.total_new_outputs_ex_coinbase_amount));
+            block_info.pushKV("unspendable", ValueFromAmount(stats.total_unspendable_amount - prev_stats.total_unspendable_amount));
+
+            UniValue unspendables(UniValue::VOBJ);
+            unspendables.pushKV("genesis_block", ValueFromAmount(stats.total_unspendables_genesis_block - prev_stats.total_unspendables_genesis_block));
+            unspendables.pushKV("scripts", ValueFromAmount(stats.total_unspendables_scripts - prev_stats.total_unspendables_scripts));
+            unspendables.pushKV("unclaimed_rewards", ValueFromAmount(stats.total_unspendables_unclaimed_rewards - prev_stats.total_unspendables_unclaimed_rewards));
+            block_info.pushKV("unspendables", unspendables);
+
+            ret.pushKV("block_info", block_info);
+        }
     } else {
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
     }
@@ -1754,30 +1877,7 @@ static UniValue getblockstats(const JSONRPCRequest& request)
 
     LOCK(cs_main);
 
-    CBlockIndex* pindex;
-    if (request.params[0].isNum()) {
-        const int height = request.params[0].get_int();
-        const int current_tip = ::ChainActive().Height();
-        if (height < 0) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is negative", height));
-        }
-        if (height > current_tip) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d after current tip %d", height, current_tip));
-        }
-
-        pindex = ::ChainActive()[height];
-    } else {
-        const uint256 hash(ParseHashV(request.params[0], "hash_or_height"));
-        pindex = LookupBlockIndex(hash);
-        if (!pindex) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-        }
-        if (!::ChainActive().Contains(pindex)) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block is not in chain %s", Params().NetworkIDString()));
-        }
-    }
-
-    CHECK_NONFATAL(pindex != nullptr);
+    CBlockIndex* pindex = ParseHashOrHeight(request.params[0]);
 
     std::set<std::string> stats;
     if (!request.params[1].isNull()) {
@@ -2257,6 +2357,206 @@ static UniValue getblockfilter(const JSONRPCRequest& request)
     return ret;
 }
 
+static CScript ParseScriptOrAddress(const UniValue& param)
+{
+    const std::string& str = param.get_str();
+    const CTxDestination dest = DecodeDestination(str);
+    if (IsValidDestination(dest)) {
+        return GetScriptForDestination(dest);
+    }
+    if (!str.empty() && IsHex(str)) {
+        const std::vector<unsigned char> data(ParseHex(str));
+        return CScript(data.begin(), data.end());
+    }
+    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address or script: " + str);
+}
+
+static const ScriptIndex& EnsureScriptIndex()
+{
+    if (!g_script_index) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Script index is not enabled; start with -scriptindex");
+    }
+    // A partially synced index would return an incomplete history.
+    if (!g_script_index->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Scripts are still in the process of being indexed");
+    }
+    return *g_script_index;
+}
+
+UniValue getscripthistory(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"getscripthistory",
+        "\nReturns the confirmed transactions that pay to an address or output script, or spend from it, oldest first.\n"
+        "To page through a long history, pass the last entry returned as \"after\" to get the entries that follow it.\n"
+        "Requires -scriptindex.\n",
+        {
+            {"script", RPCArg::Type::STR, RPCArg::Optional::NO, "The address, or the output script as hex"},
+            {"from_height", RPCArg::Type::NUM, /* default */ "0", "Skip blocks below this height"},
+            {"count", RPCArg::Type::NUM, /* default */ "1000", "The maximum number of entries to return"},
+            {"after", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED_NAMED_ARG, "Only return the entries after this one",
+                {
+                    {"height", RPCArg::Type::NUM, RPCArg::Optional::NO, "The height of the entry"},
+                    {"tx_pos", RPCArg::Type::NUM, RPCArg::Optional::NO, "The position of the transaction in its block"},
+                    {"vout", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "The output index, for an entry paying to the script"},
+                    {"vin", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "The input index, for an entry spending from the script"},
+                },
+            },
+        },
+        RPCResult{
+            RPCResult::Type::ARR, "", "",
+            {
+                {RPCResult::Type::OBJ, "", "",
+                {
+                    {RPCResult::Type::NUM, "height", "The height of the block the transaction is in"},
+                    {RPCResult::Type::NUM, "tx_pos", "The position of the transaction in the block"},
+                    {RPCResult::Type::STR_HEX, "txid", "The transaction id"},
+                    {RPCResult::Type::NUM, "vout", /* optional */ true, "The index of the output paying to the script"},
+                    {RPCResult::Type::NUM, "vin", /* optional */ true, "The index of the input spending an output paying to the script"},
+                    {RPCResult::Type::STR_AMOUNT, "amount", "The amount received, or spent, in " + CURRENCY_UNIT},
+                }},
+            }},
+        RPCExamples{
+            HelpExampleCli("getscripthistory", "\"mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn\"")
+            + HelpExampleCli("getscripthistory", "\"mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn\" 1000 50")
+            + HelpExampleCli("getscripthistory", "\"mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn\" 0 50 '{\"height\": 1200, \"tx_pos\": 3, \"vout\": 1}'")
+            + HelpExampleRpc("getscripthistory", "\"mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn\", 1000, 50")
+        },
+    }.Check(request);
+
+    const CScript script = ParseScriptOrAddress(request.params[0]);
+    const int from_height = request.params[1].isNull() ? 0 : request.params[1].get_int();
+    const int count = request.params[2].isNull() ? 1000 : request.params[2].get_int();
+    if (count < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+    }
+
+    ScriptHistoryEntry after{};
+    if (!request.params[3].isNull()) {
+        const UniValue& after_obj = request.params[3].get_obj();
+        RPCTypeCheckObj(after_obj,
+            {
+                {"height", UniValueType(UniValue::VNUM)},
+                {"tx_pos", UniValueType(UniValue::VNUM)},
+                {"vout", UniValueType(UniValue::VNUM)},
+                {"vin", UniValueType(UniValue::VNUM)},
+            }, /* fAllowNull */ true, /* fStrict */ false);
+        const UniValue& vout = find_value(after_obj, "vout");
+        const UniValue& vin = find_value(after_obj, "vin");
+        if (find_value(after_obj, "height").isNull() || find_value(after_obj, "tx_pos").isNull() || vout.isNull() == vin.isNull()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "after needs height, tx_pos, and either vout or vin");
+        }
+        const int height = find_value(after_obj, "height").get_int();
+        const int tx_pos = find_value(after_obj, "tx_pos").get_int();
+        const int n = vout.isNull() ? vin.get_int() : vout.get_int();
+        if (height < 0 || tx_pos < 0 || n < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative value in after");
+        }
+        after.height = height;
+        after.tx_pos = tx_pos;
+        after.spending = !vin.isNull();
+        after.n = n;
+    }
+
+    std::vector<ScriptHistoryEntry> entries;
+    if (!EnsureScriptIndex().FindScriptHistory(script, from_height, count, entries, request.params[3].isNull() ? nullptr : &after)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the script index");
+    }
+
+    UniValue ret(UniValue::VARR);
+    for (const ScriptHistoryEntry& entry : entries) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("height", entry.height);
+        obj.pushKV("tx_pos", (int64_t)entry.tx_pos);
+        obj.pushKV("txid", entry.txid.GetHex());
+        obj.pushKV(entry.spending ? "vin" : "vout", (int64_t)entry.n);
+        obj.pushKV("amount", ValueFromAmount(entry.amount));
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
+UniValue getscriptunspent(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"getscriptunspent",
+        "\nReturns the confirmed unspent outputs paying to an address or output script, and their total amount.\n"
+        "To page through many outputs, pass the last one returned as \"after\" to get the ones that follow it.\n"
+        "Requires -scriptindex.\n",
+        {
+            {"script", RPCArg::Type::STR, RPCArg::Optional::NO, "The address, or the output script as hex"},
+            {"count", RPCArg::Type::NUM, /* default */ "1000", "The maximum number of outputs to return"},
+            {"after", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED_NAMED_ARG, "Only return the outputs after this one",
+                {
+                    {"txid", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The transaction id"},
+                    {"vout", RPCArg::Type::NUM, RPCArg::Optional::NO, "The output number"},
+                },
+            },
+        },
+        RPCResult{
+            RPCResult::Type::OBJ, "", "",
+            {
+                {RPCResult::Type::ARR, "unspents", "",
+                {
+                    {RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::STR_HEX, "txid", "The transaction id"},
+                        {RPCResult::Type::NUM, "vout", "The output number"},
+                        {RPCResult::Type::NUM, "height", "The height of the block the output was created in"},
+                        {RPCResult::Type::BOOL, "coinbase", "Whether the output was created by a coinbase"},
+                        {RPCResult::Type::STR_AMOUNT, "amount", "The amount in " + CURRENCY_UNIT},
+                    }},
+                }},
+                {RPCResult::Type::STR_AMOUNT, "total_amount", "The total amount of the unspent outputs returned"},
+            }},
+        RPCExamples{
+            HelpExampleCli("getscriptunspent", "\"mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn\"")
+            + HelpExampleCli("getscriptunspent", "\"mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn\" 100 '{\"txid\": \"mytxid\", \"vout\": 0}'")
+            + HelpExampleRpc("getscriptunspent", "\"mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn\"")
+        },
+    }.Check(request);
+
+    const CScript script = ParseScriptOrAddress(request.params[0]);
+    const int count = request.params[1].isNull() ? 1000 : request.params[1].get_int();
+    if (count < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+    }
+    COutPoint after;
+    if (!request.params[2].isNull()) {
+        const UniValue& after_obj = request.params[2].get_obj();
+        RPCTypeCheckObj(after_obj,
+            {
+                {"txid", UniValueType(UniValue::VSTR)},
+                {"vout", UniValueType(UniValue::VNUM)},
+            });
+        const int vout = find_value(after_obj, "vout").get_int();
+        if (vout < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, vout cannot be negative");
+        }
+        after = COutPoint(ParseHashO(after_obj, "txid"), vout);
+    }
+
+    std::vector<ScriptUnspent> unspents;
+    if (!EnsureScriptIndex().FindScriptUnspent(script, count, unspents, request.params[2].isNull() ? nullptr : &after)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the script index");
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    UniValue unspents_arr(UniValue::VARR);
+    CAmount total_amount = 0;
+    for (const ScriptUnspent& unspent : unspents) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("txid", unspent.outpoint.hash.GetHex());
+        obj.pushKV("vout", (int64_t)unspent.outpoint.n);
+        obj.pushKV("height", unspent.height);
+        obj.pushKV("coinbase", unspent.coinbase);
+        obj.pushKV("amount", ValueFromAmount(unspent.amount));
+        unspents_arr.push_back(obj);
+        total_amount += unspent.amount;
+    }
+    ret.pushKV("unspents", unspents_arr);
+    ret.pushKV("total_amount", ValueFromAmount(total_amount));
+    return ret;
+}
+
 /**
  * Serialize the UTXO set to a file for loading elsewhere.
  *
@@ -2302,6 +2602,15 @@ UniValue dumptxoutset(const JSONRPCRequest& request)
 
     FILE* file{fsbridge::fopen(temppath, "wb")};
     CAutoFile afile{file, SER_DISK, CLIENT_VERSION};
+    UniValue result = CreateUTXOSnapshot(::ChainstateActive(), afile, RpcInterruptionPoint);
+    fs::rename(temppath, path);
+
+    result.pushKV("path", path.string());
+    return result;
+}
+
+UniValue CreateUTXOSnapshot(CChainState& chainstate, CAutoFile& afile, const std::function<void()>& interruption_point)
+{
     std::unique_ptr<CCoinsViewCursor> pcursor;
     CCoinsStats stats;
     CBlockIndex* tip;
@@ -2321,13 +2630,13 @@ UniValue dumptxoutset(const JSONRPCRequest& request)
         //
         LOCK(::cs_main);
 
-        ::ChainstateActive().ForceFlushStateToDisk();
+        chainstate.ForceFlushStateToDisk();
 
-        if (!GetUTXOStats(&::ChainstateActive().CoinsDB(), stats, RpcInterruptionPoint)) {
+        if (!GetUTXOStats(&chainstate.CoinsDB(), stats, interruption_point)) {
             throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
         }
 
-        pcursor = std::unique_ptr<CCoinsViewCursor>(::ChainstateActive().CoinsDB().Cursor());
+        pcursor = std::unique_ptr<CCoinsViewCursor>(chainstate.CoinsDB().Cursor());
         tip = LookupBlockIndex(stats.hashBlock);
         CHECK_NONFATAL(tip);
     }
@@ -2341,7 +2650,7 @@ UniValue dumptxoutset(const JSONRPCRequest& request)
     unsigned int iter{0};
 
     while (pcursor->Valid()) {
-        if (iter % 5000 == 0) RpcInterruptionPoint();
+        if (iter % 5000 == 0) interruption_point();
         ++iter;
         if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
             afile << key;
@@ -2352,12 +2661,81 @@ UniValue dumptxoutset(const JSONRPCRequest& request)
     }
 
     afile.fclose();
-    fs::rename(temppath, path);
 
     UniValue result(UniValue::VOBJ);
     result.pushKV("coins_written", stats.coins_count);
     result.pushKV("base_hash", tip->GetBlockHash().ToString());
     result.pushKV("base_height", tip->nHeight);
+    return result;
+}
+
+UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    RPCHelpMan{
+        "loadtxoutset",
+        "\nLoad a serialized UTXO set written by dumptxoutset and make it the active chainstate.\n"
+        "The node then syncs from the base block of the snapshot. The UTXO set must match the one\n"
+        "known for the height of that block, and the header of the block must already be known.\n"
+        "Not available with pruning enabled.\n",
+        {
+            {"path",
+                RPCArg::Type::STR,
+                RPCArg::Optional::NO,
+                /* default_val */ "",
+                "path to the snapshot file. If relative, will be prefixed by datadir."},
+        },
+        RPCResult{
+            RPCResult::Type::OBJ, "", "",
+                {
+                    {RPCResult::Type::NUM, "coins_loaded", "the number of coins loaded from the snapshot"},
+                    {RPCResult::Type::STR_HEX, "base_hash", "the hash of the base of the snapshot"},
+                    {RPCResult::Type::NUM, "base_height", "the height of the base of the snapshot"},
+                    {RPCResult::Type::STR, "path", "the absolute path that the snapshot was loaded from"},
+                }
+        },
+        RPCExamples{
+            HelpExampleCli("loadtxoutset", "utxo.dat")
+        }
+    }.Check(request);
+
+    ChainstateManager& chainman = EnsureChainman(request.context);
+    if (fPruneMode) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Cannot load a UTXO snapshot with pruning enabled");
+    }
+    fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+
+    FILE* file{fsbridge::fopen(path, "rb")};
+    CAutoFile afile{file, SER_DISK, CLIENT_VERSION};
+    if (afile.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Couldn't open file " + path.string() + " for reading.");
+    }
+
+    SnapshotMetadata metadata;
+    try {
+        afile >> metadata;
+    } catch (const std::exception& e) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("Unable to parse snapshot metadata: %s", e.what()));
+    }
+
+    int base_height;
+    {
+        LOCK(::cs_main);
+        const CBlockIndex* base = LookupBlockIndex(metadata.m_base_blockhash);
+        if (!base) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("The base block header (%s) must appear in the headers chain. "
+                "Make sure all headers are syncing, and call this RPC again.", metadata.m_base_blockhash.ToString()));
+        }
+        base_height = base->nHeight;
+    }
+
+    if (!chainman.ActivateSnapshot(afile, metadata, /* in_memory */ false)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to load UTXO snapshot " + path.string() + ", see debug.log for details");
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("coins_loaded", metadata.m_coins_count);
+    result.pushKV("base_hash", metadata.m_base_blockhash.ToString());
+    result.pushKV("base_height", base_height);
     result.pushKV("path", path.string());
     return result;
 }
@@ -2384,7 +2762,8 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"hash_type", "hash_or_height", "use_index"} },
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           {"path"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
@@ -2392,6 +2771,8 @@ static const CRPCCommand commands[] =
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
     { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
     { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash", "filtertype"} },
+    { "blockchain",         "getscripthistory",       &getscripthistory,       {"script", "from_height", "count", "after"} },
+    { "blockchain",         "getscriptunspent",       &getscriptunspent,       {"script", "count", "after"} },
 
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        {"blockhash"} },
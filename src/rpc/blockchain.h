@@ -8,13 +8,16 @@
 #include <amount.h>
 #include <sync.h>
 
+#include <functional>
 #include <stdint.h>
 #include <vector>
 
 extern RecursiveMutex cs_main;
 
+class CAutoFile;
 class CBlock;
 class CBlockIndex;
+class CChainState;
 class CTxMemPool;
 class ChainstateManager;
 class UniValue;
@@ -55,4 +58,11 @@ NodeContext& EnsureNodeContext(const util::Ref& context);
 CTxMemPool& EnsureMemPool(const util::Ref& context);
 ChainstateManager& EnsureChainman(const util::Ref& context);
 
+/**
+ * Write the UTXO set of chainstate to afile, in the format loadtxoutset reads.
+ * @param[in] interruption_point  called periodically while the coins are written
+ * @returns an object with coins_written, base_hash and base_height
+ */
+UniValue CreateUTXOSnapshot(CChainState& chainstate, CAutoFile& afile, const std::function<void()>& interruption_point);
+
 #endif
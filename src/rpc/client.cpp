@@ -136,6 +136,13 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "verifychain", 1, "nblocks" },
     { "getblockstats", 0, "hash_or_height" },
     { "getblockstats", 1, "stats" },
+    { "gettxoutsetinfo", 1, "hash_or_height" },
+    { "gettxoutsetinfo", 2, "use_index" },
+    { "getscripthistory", 1, "from_height" },
+    { "getscripthistory", 2, "count" },
+    { "getscripthistory", 3, "after" },
+    { "getscriptunspent", 1, "count" },
+    { "getscriptunspent", 2, "after" },
     { "pruneblockchain", 0, "height" },
     { "keypoolrefill", 0, "newsize" },
     { "getrawmempool", 0, "verbose" },
@@ -3,6 +3,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <algo/hash_algos.h>
 #include <amount.h>
 #include <chain.h>
 #include <chainparams.h>
@@ -30,14 +31,18 @@
 #include <util/strencodings.h>
 #include <util/string.h>
 #include <util/system.h>
+#include <util/threadnames.h>
 #include <util/translation.h>
 #include <validation.h>
 #include <validationinterface.h>
 #include <versionbitsinfo.h>
 #include <warnings.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <stdint.h>
+#include <thread>
 
 /**
  * Return average network hashes per second based on the last 'lookup' blocks,
@@ -103,6 +108,56 @@ static UniValue getnetworkhashps(const JSONRPCRequest& request)
     return GetNetworkHashPS(!request.params[0].isNull() ? request.params[0].get_int() : 120, !request.params[1].isNull() ? request.params[1].get_int() : -1);
 }
 
+/** Nonce search state shared by the GenerateBlock worker threads. */
+struct NonceSearch
+{
+    Mutex cs;
+    //! Next nonce to hand out
+    uint32_t next_nonce GUARDED_BY(cs);
+    uint64_t max_tries GUARDED_BY(cs);
+    //! Set as soon as any worker finds a valid nonce; makes the others stop
+    std::atomic<bool> found{false};
+    //! Makes the workers stop without a result
+    std::atomic<bool> interrupted{false};
+    uint32_t found_nonce GUARDED_BY(cs){0};
+};
+
+static void SearchNonces(const X16RNonceHasher& hasher, uint32_t nBits, const Consensus::Params& params, NonceSearch& search)
+{
+    uint32_t nonces[X16RNonceHasher::LANES];
+    uint256 hashes[X16RNonceHasher::LANES];
+    // Batches start small so that easy targets (regtest) don't waste hashes.
+    size_t batch = 1;
+    while (!search.found && !search.interrupted && !ShutdownRequested()) {
+        size_t count;
+        {
+            LOCK(search.cs);
+            count = std::min<uint64_t>({batch, search.max_tries, std::numeric_limits<uint32_t>::max() - search.next_nonce});
+            if (count == 0) return;
+            for (size_t n = 0; n < count; ++n) {
+                nonces[n] = search.next_nonce + n;
+            }
+            search.next_nonce += count;
+            search.max_tries -= count;
+        }
+        batch = std::min(2 * batch, X16RNonceHasher::LANES);
+
+        hasher.Hash(nonces, count, hashes);
+        for (size_t n = 0; n < count; ++n) {
+            if (CheckProofOfWork(hashes[n], nBits, params)) {
+                LOCK(search.cs);
+                // The winning nonce itself does not count as a failed try.
+                search.max_tries += count - n;
+                if (!search.found || nonces[n] < search.found_nonce) {
+                    search.found_nonce = nonces[n];
+                }
+                search.found = true;
+                return;
+            }
+        }
+    }
+}
+
 static bool GenerateBlock(ChainstateManager& chainman, CBlock& block, uint64_t& max_tries, unsigned int& extra_nonce, uint256& block_hash)
 {
     block_hash.SetNull();
@@ -114,14 +169,52 @@ static bool GenerateBlock(ChainstateManager& chainman, CBlock& block, uint64_t&
 
     CChainParams chainparams(Params());
 
-    while (max_tries > 0 && block.nNonce < std::numeric_limits<uint32_t>::max() && !CheckProofOfWork(block.GetHash(), block.nBits, chainparams.GetConsensus()) && !ShutdownRequested()) {
-        ++block.nNonce;
-        --max_tries;
+    // Everything but the nonce is fixed now, so hash batches of nonces
+    // against a precomputed midstate of the rest of the header. The nonce
+    // range is handed out to the -genproclimit threads in batches.
+    const X16RNonceHasher hasher((const unsigned char*)BEGIN(block.nVersion), block.hashPrevBlock, block.IsX16RV2());
+    NonceSearch search;
+    {
+        LOCK(search.cs);
+        search.next_nonce = block.nNonce;
+        search.max_tries = max_tries;
+    }
+    const int cores = std::max(GetNumCores(), 1);
+    int64_t threads = gArgs.GetArg("-genproclimit", DEFAULT_GENERATE_THREADS);
+    if (threads < 0) threads = cores;
+    threads = std::min<int64_t>(threads, MAX_GENERATE_THREADS_PER_CORE * cores);
+    std::vector<std::thread> workers;
+    try {
+        for (int i = 1; i < threads; ++i) {
+            workers.emplace_back([&, i] {
+                util::ThreadRename(strprintf("generate.%i", i));
+                SearchNonces(hasher, block.nBits, chainparams.GetConsensus(), search);
+            });
+        }
+    } catch (...) {
+        // The workers reference locals of this frame, so stop and join the
+        // ones already running before unwinding.
+        search.interrupted = true;
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        throw;
     }
-    if (max_tries == 0 || ShutdownRequested()) {
+    SearchNonces(hasher, block.nBits, chainparams.GetConsensus(), search);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    {
+        LOCK(search.cs);
+        max_tries = search.max_tries;
+        block.nNonce = search.found ? search.found_nonce : search.next_nonce;
+    }
+    if (ShutdownRequested() || (!search.found && max_tries == 0)) {
         return false;
     }
-    if (block.nNonce == std::numeric_limits<uint32_t>::max()) {
+    if (!search.found) {
+        // Nonce space exhausted; the caller retries with a new extra nonce.
         return true;
     }
 
@@ -703,31 +796,24 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
     }
 
     // Update block
-    static CBlockIndex* pindexPrev;
-    static int64_t nStart;
-    static std::unique_ptr<CBlockTemplate> pblocktemplate;
-    if (pindexPrev != ::ChainActive().Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
-    {
-        // Clear pindexPrev so future calls make a new block, despite any failures from here on
-        pindexPrev = nullptr;
-
-        // Store the pindexBest used before CreateNewBlock, to avoid races
-        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-        CBlockIndex* pindexPrevNew = ::ChainActive().Tip();
-        nStart = GetTime();
-
-        // Create new block
+    // The builder keeps the template current with the mempool, and only
+    // assembles it from scratch when the tip changed.
+    nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+    std::shared_ptr<const CBlockTemplate> pblocktemplate;
+    if (node.block_template_builder) {
+        pblocktemplate = node.block_template_builder->GetTemplate();
+    } else {
         CScript scriptDummy = CScript() << OP_TRUE;
         pblocktemplate = BlockAssembler(mempool, Params()).CreateNewBlock(scriptDummy);
-        if (!pblocktemplate)
-            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
-
-        // Need to update only after we know CreateNewBlock succeeded
-        pindexPrev = pindexPrevNew;
     }
-    CHECK_NONFATAL(pindexPrev);
-    CBlock* pblock = &pblocktemplate->block; // pointer for convenience
+    if (!pblocktemplate)
+        throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
+    const CBlockIndex* pindexPrev = ::ChainActive().Tip();
+    CHECK_NONFATAL(pblocktemplate->block.hashPrevBlock == pindexPrev->GetBlockHash());
+    // The template is shared, so the header fields set below go into a copy.
+    CBlockHeader header = pblocktemplate->block.GetBlockHeader();
+    CBlockHeader* pblock = &header; // pointer for convenience
+    const std::vector<CTransactionRef>& vtx = pblocktemplate->block.vtx;
     const Consensus::Params& consensusParams = Params().GetConsensus();
 
     // Update nTime
@@ -742,7 +828,7 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
     UniValue transactions(UniValue::VARR);
     std::map<uint256, int64_t> setTxIndex;
     int i = 0;
-    for (const auto& it : pblock->vtx) {
+    for (const auto& it : vtx) {
         const CTransaction& tx = *it;
         uint256 txHash = tx.GetHash();
         setTxIndex[txHash] = i++;
@@ -849,7 +935,7 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
     result.pushKV("previousblockhash", pblock->hashPrevBlock.GetHex());
     result.pushKV("transactions", transactions);
     result.pushKV("coinbaseaux", aux);
-    result.pushKV("coinbasevalue", (int64_t)pblock->vtx[0]->vout[0].nValue);
+    result.pushKV("coinbasevalue", (int64_t)vtx[0]->vout[0].nValue);
     result.pushKV("longpollid", ::ChainActive().Tip()->GetBlockHash().GetHex() + ToString(nTransactionsUpdatedLast));
     result.pushKV("target", hashTarget.GetHex());
     result.pushKV("mintime", (int64_t)pindexPrev->GetMedianTimePast()+1);
@@ -3,6 +3,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <dbwrapper.h>
 #include <httpserver.h>
 #include <interfaces/chain.h>
 #include <key_io.h>
@@ -19,6 +20,7 @@
 #include <util/strencodings.h>
 #include <util/system.h>
 
+#include <sstream>
 #include <stdint.h>
 #include <tuple>
 #ifdef HAVE_MALLOC_INFO
@@ -492,6 +494,121 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+/** The rows of the LevelDB "leveldb.stats" table, one per level that has files or compactions. */
+static UniValue LevelStatsToJSON(const std::string& stats)
+{
+    UniValue levels(UniValue::VARR);
+    std::istringstream lines(stats);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::istringstream fields(line);
+        int level, files;
+        double size_mb, time_sec, read_mb, write_mb;
+        // The header lines do not start with a number.
+        if (!(fields >> level >> files >> size_mb >> time_sec >> read_mb >> write_mb)) continue;
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("level", level);
+        obj.pushKV("files", files);
+        obj.pushKV("size_mb", size_mb);
+        obj.pushKV("compaction_time", time_sec);
+        obj.pushKV("compaction_read_mb", read_mb);
+        obj.pushKV("compaction_write_mb", write_mb);
+        levels.push_back(obj);
+    }
+    return levels;
+}
+
+static UniValue getdatabaseinfo(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getdatabaseinfo",
+                "Returns the settings and LevelDB statistics of the open databases.\n",
+                {
+                    {"name", RPCArg::Type::STR, /* default */ "all databases", "Only return the databases with this name, e.g. \"chainstate\", \"blockindex\" or \"txindex\"."},
+                },
+                RPCResult{
+                    RPCResult::Type::ARR, "", "",
+                    {
+                        {RPCResult::Type::OBJ, "", "",
+                        {
+                            {RPCResult::Type::STR, "name", "The name -dboption settings refer to the database by"},
+                            {RPCResult::Type::STR, "path", "The location of the database"},
+                            {RPCResult::Type::OBJ, "settings", "The LevelDB settings in use",
+                            {
+                                {RPCResult::Type::NUM, "block_cache", "Size of the block cache in bytes"},
+                                {RPCResult::Type::NUM, "write_buffer", "Size of the write buffer in bytes"},
+                                {RPCResult::Type::NUM, "bloom_bits", "Bits per key of the bloom filters, 0 if none are built"},
+                                {RPCResult::Type::NUM, "max_file_size", "Size at which a new table file is started, in bytes"},
+                                {RPCResult::Type::NUM, "max_open_files", "Number of table files that may be kept open"},
+                            }},
+                            {RPCResult::Type::NUM, "memory_usage", "Approximate memory used by the database, in bytes"},
+                            {RPCResult::Type::ARR, "levels", "The levels that hold files or had compactions",
+                            {
+                                {RPCResult::Type::OBJ, "", "",
+                                {
+                                    {RPCResult::Type::NUM, "level", "The level"},
+                                    {RPCResult::Type::NUM, "files", "Number of table files"},
+                                    {RPCResult::Type::NUM, "size_mb", "Size of the table files in MiB, rounded"},
+                                    {RPCResult::Type::NUM, "compaction_time", "Time spent compacting into the level, in seconds"},
+                                    {RPCResult::Type::NUM, "compaction_read_mb", "MiB read by those compactions"},
+                                    {RPCResult::Type::NUM, "compaction_write_mb", "MiB written by those compactions"},
+                                }},
+                            }},
+                        }},
+                    }
+                },
+                RPCExamples{
+                    HelpExampleCli("getdatabaseinfo", "")
+            + HelpExampleCli("getdatabaseinfo", "\"chainstate\"")
+            + HelpExampleRpc("getdatabaseinfo", "\"chainstate\"")
+                },
+            }.Check(request);
+
+    const std::string name = request.params[0].isNull() ? "" : request.params[0].get_str();
+    UniValue ret(UniValue::VARR);
+    ForEachDBWrapper([&](CDBWrapper& dbw) {
+        if (!name.empty() && dbw.GetName() != name) return;
+        const DBTuning& tuning = dbw.GetTuning();
+        UniValue settings(UniValue::VOBJ);
+        settings.pushKV("block_cache", (uint64_t)tuning.block_cache_size);
+        settings.pushKV("write_buffer", (uint64_t)tuning.write_buffer_size);
+        settings.pushKV("bloom_bits", tuning.bloom_bits);
+        settings.pushKV("max_file_size", (uint64_t)tuning.max_file_size);
+        settings.pushKV("max_open_files", tuning.max_open_files);
+
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("name", dbw.GetName());
+        obj.pushKV("path", dbw.GetPath().string());
+        obj.pushKV("settings", settings);
+        obj.pushKV("memory_usage", (uint64_t)dbw.DynamicMemoryUsage());
+        std::string stats;
+        obj.pushKV("levels", dbw.GetProperty("leveldb.stats", stats) ? LevelStatsToJSON(stats) : UniValue(UniValue::VARR));
+        ret.push_back(obj);
+    });
+    return ret;
+}
+
+static UniValue compactdatabase(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"compactdatabase",
+                "Compacts the databases with the given name, as -forcecompactdb does at startup.\n"
+                "This may take a long time on large databases, during which they cannot be closed.\n",
+                {
+                    {"name", RPCArg::Type::STR, RPCArg::Optional::NO, "The name of the databases, as returned by getdatabaseinfo"},
+                },
+                RPCResult{RPCResult::Type::NONE, "", ""},
+                RPCExamples{
+                    HelpExampleCli("compactdatabase", "\"chainstate\"")
+            + HelpExampleRpc("compactdatabase", "\"chainstate\"")
+                },
+            }.Check(request);
+
+    const std::string& name = request.params[0].get_str();
+    if (!ForEachDBWrapperNamed(name, [](CDBWrapper& dbw) { dbw.CompactFull(); })) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "No open database named " + name);
+    }
+    return NullUniValue;
+}
+
 static void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     cats = cats.get_array();
     for (unsigned int i = 0; i < cats.size(); ++i) {
@@ -604,6 +721,8 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    { "control",            "getdatabaseinfo",        &getdatabaseinfo,        {"name"} },
+    { "control",            "compactdatabase",        &compactdatabase,        {"name"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
     { "util",               "validateaddress",        &validateaddress,        {"address"} },
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys","address_type"} },
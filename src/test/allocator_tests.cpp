@@ -2,12 +2,14 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <support/allocators/pool.h>
 #include <util/memory.h>
 #include <util/system.h>
 
 #include <test/util/setup_common.h>
 
 #include <memory>
+#include <unordered_map>
 
 #include <boost/test/unit_test.hpp>
 
@@ -233,4 +235,58 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // Freed blocks are reused by allocations of the same rounded size.
+    void* a = resource.Allocate(20, 8);
+    void* b = resource.Allocate(24, 8);
+    BOOST_CHECK(a != b);
+    resource.Deallocate(a, 20, 8);
+    BOOST_CHECK(resource.Allocate(17, 8) == a);
+    resource.Deallocate(b, 24, 8);
+    BOOST_CHECK(resource.Allocate(24, 8) == b);
+
+    // Small blocks are carved out of chunks, new chunks are taken as needed.
+    std::vector<void*> blocks;
+    for (int i = 0; i < 100; ++i) {
+        void* p = resource.Allocate(64, 8);
+        memset(p, i, 64);
+        blocks.push_back(p);
+    }
+    BOOST_CHECK(resource.NumAllocatedChunks() > 1);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        BOOST_CHECK_EQUAL(*(unsigned char*)blocks[i], i);
+        resource.Deallocate(blocks[i], 64, 8);
+    }
+
+    // Large allocations bypass the pool.
+    const size_t chunks = resource.NumAllocatedChunks();
+    void* large = resource.Allocate(4096, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), chunks);
+    resource.Deallocate(large, 4096, 8);
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_map)
+{
+    typedef std::unordered_map<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                               PoolAllocator<std::pair<const uint64_t, uint64_t>, sizeof(std::pair<const uint64_t, uint64_t>) + sizeof(void*) * 4>>
+        Map;
+    Map::allocator_type::ResourceType resource;
+    Map map(0, std::hash<uint64_t>(), std::equal_to<uint64_t>(), &resource);
+    for (uint64_t i = 0; i < 10000; ++i) {
+        map[i] = i * i;
+    }
+    for (uint64_t i = 0; i < 10000; i += 2) {
+        map.erase(i);
+    }
+    BOOST_CHECK_EQUAL(map.size(), 5000U);
+    for (const auto& entry : map) {
+        BOOST_CHECK_EQUAL(entry.second, entry.first * entry.first);
+    }
+    BOOST_CHECK(map.get_allocator().resource() == &resource);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
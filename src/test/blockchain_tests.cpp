@@ -7,8 +7,11 @@
 #include <stdlib.h>
 
 #include <chain.h>
+#include <chainparams.h>
+#include <pow.h>
 #include <rpc/blockchain.h>
 #include <test/util/setup_common.h>
+#include <txdb.h>
 #include <util/string.h>
 
 /* Equality between doubles is imprecise. Comparison should be done
@@ -74,4 +77,90 @@ BOOST_AUTO_TEST_CASE(get_difficulty_for_very_high_target)
     TestDifficulty(0x12345678, 5913134931067755359633408.0);
 }
 
+BOOST_AUTO_TEST_CASE(block_index_hash_from_key)
+{
+    const auto chain_params = CreateChainParams(CBaseChainParams::REGTEST);
+    const Consensus::Params& consensus = chain_params->GetConsensus();
+
+    CBlockHeader header;
+    header.nVersion = 0x20000000;
+    header.hashMerkleRoot = InsecureRand256();
+    header.nTime = 1600000000;
+    header.nBits = 0x207fffff;
+    while (!CheckProofOfWork(header.GetHash(), header.nBits, consensus)) ++header.nNonce;
+    const uint256 hash = header.GetHash();
+
+    CBlockIndex index(header);
+    index.phashBlock = &hash;
+    index.nHeight = 0;
+    index.nStatus = BLOCK_VALID_TREE;
+
+    std::map<uint256, std::unique_ptr<CBlockIndex>> loaded;
+    const auto insert = [&](const uint256& h) -> CBlockIndex* {
+        if (h.IsNull()) return nullptr;
+        auto& entry = *loaded.emplace(h, nullptr).first;
+        if (!entry.second) {
+            entry.second = MakeUnique<CBlockIndex>();
+            entry.second->phashBlock = &entry.first;
+        }
+        return entry.second.get();
+    };
+
+    CBlockTreeDB db(1 << 20, true);
+    BOOST_CHECK(db.WriteBatchSync({}, 0, {&index}));
+    BOOST_CHECK(db.LoadBlockIndexGuts(consensus, insert));
+    BOOST_CHECK_EQUAL(loaded.size(), 1U);
+    BOOST_CHECK(loaded.count(hash));
+    BOOST_CHECK(loaded.at(hash)->nNonce == header.nNonce);
+
+    // A record under a key that does not match its header is only caught when
+    // the header is re-hashed; a trusted load takes the key as the hash.
+    const uint256 bad_key = uint256S("01");
+    BOOST_CHECK(db.Write(std::make_pair('b', bad_key), CDiskBlockIndex(&index)));
+    loaded.clear();
+    BOOST_CHECK(!db.LoadBlockIndexGuts(consensus, insert));
+    loaded.clear();
+    BOOST_CHECK(db.LoadBlockIndexGuts(consensus, insert, /* fTrustStoredHash */ true));
+    BOOST_CHECK_EQUAL(loaded.size(), 2U);
+    BOOST_CHECK(loaded.count(bad_key));
+}
+
+BOOST_AUTO_TEST_CASE(block_hash_cache)
+{
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.hashPrevBlock = InsecureRand256();
+    header.hashMerkleRoot = InsecureRand256();
+    header.nTime = 1600000000;
+    header.nBits = 0x207fffff;
+    header.nNonce = 1;
+    const uint256 hash = header.GetHash();
+
+    CBlock block(header);
+    BOOST_CHECK(block.GetHash() == hash);
+    BOOST_CHECK(block.GetHash() == block.ComputeHash());
+    BOOST_CHECK(block.GetBlockHeader().GetHash() == hash);
+
+    // Copies keep the cache, and it follows every header field.
+    CBlock copy(block);
+    BOOST_CHECK(copy.GetHash() == hash);
+    block.nNonce++;
+    BOOST_CHECK(block.GetHash() != hash);
+    BOOST_CHECK(block.GetHash() == block.ComputeHash());
+    block.nNonce--;
+    block.hashMerkleRoot = InsecureRand256();
+    BOOST_CHECK(block.GetHash() == block.ComputeHash());
+    block.hashMerkleRoot = header.hashMerkleRoot;
+    BOOST_CHECK(block.GetHash() == hash);
+
+    // A seeded hash is only used for the fields it was seeded with.
+    const uint256 seeded = InsecureRand256();
+    block.SetCachedHash(seeded);
+    BOOST_CHECK(block.GetHash() == seeded);
+    copy = block;
+    BOOST_CHECK(copy.GetHash() == seeded);
+    block.nTime++;
+    BOOST_CHECK(block.GetHash() == block.ComputeHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -54,7 +54,7 @@ public:
 
     uint256 GetBestBlock() const override { return hashBestBlock_; }
 
-    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase = true) override
     {
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
@@ -65,7 +65,11 @@ public:
                     map_.erase(it->first);
                 }
             }
-            mapCoins.erase(it++);
+            if (erase) {
+                mapCoins.erase(it++);
+            } else {
+                ++it;
+            }
         }
         if (!hashBlock.IsNull())
             hashBestBlock_ = hashBlock;
@@ -609,7 +613,8 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
     InsertCoinsMapEntry(map, value, flags);
     BOOST_CHECK(view.BatchWrite(map, {}));
 }
@@ -793,6 +798,35 @@ BOOST_AUTO_TEST_CASE(ccoins_add)
     CheckAddCoin(VALUE2, VALUE3, VALUE3, DIRTY|FRESH, DIRTY|FRESH, true );
 }
 
+static void CheckEmplaceFetchedCoin(CAmount cache_value, CAmount expected_value, char cache_flags, char expected_flags)
+{
+    SingleEntryCacheTest test(ABSENT, cache_value, cache_flags);
+    Coin coin;
+    SetCoinsValue(VALUE3, coin);
+    test.cache.EmplaceFetchedCoin(OUTPOINT, std::move(coin));
+    test.cache.SelfTest();
+
+    CAmount result_value;
+    char result_flags;
+    GetCoinsMapEntry(test.cache.map(), result_value, result_flags);
+    BOOST_CHECK_EQUAL(result_value, expected_value);
+    BOOST_CHECK_EQUAL(result_flags, expected_flags);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_emplace_fetched)
+{
+    /* Check EmplaceFetchedCoin behavior, caching a coin that was read from the
+     * base view ahead of time. Entries already in the cache are never changed.
+     *
+     *                      Cache   Result  Cache        Result
+     *                      Value   Value   Flags        Flags
+     */
+    CheckEmplaceFetchedCoin(ABSENT, VALUE3, NO_ENTRY   , 0          );
+    for (const CAmount cache_value : {SPENT, VALUE2})
+        for (const char cache_flags : FLAGS)
+            CheckEmplaceFetchedCoin(cache_value, cache_value, cache_flags, cache_flags);
+}
+
 void CheckWriteCoins(CAmount parent_value, CAmount child_value, CAmount expected_value, char parent_flags, char child_flags, char expected_flags)
 {
     SingleEntryCacheTest test(ABSENT, parent_value, parent_flags);
@@ -878,4 +912,86 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_sync)
+{
+    CCoinsView root;
+    CCoinsViewCacheTest base{&root};
+    CCoinsViewCacheTest cache{&base};
+
+    Coin coin;
+    SetCoinsValue(VALUE1, coin);
+    const COutPoint kept(InsecureRand256(), 0);
+    const COutPoint spent(InsecureRand256(), 0);
+    cache.AddCoin(kept, Coin(coin), false);
+    cache.AddCoin(spent, Coin(coin), false);
+    WriteCoinsViewEntry(base, VALUE1, DIRTY);
+    BOOST_CHECK(cache.SpendCoin(OUTPOINT));
+    BOOST_CHECK(cache.Sync());
+    BOOST_CHECK(cache.SpendCoin(spent));
+    cache.SetBestBlock(InsecureRand256());
+    BOOST_CHECK(cache.Sync());
+    cache.SelfTest();
+
+    // The unspent coin was written and stays cached as a clean entry; the
+    // spent coins are written and dropped.
+    BOOST_CHECK(base.HaveCoinInCache(kept));
+    BOOST_CHECK_EQUAL(cache.map().size(), 1U);
+    BOOST_CHECK(cache.map().count(kept));
+    BOOST_CHECK_EQUAL(cache.map().at(kept).flags, 0);
+    BOOST_CHECK(!base.HaveCoin(spent));
+    BOOST_CHECK(!base.HaveCoin(OUTPOINT));
+    BOOST_CHECK(cache.GetBestBlock() == base.GetBestBlock());
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_evict_to_size)
+{
+    CCoinsView root;
+    CCoinsViewCacheTest base{&root};
+    CCoinsViewCacheTest cache{&base};
+
+    std::vector<COutPoint> outpoints;
+    for (int height = 1; height <= 20000; ++height) {
+        Coin coin;
+        SetCoinsValue(VALUE1, coin);
+        coin.nHeight = height;
+        outpoints.emplace_back(InsecureRand256(), 0);
+        cache.AddCoin(outpoints.back(), std::move(coin), false);
+    }
+    cache.SetBestBlock(InsecureRand256());
+    BOOST_CHECK(cache.Sync());
+
+    // A modified coin is kept whatever its age.
+    Coin old_coin;
+    SetCoinsValue(VALUE2, old_coin);
+    const COutPoint modified(InsecureRand256(), 0);
+    cache.AddCoin(modified, std::move(old_coin), false);
+
+    const size_t usage = cache.DynamicMemoryUsage();
+    cache.EvictToSize(usage);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), outpoints.size() + 1);
+
+    const size_t target = usage / 2;
+    cache.EvictToSize(target);
+    cache.SelfTest();
+    BOOST_CHECK(cache.DynamicMemoryUsage() <= target);
+    BOOST_CHECK(cache.GetCacheSize() > 1 && cache.GetCacheSize() < outpoints.size());
+    BOOST_CHECK(cache.HaveCoinInCache(modified));
+    BOOST_CHECK(cache.HaveCoinInCache(outpoints.back()));
+    BOOST_CHECK(!cache.HaveCoinInCache(outpoints.front()));
+
+    // Adding as many coins as were evicted takes no more than before.
+    const size_t evicted = outpoints.size() + 1 - cache.GetCacheSize();
+    for (size_t i = 0; i < evicted; ++i) {
+        Coin coin;
+        SetCoinsValue(VALUE1, coin);
+        cache.AddCoin(COutPoint(InsecureRand256(), 0), std::move(coin), false);
+    }
+    BOOST_CHECK(cache.DynamicMemoryUsage() <= usage);
+
+    // Evicted coins are still found in the base.
+    for (const COutPoint& outpoint : outpoints) {
+        BOOST_CHECK(cache.HaveCoin(outpoint));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
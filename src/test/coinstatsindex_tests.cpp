@@ -0,0 +1,117 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/coinstatsindex.h>
+#include <script/interpreter.h>
+#include <script/standard.h>
+#include <test/util/setup_common.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(coinstatsindex_tests)
+
+static void CheckAgainstRollingStats(const CoinStatsIndex& coin_stats_index)
+{
+    CCoinsStats rolling_stats;
+    BOOST_REQUIRE(::ChainstateActive().GetRollingCoinsStats(rolling_stats, [] {}));
+    const CBlockIndex* tip = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    CCoinsStats index_stats;
+    BOOST_REQUIRE(coin_stats_index.LookUpStats(tip, index_stats));
+    BOOST_CHECK(index_stats.index_used);
+    BOOST_CHECK(index_stats.hashBlock == rolling_stats.hashBlock);
+    BOOST_CHECK(index_stats.hashSerialized == rolling_stats.hashSerialized);
+    BOOST_CHECK_EQUAL(index_stats.nTransactionOutputs, rolling_stats.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(index_stats.nBogoSize, rolling_stats.nBogoSize);
+    BOOST_CHECK_EQUAL(index_stats.nTotalAmount, rolling_stats.nTotalAmount);
+}
+
+BOOST_FIXTURE_TEST_CASE(coinstatsindex_initial_sync, TestChain100Setup)
+{
+    CoinStatsIndex coin_stats_index{1 << 20, true};
+
+    CCoinsStats coin_stats;
+    const CBlockIndex* block_index = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+
+    // Stats should not be found in the index before it is started.
+    BOOST_CHECK(!coin_stats_index.LookUpStats(block_index, coin_stats));
+
+    // BlockUntilSyncedToCurrentChain should return false before index is started.
+    BOOST_CHECK(!coin_stats_index.BlockUntilSyncedToCurrentChain());
+
+    coin_stats_index.Start();
+
+    // Allow the index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!coin_stats_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        UninterruptibleSleep(std::chrono::milliseconds{100});
+    }
+
+    // The genesis block outputs never enter the UTXO set.
+    const CBlockIndex* genesis_block_index = WITH_LOCK(cs_main, return ::ChainActive().Genesis());
+    BOOST_REQUIRE(coin_stats_index.LookUpStats(genesis_block_index, coin_stats));
+    BOOST_CHECK_EQUAL(coin_stats.nTransactionOutputs, 0U);
+    BOOST_CHECK_EQUAL(coin_stats.total_unspendables_genesis_block, GetBlockSubsidy(0, Params().GetConsensus()));
+    BOOST_CHECK_EQUAL(coin_stats.total_unspendable_amount, coin_stats.total_unspendables_genesis_block);
+
+    CheckAgainstRollingStats(coin_stats_index);
+    CCoinsStats before;
+    BOOST_REQUIRE(coin_stats_index.LookUpStats(block_index, before));
+
+    // Spend a coinbase into a smaller output, so that the difference becomes
+    // a fee that the next coinbase does not claim.
+    const CScript script_pub_key = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = script_pub_key;
+    std::vector<unsigned char> vch_sig;
+    const uint256 hash = SignatureHash(script_pub_key, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vch_sig));
+    vch_sig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vch_sig;
+    const CBlock block = CreateAndProcessBlock({spend}, script_pub_key);
+
+    BOOST_CHECK(coin_stats_index.BlockUntilSyncedToCurrentChain());
+    CheckAgainstRollingStats(coin_stats_index);
+    const CBlockIndex* spend_block_index = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    CCoinsStats after;
+    BOOST_REQUIRE(coin_stats_index.LookUpStats(spend_block_index, after));
+    const CAmount spent = m_coinbase_txns[0]->vout[0].nValue;
+    BOOST_CHECK_EQUAL(after.total_prevout_spent_amount - before.total_prevout_spent_amount, spent);
+    BOOST_CHECK_EQUAL(after.total_new_outputs_ex_coinbase_amount - before.total_new_outputs_ex_coinbase_amount, 11 * CENT);
+    BOOST_CHECK_EQUAL(after.total_coinbase_amount - before.total_coinbase_amount, block.vtx[0]->GetValueOut());
+    BOOST_CHECK_EQUAL(after.total_unspendables_unclaimed_rewards - before.total_unspendables_unclaimed_rewards, spent - 11 * CENT);
+
+    // Replace the block on a fork. The index rewinds when the new block is
+    // connected, and keeps the statistics of the block it took out.
+    BlockValidationState state;
+    BOOST_REQUIRE(::ChainstateActive().InvalidateBlock(state, Params(), WITH_LOCK(cs_main, return ::ChainActive().Tip())));
+    // The block template would claim the fee of the transaction returned to
+    // the mempool, which the block does not include.
+    m_node.mempool->clear();
+    CreateAndProcessBlock({}, script_pub_key);
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return ::ChainActive().Height()), 101);
+    BOOST_CHECK(coin_stats_index.BlockUntilSyncedToCurrentChain());
+    CheckAgainstRollingStats(coin_stats_index);
+    CCoinsStats stale;
+    BOOST_REQUIRE(coin_stats_index.LookUpStats(spend_block_index, stale));
+    BOOST_CHECK(stale.hashSerialized == after.hashSerialized);
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    coin_stats_index.Stop();
+
+    // Let scheduler events finish running to avoid accessing any memory related to the index after it is destructed
+    SyncWithValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
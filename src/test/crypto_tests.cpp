@@ -8,12 +8,14 @@
 #include <crypto/hkdf_sha256_32.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <crypto/muhash.h>
 #include <crypto/poly1305.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
 #include <random.h>
+#include <streams.h>
 #include <test/util/setup_common.h>
 #include <util/strencodings.h>
 
@@ -750,4 +752,93 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+static MuHash3072 FromInt(unsigned char i) {
+    unsigned char tmp[32] = {i, 0};
+    return MuHash3072(tmp);
+}
+
+static uint256 FinalizeMuHash(const MuHash3072& muhash) {
+    uint256 out;
+    muhash.Finalize(out);
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    // Known answers, also checked against an independent implementation.
+    BOOST_CHECK_EQUAL(FinalizeMuHash(MuHash3072()).GetHex(), "dd5ad2a105c2d29495f577245c357409002329b9f4d6182c0af3dc2f462555c8");
+    BOOST_CHECK_EQUAL(FinalizeMuHash(FromInt(0)).GetHex(), "46b5948447d63bed8d4338aefb3a6d294f9550d830c7297d4b47858133e49a4d");
+    MuHash3072 kat = FromInt(1);
+    kat *= FromInt(2);
+    kat /= FromInt(3);
+    BOOST_CHECK_EQUAL(FinalizeMuHash(kat).GetHex(), "ee2ad15c3e291eabe4bf42b96928afa925ecde0cb6ace86f305ddfa53d27f68e");
+
+    // Inserting and removing in any order gives the same set hash.
+    for (int iter = 0; iter < 10; ++iter) {
+        uint256 res;
+        int table[4];
+        for (int i = 0; i < 4; ++i) {
+            table[i] = InsecureRandBits(3);
+        }
+        for (int order = 0; order < 4; ++order) {
+            MuHash3072 acc;
+            for (int i = 0; i < 4; ++i) {
+                int t = table[i ^ order];
+                if (t & 4) {
+                    acc /= FromInt(t & 3);
+                } else {
+                    acc *= FromInt(t & 3);
+                }
+            }
+            uint256 out = FinalizeMuHash(acc);
+            if (order == 0) {
+                res = out;
+            } else {
+                BOOST_CHECK(res == out);
+            }
+        }
+
+        MuHash3072 x = FromInt(InsecureRandBits(4));
+        MuHash3072 y = FromInt(InsecureRandBits(4));
+        uint256 out = FinalizeMuHash(x);
+        x *= y;
+        x /= y;
+        BOOST_CHECK(FinalizeMuHash(x) == out);
+    }
+
+    unsigned char data[32] = {42, 0};
+    MuHash3072 inserted;
+    inserted.Insert(data);
+    inserted.Remove(data);
+    BOOST_CHECK(FinalizeMuHash(inserted) == FinalizeMuHash(MuHash3072()));
+    BOOST_CHECK(FinalizeMuHash(MuHash3072().Insert(data)) == FinalizeMuHash(MuHash3072(data)));
+
+    // A serialization round trip keeps the numerator and denominator.
+    MuHash3072 serchk = FromInt(1);
+    serchk /= FromInt(2);
+    CDataStream ss(SER_DISK, 0);
+    ss << serchk;
+    MuHash3072 deserialized;
+    ss >> deserialized;
+    BOOST_CHECK(FinalizeMuHash(deserialized) == FinalizeMuHash(serchk));
+
+    // Representations at or above the modulus 2^3072 - 1103717 are reduced.
+    unsigned char bytes[Num3072::BYTE_SIZE];
+    memset(bytes, 0xff, sizeof(bytes));
+    WriteLE32(bytes, 0xffffffff - 1103717 + 1 + 5); // p + 5
+    Num3072 overflowed(bytes);
+    overflowed.Multiply(Num3072());
+    unsigned char reduced[Num3072::BYTE_SIZE];
+    overflowed.ToBytes(reduced);
+    unsigned char five[Num3072::BYTE_SIZE] = {5, 0};
+    BOOST_CHECK(memcmp(reduced, five, sizeof(reduced)) == 0);
+
+    WriteLE32(bytes, 0xffffffff - 1103717); // p - 1, whose square is 1
+    Num3072 minus_one(bytes);
+    minus_one.Square();
+    minus_one.ToBytes(reduced);
+    unsigned char one[Num3072::BYTE_SIZE] = {1, 0};
+    BOOST_CHECK(memcmp(reduced, one, sizeof(reduced)) == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -412,5 +412,62 @@ BOOST_AUTO_TEST_CASE(unicodepath)
     BOOST_CHECK(fs::exists(lockPath));
 }
 
+struct DBOptionTestingSetup : public BasicTestingSetup {
+    DBOptionTestingSetup()
+        : BasicTestingSetup{CBaseChainParams::MAIN, {"-dboption=testdb:bloom_bits=0", "-dboption=testdb:cache=4",
+                                                     "-dboption=testdb:write_buffer=2", "-dboption=otherdb:bloom_bits=20"}} {}
+};
+
+BOOST_FIXTURE_TEST_CASE(dboption, DBOptionTestingSetup)
+{
+    std::string error;
+    const std::set<std::string> names{"testdb", "otherdb"};
+    BOOST_CHECK(CheckDBOptions(names, error));
+    {
+        fs::path ph = GetDataDir() / "dbwrapper_dboption";
+        CDBWrapper dbw(ph, (1 << 20), false, true, false, "testdb");
+        BOOST_CHECK_EQUAL(dbw.GetName(), "testdb");
+        const DBTuning& tuning = dbw.GetTuning();
+        BOOST_CHECK_EQUAL(tuning.bloom_bits, 0);
+        // The block cache follows the cache setting, the write buffer is set explicitly.
+        BOOST_CHECK_EQUAL(tuning.block_cache_size, size_t{2 << 20});
+        BOOST_CHECK_EQUAL(tuning.write_buffer_size, size_t{2 << 20});
+
+        // Databases without a name are named after their directory.
+        CDBWrapper unnamed(GetDataDir() / "dbwrapper_dboption_unnamed", (1 << 20), true);
+        BOOST_CHECK_EQUAL(unnamed.GetName(), "dbwrapper_dboption_unnamed");
+        BOOST_CHECK_EQUAL(unnamed.GetTuning().bloom_bits, 10);
+
+        for (int i = 0; i < 1000; ++i) {
+            BOOST_CHECK(dbw.Write(i, InsecureRand256()));
+        }
+        dbw.CompactFull();
+        std::string stats;
+        BOOST_CHECK(dbw.GetProperty("leveldb.stats", stats));
+        BOOST_CHECK(stats.find("Compactions") != std::string::npos);
+        BOOST_CHECK(!dbw.GetProperty("leveldb.unknown", stats));
+
+        size_t found = 0;
+        ForEachDBWrapper([&](CDBWrapper& db) {
+            if (&db == &dbw || &db == &unnamed) ++found;
+        });
+        BOOST_CHECK_EQUAL(found, 2U);
+
+        // Other databases can be opened and closed while one is in use by name.
+        found = 0;
+        BOOST_CHECK(ForEachDBWrapperNamed("testdb", [&](CDBWrapper& db) {
+            BOOST_CHECK(&db == &dbw);
+            ++found;
+            CDBWrapper other(GetDataDir() / "dbwrapper_dboption_other", (1 << 20), true);
+        }));
+        BOOST_CHECK_EQUAL(found, 1U);
+        BOOST_CHECK(!ForEachDBWrapperNamed("nosuchdb", [](CDBWrapper&) {}));
+    }
+
+    for (const std::string& bad : {"testdb", "testdb:bloom_bits", "testdb:unknown=1", "testdb:bloom_bits=-1", "testdb:compression=1", ":cache=1", "nosuchdb:cache=1"}) {
+        gArgs.ForceSetArg("-dboption", bad);
+        BOOST_CHECK(!CheckDBOptions(names, error));
+    }
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -119,7 +119,8 @@ void test_one_input(const std::vector<uint8_t>& buffer)
             break;
         }
         case 9: {
-            CCoinsMap coins_map;
+            CCoinsMapMemoryResource resource;
+            CCoinsMap coins_map(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
             while (fuzzed_data_provider.ConsumeBool()) {
                 CCoinsCacheEntry coins_cache_entry;
                 coins_cache_entry.flags = fuzzed_data_provider.ConsumeIntegral<unsigned char>();
@@ -0,0 +1,147 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <algo/hash_algos.h>
+#include <chainparams.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(hash_algos_tests, BasicTestingSetup)
+
+namespace {
+/** Temporarily fall back to the portable compression functions. */
+class PortableScope
+{
+    void (*m_echo)(sph_echo_big_context*);
+    void (*m_shavite)(sph_shavite_big_context*, const void*);
+
+public:
+    PortableScope() : m_echo(sph_echo_big_compress_accel), m_shavite(sph_shavite_big_compress_accel)
+    {
+        sph_echo_big_compress_accel = nullptr;
+        sph_shavite_big_compress_accel = nullptr;
+    }
+    ~PortableScope()
+    {
+        sph_echo_big_compress_accel = m_echo;
+        sph_shavite_big_compress_accel = m_shavite;
+    }
+};
+
+uint512 Echo512(const std::vector<unsigned char>& data)
+{
+    uint512 out;
+    sph_echo512_context ctx;
+    sph_echo512_init(&ctx);
+    sph_echo512(&ctx, data.data(), data.size());
+    sph_echo512_close(&ctx, out.begin());
+    return out;
+}
+
+uint512 Shavite512(const std::vector<unsigned char>& data)
+{
+    uint512 out;
+    sph_shavite512_context ctx;
+    sph_shavite512_init(&ctx);
+    sph_shavite512(&ctx, data.data(), data.size());
+    sph_shavite512_close(&ctx, out.begin());
+    return out;
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(genesis_block_hashes)
+{
+    for (const std::string& chain : {CBaseChainParams::MAIN, CBaseChainParams::TESTNET, CBaseChainParams::REGTEST}) {
+        const auto params = CreateChainParams(chain);
+        BOOST_CHECK_EQUAL(params->GenesisBlock().GetHash(), params->GetConsensus().hashGenesisBlock);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(x16r_known_answers)
+{
+    std::vector<unsigned char> header(80);
+    for (size_t i = 0; i < header.size(); ++i) {
+        header[i] = i;
+    }
+    struct {
+        const char* prev;
+        const char* x16r;
+        const char* x16rv2;
+    } vectors[] = {
+        {"0000000000000000000000000000000000000000000000000123456789abcdef",
+         "ae8b57cee4e094302eb8e84ace08309f646c5bb002da5c29bae14d4145eaff48",
+         "08288f77ef8bfb7fe5c30590a54b046636eb4eaace201550d5ff0302927b841f"},
+        {"000000000000000000000000000000000000000000000000fedcba9876543210",
+         "5a5fd149d4f1122c1158551ec6b81bde6a79e82be062a4e3a2d1ee3126a9e911",
+         "62b96dd0ad2f1e0482e2037af29b93f0275fdd4bb39fabe6e25b716364d3bae8"},
+        // Tiger runs in front of Keccak, Luffa and SHA-512 in X16RV2
+        {"00000000000000000000000000000000000000000000000046f46f46f46f46f4",
+         "ad922c52d33a06c0ba1b2a1e3585f68bc2e49b3f1b66ad38852252e8a5f38dc7",
+         "10da345e2098c4c0c8b9a8d0b71d84b9ee94e75c39b4901ab365876e31582299"},
+    };
+    for (const auto& v : vectors) {
+        const uint256 prev = uint256S(v.prev);
+        BOOST_CHECK_EQUAL(HashX16R(header.begin(), header.end(), prev).ToString(), v.x16r);
+        BOOST_CHECK_EQUAL(HashX16RV2(header.begin(), header.end(), prev).ToString(), v.x16rv2);
+
+        // A reused hasher gives the same results.
+        X16RHasher hasher;
+        BOOST_CHECK_EQUAL(hasher.Hash(header.data(), header.size(), prev, false).ToString(), v.x16r);
+        BOOST_CHECK_EQUAL(hasher.Hash(header.data(), header.size(), prev, true).ToString(), v.x16rv2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(accelerated_primitives_match_portable)
+{
+    BOOST_TEST_MESSAGE("X16R implementation: " << X16RAutoDetect());
+
+    for (size_t len : {0, 1, 64, 80, 109, 110, 127, 128, 129, 255, 256, 300, 1000}) {
+        const std::vector<unsigned char> data = g_insecure_rand_ctx.randbytes(len);
+        const uint512 echo = Echo512(data);
+        const uint512 shavite = Shavite512(data);
+        PortableScope portable;
+        BOOST_CHECK(echo == Echo512(data));
+        BOOST_CHECK(shavite == Shavite512(data));
+    }
+
+    for (int i = 0; i < 50; ++i) {
+        const std::vector<unsigned char> header = g_insecure_rand_ctx.randbytes(80);
+        const uint256 prev = InsecureRand256();
+        const uint256 x16r = HashX16R(header.begin(), header.end(), prev);
+        const uint256 x16rv2 = HashX16RV2(header.begin(), header.end(), prev);
+        PortableScope portable;
+        BOOST_CHECK(x16r == HashX16R(header.begin(), header.end(), prev));
+        BOOST_CHECK(x16rv2 == HashX16RV2(header.begin(), header.end(), prev));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(nonce_hasher_matches_x16r)
+{
+    for (bool v2 : {false, true}) {
+        // Cover every primitive in the first round, which runs from the midstate.
+        for (int first = 0; first < 16; ++first) {
+            std::vector<unsigned char> header = g_insecure_rand_ctx.randbytes(80);
+            uint256 prev = InsecureRand256();
+            prev.begin()[7] = (first << 4) | (prev.begin()[7] & 0x0f);
+            BOOST_CHECK_EQUAL(GetHashSelection(prev, 0), first);
+
+            const X16RNonceHasher hasher(header.data(), prev, v2);
+            std::vector<uint32_t> nonces(2 * X16RNonceHasher::LANES + 3);
+            for (uint32_t& nonce : nonces) {
+                nonce = InsecureRand32();
+            }
+            std::vector<uint256> hashes(nonces.size());
+            hasher.Hash(nonces.data(), nonces.size(), hashes.data());
+
+            for (size_t n = 0; n < nonces.size(); ++n) {
+                memcpy(header.data() + 76, &nonces[n], 4);
+                const uint256 expected = v2 ? HashX16RV2(header.begin(), header.end(), prev) : HashX16R(header.begin(), header.end(), prev);
+                BOOST_CHECK(hashes[n] == expected);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,49 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <headerhashcache.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(headerhashcache_tests, BasicTestingSetup)
+
+namespace {
+CBlockHeader RandomHeader()
+{
+    CBlockHeader header;
+    header.nVersion = 0x30000000;
+    header.hashPrevBlock = InsecureRand256();
+    header.hashMerkleRoot = InsecureRand256();
+    header.nTime = InsecureRand32();
+    header.nBits = 0x207fffff;
+    header.nNonce = InsecureRand32();
+    return header;
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(hits_and_misses)
+{
+    HeaderHashCache cache(4);
+    std::vector<CBlockHeader> headers;
+    for (int i = 0; i < 32; ++i) {
+        headers.push_back(RandomHeader());
+        BOOST_CHECK(cache.GetHash(headers.back()) == headers.back().GetHash());
+    }
+
+    // A hit on a copy of the header returns the stored hash.
+    const CBlockHeader& last = headers.back();
+    CBlockHeader copy = last;
+    BOOST_CHECK(cache.GetHash(copy) == last.GetHash());
+
+    // Changing any field misses, and every header still hashes correctly
+    // after evictions from the small cache.
+    copy.nNonce ^= 1;
+    BOOST_CHECK(cache.GetHash(copy) == copy.GetHash());
+    for (const CBlockHeader& header : headers) {
+        BOOST_CHECK(cache.GetHash(header) == header.GetHash());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
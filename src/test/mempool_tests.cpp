@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <core_memusage.h>
 #include <policy/policy.h>
 #include <txmempool.h>
 #include <util/system.h>
@@ -108,6 +109,92 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     BOOST_CHECK_EQUAL(testPool.size(), 0U);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolRemoveForBlockTest)
+{
+    // Test that removeForBlock keeps the ancestor state of the survivors
+    // consistent when block transactions and conflicts go in one batch.
+
+    TestMemPoolEntryHelper entry;
+    // Parent with two outputs; the first is spent by a child which is mined
+    // with the parent, the second by a transaction which stays in the pool.
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].scriptSig = CScript() << OP_11;
+    txParent.vout.resize(2);
+    for (int i = 0; i < 2; i++) {
+        txParent.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txParent.vout[i].nValue = 33000LL;
+    }
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].scriptSig = CScript() << OP_11;
+    txChild.vin[0].prevout = COutPoint(txParent.GetHash(), 0);
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = 11000LL;
+    CMutableTransaction txGrandChild;
+    txGrandChild.vin.resize(1);
+    txGrandChild.vin[0].scriptSig = CScript() << OP_11;
+    txGrandChild.vin[0].prevout = COutPoint(txChild.GetHash(), 0);
+    txGrandChild.vout.resize(1);
+    txGrandChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txGrandChild.vout[0].nValue = 11000LL;
+    CMutableTransaction txSibling;
+    txSibling.vin.resize(1);
+    txSibling.vin[0].scriptSig = CScript() << OP_11;
+    txSibling.vin[0].prevout = COutPoint(txParent.GetHash(), 1);
+    txSibling.vout.resize(1);
+    txSibling.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txSibling.vout[0].nValue = 11000LL;
+
+    // A pool transaction and its child, double spent by a block transaction.
+    CMutableTransaction txConflict;
+    txConflict.vin.resize(1);
+    txConflict.vin[0].scriptSig = CScript() << OP_12;
+    txConflict.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+    txConflict.vout.resize(1);
+    txConflict.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txConflict.vout[0].nValue = 11000LL;
+    CMutableTransaction txConflictChild;
+    txConflictChild.vin.resize(1);
+    txConflictChild.vin[0].scriptSig = CScript() << OP_11;
+    txConflictChild.vin[0].prevout = COutPoint(txConflict.GetHash(), 0);
+    txConflictChild.vout.resize(1);
+    txConflictChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txConflictChild.vout[0].nValue = 10000LL;
+    CMutableTransaction txDoubleSpend = txConflict;
+    txDoubleSpend.vin[0].scriptSig = CScript() << OP_13;
+
+    CTxMemPool testPool;
+    LOCK2(cs_main, testPool.cs);
+
+    testPool.addUnchecked(entry.Fee(1000LL).FromTx(txParent));
+    testPool.addUnchecked(entry.Fee(2000LL).FromTx(txChild));
+    testPool.addUnchecked(entry.Fee(3000LL).FromTx(txGrandChild));
+    testPool.addUnchecked(entry.Fee(4000LL).FromTx(txSibling));
+    testPool.addUnchecked(entry.Fee(5000LL).FromTx(txConflict));
+    testPool.addUnchecked(entry.Fee(6000LL).FromTx(txConflictChild));
+    BOOST_CHECK_EQUAL(testPool.size(), 6U);
+
+    std::vector<CTransactionRef> vtx;
+    vtx.push_back(MakeTransactionRef(txParent));
+    vtx.push_back(MakeTransactionRef(txChild));
+    vtx.push_back(MakeTransactionRef(txDoubleSpend));
+    testPool.removeForBlock(vtx, 1);
+
+    BOOST_CHECK_EQUAL(testPool.size(), 2U);
+    BOOST_CHECK(!testPool.exists(txConflict.GetHash()));
+    BOOST_CHECK(!testPool.exists(txConflictChild.GetHash()));
+    for (const CMutableTransaction& tx : {txGrandChild, txSibling}) {
+        const CTxMemPoolEntry& e = *testPool.mapTx.find(tx.GetHash());
+        BOOST_CHECK_EQUAL(e.GetCountWithAncestors(), 1U);
+        BOOST_CHECK_EQUAL(e.GetSizeWithAncestors(), e.GetTxSize());
+        BOOST_CHECK_EQUAL(e.GetModFeesWithAncestors(), e.GetModifiedFee());
+        BOOST_CHECK_EQUAL(e.GetCountWithDescendants(), 1U);
+        BOOST_CHECK(testPool.GetMemPoolParents(testPool.mapTx.iterator_to(e)).empty());
+    }
+}
+
 template<typename name>
 static void CheckSort(CTxMemPool &pool, std::vector<std::string> &sortedOrder) EXCLUSIVE_LOCKS_REQUIRED(pool.cs)
 {
@@ -443,11 +530,11 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     tx2.vout[0].nValue = 10 * COIN;
     pool.addUnchecked(entry.Fee(5000LL).FromTx(tx2));
 
-    pool.TrimToSize(pool.DynamicMemoryUsage()); // should do nothing
+    pool.TrimToSize(pool.LiveMemoryUsage()); // should do nothing
     BOOST_CHECK(pool.exists(tx1.GetHash()));
     BOOST_CHECK(pool.exists(tx2.GetHash()));
 
-    pool.TrimToSize(pool.DynamicMemoryUsage() * 3 / 4); // should remove the lower-feerate transaction
+    pool.TrimToSize(pool.LiveMemoryUsage() * 3 / 4); // should remove the lower-feerate transaction
     BOOST_CHECK(pool.exists(tx1.GetHash()));
     BOOST_CHECK(!pool.exists(tx2.GetHash()));
 
@@ -461,7 +548,7 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     tx3.vout[0].nValue = 10 * COIN;
     pool.addUnchecked(entry.Fee(20000LL).FromTx(tx3));
 
-    pool.TrimToSize(pool.DynamicMemoryUsage() * 3 / 4); // tx3 should pay for tx2 (CPFP)
+    pool.TrimToSize(pool.LiveMemoryUsage() * 3 / 4); // tx3 should pay for tx2 (CPFP)
     BOOST_CHECK(!pool.exists(tx1.GetHash()));
     BOOST_CHECK(pool.exists(tx2.GetHash()));
     BOOST_CHECK(pool.exists(tx3.GetHash()));
@@ -528,7 +615,7 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     pool.addUnchecked(entry.Fee(9000LL).FromTx(tx7));
 
     // we only require this to remove, at max, 2 txn, because it's not clear what we're really optimizing for aside from that
-    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    pool.TrimToSize(pool.LiveMemoryUsage() - 1);
     BOOST_CHECK(pool.exists(tx4.GetHash()));
     BOOST_CHECK(pool.exists(tx6.GetHash()));
     BOOST_CHECK(!pool.exists(tx7.GetHash()));
@@ -537,7 +624,7 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
         pool.addUnchecked(entry.Fee(1000LL).FromTx(tx5));
     pool.addUnchecked(entry.Fee(9000LL).FromTx(tx7));
 
-    pool.TrimToSize(pool.DynamicMemoryUsage() / 2); // should maximize mempool size by only removing 5/7
+    pool.TrimToSize(pool.LiveMemoryUsage() / 2); // should maximize mempool size by only removing 5/7
     BOOST_CHECK(pool.exists(tx4.GetHash()));
     BOOST_CHECK(!pool.exists(tx5.GetHash()));
     BOOST_CHECK(pool.exists(tx6.GetHash()));
@@ -557,11 +644,11 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     // ... then feerate should drop 1/2 each halflife
 
     SetMockTime(42 + 2*CTxMemPool::ROLLING_FEE_HALFLIFE + CTxMemPool::ROLLING_FEE_HALFLIFE/2);
-    BOOST_CHECK_EQUAL(pool.GetMinFee(pool.DynamicMemoryUsage() * 5 / 2).GetFeePerK(), llround((maxFeeRateRemoved.GetFeePerK() + 1000)/4.0));
+    BOOST_CHECK_EQUAL(pool.GetMinFee(pool.LiveMemoryUsage() * 5 / 2).GetFeePerK(), llround((maxFeeRateRemoved.GetFeePerK() + 1000)/4.0));
     // ... with a 1/2 halflife when mempool is < 1/2 its target size
 
     SetMockTime(42 + 2*CTxMemPool::ROLLING_FEE_HALFLIFE + CTxMemPool::ROLLING_FEE_HALFLIFE/2 + CTxMemPool::ROLLING_FEE_HALFLIFE/4);
-    BOOST_CHECK_EQUAL(pool.GetMinFee(pool.DynamicMemoryUsage() * 9 / 2).GetFeePerK(), llround((maxFeeRateRemoved.GetFeePerK() + 1000)/8.0));
+    BOOST_CHECK_EQUAL(pool.GetMinFee(pool.LiveMemoryUsage() * 9 / 2).GetFeePerK(), llround((maxFeeRateRemoved.GetFeePerK() + 1000)/8.0));
     // ... with a 1/4 halflife when mempool is < 1/4 its target size
 
     SetMockTime(42 + 7*CTxMemPool::ROLLING_FEE_HALFLIFE + CTxMemPool::ROLLING_FEE_HALFLIFE/2 + CTxMemPool::ROLLING_FEE_HALFLIFE/4);
@@ -592,6 +679,45 @@ inline CTransactionRef make_tx(std::vector<CAmount>&& output_values, std::vector
 }
 
 
+BOOST_AUTO_TEST_CASE(MempoolUsagePerEntryTest)
+{
+    // Report what an entry costs besides its transaction, for comparing
+    // changes to the entry layout and to the allocation of mapTx nodes.
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    size_t tx_usage = 0;
+    for (int i = 0; i < 20000; ++i) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+        tx.vin[0].scriptSig = CScript() << OP_11;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        const CTransactionRef ptx = MakeTransactionRef(tx);
+        tx_usage += RecursiveDynamicUsage(ptx);
+        pool.addUnchecked(entry.Fee(1000LL).FromTx(ptx));
+    }
+    const size_t per_entry = (pool.DynamicMemoryUsage() - tx_usage) / pool.size();
+    BOOST_TEST_MESSAGE("Mempool usage per entry, besides the transaction: " << per_entry << " bytes");
+
+    // The mapTx node, plus the mapNextTx node of the input, the vTxHashes slot
+    // and the unused part of the last chunk.
+    const size_t node_usage = sizeof(CTxMemPoolEntry) + 12 * sizeof(void*);
+    BOOST_CHECK(per_entry > node_usage);
+    BOOST_CHECK(per_entry < node_usage + 200);
+    BOOST_CHECK(pool.LiveMemoryUsage() <= pool.DynamicMemoryUsage());
+
+    // Removed entries leave their nodes to the next ones.
+    const size_t usage = pool.DynamicMemoryUsage();
+    pool.TrimToSize(pool.LiveMemoryUsage() / 2);
+    BOOST_CHECK(pool.size() < 20000);
+    BOOST_CHECK(pool.LiveMemoryUsage() < usage / 2);
+    BOOST_CHECK(pool.DynamicMemoryUsage() <= usage);
+}
+
 BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
 {
     size_t ancestors, descendants;
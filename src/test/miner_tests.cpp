@@ -7,15 +7,19 @@
 #include <consensus/consensus.h>
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
+#include <consensus/validation.h>
 #include <miner.h>
 #include <policy/policy.h>
+#include <script/interpreter.h>
 #include <script/standard.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util/strencodings.h>
+#include <util/string.h>
 #include <util/system.h>
 #include <util/time.h>
 #include <validation.h>
+#include <validationinterface.h>
 
 #include <test/util/setup_common.h>
 
@@ -526,4 +530,123 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_FIXTURE_TEST_CASE(BlockTemplateBuilder_tracks_mempool, TestChain100Setup)
+{
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    // The first coinbases are mature once the chain is one block longer.
+    CreateAndProcessBlock({}, scriptPubKey);
+
+    const auto spend_coinbase = [&](int i, CAmount fee) {
+        return MakeTransactionRef(CreateSignedSpend({{m_coinbase_txns[i], 0}}, fee));
+    };
+    const auto accept = [&](const CTransactionRef& tx) {
+        LOCK(cs_main);
+        TxValidationState state;
+        BOOST_CHECK(AcceptToMemoryPool(*m_node.mempool, state, tx, nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */));
+    };
+
+    BlockTemplateBuilder builder(*m_node.mempool, Params(), CScript() << OP_TRUE);
+    RegisterValidationInterface(&builder);
+
+    const std::shared_ptr<const CBlockTemplate> empty = builder.GetTemplate();
+    BOOST_REQUIRE(empty);
+    BOOST_CHECK(empty->block.hashPrevBlock == WITH_LOCK(cs_main, return ::ChainActive().Tip()->GetBlockHash()));
+    BOOST_CHECK_EQUAL(empty->block.vtx.size(), 1U);
+    const CAmount subsidy = empty->block.vtx[0]->vout[0].nValue;
+
+    // Transactions entering the mempool are added to the template, without
+    // changing templates handed out before.
+    const CTransactionRef tx1 = spend_coinbase(0, 10 * CENT);
+    const CTransactionRef tx2 = spend_coinbase(1, 20 * CENT);
+    accept(tx1);
+    accept(tx2);
+    SyncWithValidationInterfaceQueue();
+    const std::shared_ptr<const CBlockTemplate> full = builder.GetTemplate();
+    BOOST_CHECK_EQUAL(empty->block.vtx.size(), 1U);
+    BOOST_REQUIRE_EQUAL(full->block.vtx.size(), 3U);
+    BOOST_CHECK(full->block.vtx[1] == tx1);
+    BOOST_CHECK(full->block.vtx[2] == tx2);
+    BOOST_CHECK_EQUAL(full->block.vtx[0]->vout[0].nValue, subsidy + 30 * CENT);
+    BOOST_CHECK_EQUAL(full->vTxFees[0], -30 * CENT);
+    BOOST_CHECK_EQUAL(full->vTxFees[2], 20 * CENT);
+
+    // Transactions leaving the mempool are removed from the template.
+    WITH_LOCK(m_node.mempool->cs, m_node.mempool->removeRecursive(*tx1, MemPoolRemovalReason::CONFLICT));
+    SyncWithValidationInterfaceQueue();
+    const std::shared_ptr<const CBlockTemplate> removed = builder.GetTemplate();
+    BOOST_REQUIRE_EQUAL(removed->block.vtx.size(), 2U);
+    BOOST_CHECK(removed->block.vtx[1] == tx2);
+    BOOST_CHECK_EQUAL(removed->block.vtx[0]->vout[0].nValue, subsidy + 20 * CENT);
+
+    // A new tip assembles the template again.
+    CreateAndProcessBlock({CMutableTransaction(*tx2)}, scriptPubKey);
+    SyncWithValidationInterfaceQueue();
+    const std::shared_ptr<const CBlockTemplate> next = builder.GetTemplate();
+    BOOST_CHECK(next->block.hashPrevBlock == WITH_LOCK(cs_main, return ::ChainActive().Tip()->GetBlockHash()));
+    BOOST_CHECK_EQUAL(next->block.vtx.size(), 1U);
+
+    UnregisterValidationInterface(&builder);
+    SyncWithValidationInterfaceQueue();
+}
+
+BOOST_FIXTURE_TEST_CASE(BlockTemplateBuilder_evicts_and_requeues, TestChain100Setup)
+{
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CreateAndProcessBlock({}, scriptPubKey);
+
+    const auto accept = [&](const CTransactionRef& tx) {
+        LOCK(cs_main);
+        TxValidationState state;
+        BOOST_CHECK(AcceptToMemoryPool(*m_node.mempool, state, tx, nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */));
+    };
+
+    // A parent, its child, and an unrelated transaction paying twice their
+    // feerate. Only two of them fit in the block.
+    const CTransactionRef parent = MakeTransactionRef(CreateSignedSpend({{m_coinbase_txns[0], 0}}, 10 * CENT));
+    const CTransactionRef child = MakeTransactionRef(CreateSignedSpend({{parent, 0}}, 10 * CENT));
+    const CTransactionRef better = MakeTransactionRef(CreateSignedSpend({{m_coinbase_txns[1], 0}}, 20 * CENT));
+    const int64_t weight = GetTransactionWeight(*parent);
+    gArgs.ForceSetArg("-blockmaxweight", ToString(4000 + 2 * weight + weight / 2));
+
+    BlockTemplateBuilder builder(*m_node.mempool, Params(), CScript() << OP_TRUE);
+    RegisterValidationInterface(&builder);
+    BOOST_REQUIRE(builder.GetTemplate());
+    const auto template_txs = [&]() {
+        const std::shared_ptr<const CBlockTemplate> block_template = builder.GetTemplate();
+        return std::vector<CTransactionRef>(block_template->block.vtx.begin() + 1, block_template->block.vtx.end());
+    };
+
+    accept(parent);
+    accept(child);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(template_txs() == std::vector<CTransactionRef>({parent, child}));
+
+    // The child is the only leaf, so it makes room for the better transaction
+    // although its parent pays no more.
+    accept(better);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(template_txs() == std::vector<CTransactionRef>({parent, better}));
+
+    // Once the better transaction is gone, the evicted child is requeued.
+    WITH_LOCK(m_node.mempool->cs, m_node.mempool->removeRecursive(*better, MemPoolRemovalReason::CONFLICT));
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(template_txs() == std::vector<CTransactionRef>({parent, child}));
+
+    // Removing only the parent from the mempool takes the child out of the
+    // template too.
+    {
+        LOCK(m_node.mempool->cs);
+        CTxMemPool::setEntries stage{m_node.mempool->mapTx.find(parent->GetHash())};
+        m_node.mempool->RemoveStaged(stage, true, MemPoolRemovalReason::CONFLICT);
+    }
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(m_node.mempool->exists(child->GetHash()));
+    BOOST_CHECK(template_txs().empty());
+
+    UnregisterValidationInterface(&builder);
+    SyncWithValidationInterfaceQueue();
+    WITH_LOCK(m_node.mempool->cs, m_node.mempool->removeRecursive(*child, MemPoolRemovalReason::CONFLICT));
+    gArgs.ForceSetArg("-blockmaxweight", ToString(DEFAULT_BLOCK_MAX_WEIGHT));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
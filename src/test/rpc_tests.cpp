@@ -6,12 +6,16 @@
 #include <rpc/server.h>
 #include <rpc/util.h>
 
+#include <chain.h>
+#include <chainparams.h>
 #include <core_io.h>
 #include <interfaces/chain.h>
 #include <node/context.h>
+#include <pow.h>
 #include <test/util/setup_common.h>
 #include <util/ref.h>
 #include <util/time.h>
+#include <validation.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/test/unit_test.hpp>
@@ -23,9 +27,16 @@
 class RPCTestingSetup : public TestingSetup
 {
 public:
+    explicit RPCTestingSetup(const std::string& chain_name = CBaseChainParams::MAIN, const std::vector<const char*>& extra_args = {})
+        : TestingSetup(chain_name, extra_args) {}
     UniValue CallRPC(std::string args);
 };
 
+//! Mines on regtest with several nonce search threads.
+struct GenerateTestingSetup : public RPCTestingSetup {
+    GenerateTestingSetup() : RPCTestingSetup(CBaseChainParams::REGTEST, {"-genproclimit=4"}) {}
+};
+
 UniValue RPCTestingSetup::CallRPC(std::string args)
 {
     std::vector<std::string> vArgs;
@@ -343,6 +354,35 @@ BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
     BOOST_CHECK_EQUAL(result[2].get_int(), 9);
 }
 
+BOOST_FIXTURE_TEST_CASE(rpc_generate_genproclimit, GenerateTestingSetup)
+{
+    const int height = WITH_LOCK(cs_main, return ::ChainActive().Height());
+
+    // Every block found by the workers is valid and connected, in order.
+    UniValue hashes = CallRPC("generatetodescriptor 10 raw(51)");
+    BOOST_REQUIRE_EQUAL(hashes.size(), 10U);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(::ChainActive().Height(), height + 10);
+        for (size_t i = 0; i < hashes.size(); ++i) {
+            const CBlockIndex* pindex = ::ChainActive()[height + 1 + i];
+            BOOST_CHECK_EQUAL(pindex->GetBlockHash().GetHex(), hashes[i].get_str());
+            BOOST_CHECK(pindex->IsValid(BLOCK_VALID_SCRIPTS));
+            BOOST_CHECK(CheckProofOfWork(pindex->GetBlockHash(), pindex->nBits, Params().GetConsensus()));
+        }
+    }
+
+    // The workers share maxtries, so they stop after that many nonces in total
+    // however many blocks were asked for.
+    hashes = CallRPC("generatetodescriptor 100 raw(51) 3");
+    BOOST_CHECK(hashes.size() <= 3);
+    const int mined_height = height + 10 + int(hashes.size());
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return ::ChainActive().Height()), mined_height);
+    hashes = CallRPC("generatetodescriptor 100 raw(51) 0");
+    BOOST_CHECK(hashes.empty());
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return ::ChainActive().Height()), mined_height);
+}
+
 BOOST_AUTO_TEST_CASE(rpc_getblockstats_calculate_percentiles_by_weight)
 {
     int64_t total_weight = 200;
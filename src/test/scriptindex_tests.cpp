@@ -0,0 +1,149 @@
+// Copyright (c) 2020 The Pexa Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/scriptindex.h>
+#include <script/interpreter.h>
+#include <script/standard.h>
+#include <test/util/setup_common.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(scriptindex_tests)
+
+static bool HasUnspent(const ScriptIndex& index, const CScript& script, const COutPoint& outpoint)
+{
+    std::vector<ScriptUnspent> unspents;
+    BOOST_REQUIRE(index.FindScriptUnspent(script, 1000, unspents));
+    for (const ScriptUnspent& unspent : unspents) {
+        if (unspent.outpoint == outpoint) return true;
+    }
+    return false;
+}
+
+BOOST_FIXTURE_TEST_CASE(scriptindex_initial_sync, TestChain100Setup)
+{
+    ScriptIndex script_index(1 << 20, true);
+
+    const CScript coinbase_script = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    std::vector<ScriptHistoryEntry> history;
+    std::vector<ScriptUnspent> unspents;
+
+    // Nothing should be found in the index before it is started.
+    BOOST_CHECK(script_index.FindScriptHistory(coinbase_script, 0, 1000, history));
+    BOOST_CHECK(history.empty());
+
+    // BlockUntilSyncedToCurrentChain should return false before the index is started.
+    BOOST_CHECK(!script_index.BlockUntilSyncedToCurrentChain());
+
+    script_index.Start();
+
+    // Allow the index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!script_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        UninterruptibleSleep(std::chrono::milliseconds{100});
+    }
+
+    // Every coinbase before the index started pays to the script, oldest first.
+    BOOST_REQUIRE(script_index.FindScriptHistory(coinbase_script, 0, 1000, history));
+    BOOST_REQUIRE_EQUAL(history.size(), m_coinbase_txns.size());
+    for (size_t i = 0; i < history.size(); ++i) {
+        BOOST_CHECK(history[i].txid == m_coinbase_txns[i]->GetHash());
+        BOOST_CHECK_EQUAL(history[i].height, int(i) + 1);
+        BOOST_CHECK(!history[i].spending);
+        BOOST_CHECK_EQUAL(history[i].n, 0U);
+        BOOST_CHECK_EQUAL(history[i].amount, m_coinbase_txns[i]->vout[0].nValue);
+    }
+    history.clear();
+    BOOST_REQUIRE(script_index.FindScriptHistory(coinbase_script, 50, 10, history));
+    BOOST_REQUIRE_EQUAL(history.size(), 10U);
+    BOOST_CHECK_EQUAL(history.front().height, 50);
+    BOOST_REQUIRE(script_index.FindScriptUnspent(coinbase_script, 1000, unspents));
+    BOOST_CHECK_EQUAL(unspents.size(), m_coinbase_txns.size());
+
+    // Paging through the history and the unspent outputs returns each entry once.
+    std::vector<ScriptHistoryEntry> paged_history;
+    for (size_t before = 0;; before = paged_history.size()) {
+        const ScriptHistoryEntry after = before ? paged_history.back() : ScriptHistoryEntry{};
+        BOOST_REQUIRE(script_index.FindScriptHistory(coinbase_script, 0, before + 7, paged_history, before ? &after : nullptr));
+        if (paged_history.size() == before) break;
+    }
+    BOOST_REQUIRE_EQUAL(paged_history.size(), m_coinbase_txns.size());
+    for (size_t i = 0; i < paged_history.size(); ++i) {
+        BOOST_CHECK(paged_history[i].txid == m_coinbase_txns[i]->GetHash());
+    }
+    std::vector<ScriptUnspent> paged_unspents;
+    for (size_t before = 0;; before = paged_unspents.size()) {
+        const COutPoint after = before ? paged_unspents.back().outpoint : COutPoint();
+        BOOST_REQUIRE(script_index.FindScriptUnspent(coinbase_script, before + 7, paged_unspents, before ? &after : nullptr));
+        if (paged_unspents.size() == before) break;
+    }
+    std::set<COutPoint> seen;
+    for (const ScriptUnspent& unspent : paged_unspents) seen.insert(unspent.outpoint);
+    BOOST_CHECK_EQUAL(paged_unspents.size(), m_coinbase_txns.size());
+    BOOST_CHECK_EQUAL(seen.size(), m_coinbase_txns.size());
+
+    // Spend the first coinbase to another script.
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript other_script = GetScriptForDestination(PKHash(key.GetPubKey()));
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = other_script;
+    std::vector<unsigned char> vch_sig;
+    const uint256 hash = SignatureHash(coinbase_script, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vch_sig));
+    vch_sig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vch_sig;
+    CreateAndProcessBlock({spend}, coinbase_script);
+    BOOST_CHECK(script_index.BlockUntilSyncedToCurrentChain());
+
+    const COutPoint spent_outpoint = spend.vin[0].prevout;
+    const COutPoint new_outpoint(spend.GetHash(), 0);
+    BOOST_CHECK(!HasUnspent(script_index, coinbase_script, spent_outpoint));
+    BOOST_CHECK(HasUnspent(script_index, other_script, new_outpoint));
+    history.clear();
+    BOOST_REQUIRE(script_index.FindScriptHistory(coinbase_script, 101, 1000, history));
+    BOOST_REQUIRE_EQUAL(history.size(), 2U);
+    // The coinbase comes first in the block.
+    BOOST_CHECK(!history[0].spending);
+    BOOST_CHECK(history[1].spending);
+    BOOST_CHECK(history[1].txid == spend.GetHash());
+    BOOST_CHECK_EQUAL(history[1].tx_pos, 1U);
+    BOOST_CHECK_EQUAL(history[1].n, 0U);
+    BOOST_CHECK_EQUAL(history[1].amount, m_coinbase_txns[0]->vout[0].nValue);
+
+    // Disconnecting the block takes its entries back out once the index
+    // catches up with the next block.
+    BlockValidationState state;
+    BOOST_REQUIRE(::ChainstateActive().InvalidateBlock(state, Params(), WITH_LOCK(cs_main, return ::ChainActive().Tip())));
+    // The block template would claim the fee of the transaction returned to
+    // the mempool, which the block does not include.
+    m_node.mempool->clear();
+    CreateAndProcessBlock({}, GetScriptForDestination(PKHash(coinbaseKey.GetPubKey())));
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return ::ChainActive().Height()), 101);
+    BOOST_CHECK(script_index.BlockUntilSyncedToCurrentChain());
+    BOOST_CHECK(HasUnspent(script_index, coinbase_script, spent_outpoint));
+    BOOST_CHECK(!HasUnspent(script_index, other_script, new_outpoint));
+    history.clear();
+    BOOST_REQUIRE(script_index.FindScriptHistory(other_script, 0, 1000, history));
+    BOOST_CHECK(history.empty());
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    script_index.Stop();
+
+    // Let scheduler events finish running to avoid accessing any memory related to the index after it is destructed
+    SyncWithValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
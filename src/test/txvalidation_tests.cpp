@@ -4,6 +4,7 @@
 
 #include <consensus/validation.h>
 #include <primitives/transaction.h>
+#include <script/interpreter.h>
 #include <script/script.h>
 #include <test/util/setup_common.h>
 #include <validation.h>
@@ -52,4 +53,136 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_coinbase, TestChain100Setup)
     BOOST_CHECK(state.GetResult() == TxValidationResult::TX_CONSENSUS);
 }
 
+/**
+ * Ensure that staged acceptance verifies every input of a transaction while
+ * the scripts are checked outside cs_main.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_accept_staged, TestChain100Setup)
+{
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // Spend two coinbases, so that the inputs are verified on the mempool
+    // script check threads. Both are mature once the chain is one block longer.
+    CreateAndProcessBlock({}, scriptPubKey);
+    const CMutableTransaction spend = CreateSignedSpend({{m_coinbase_txns[0], 0}, {m_coinbase_txns[1], 0}}, 10 * CENT);
+
+    // A signature of the other input is valid DER, but does not verify.
+    CMutableTransaction bad_spend = spend;
+    bad_spend.vin[1].scriptSig = spend.vin[0].scriptSig;
+    TxValidationState state;
+    BOOST_CHECK(!AcceptToMemoryPoolStaged(*m_node.mempool, state, MakeTransactionRef(bad_spend),
+                nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */));
+    BOOST_CHECK(state.GetResult() == TxValidationResult::TX_CONSENSUS);
+    BOOST_CHECK(state.GetRejectReason().find("mandatory-script-verify-flag-failed") == 0);
+    BOOST_CHECK_EQUAL(m_node.mempool->size(), 0U);
+
+    const CTransactionRef ptx = MakeTransactionRef(spend);
+    state = TxValidationState();
+    BOOST_CHECK(AcceptToMemoryPoolStaged(*m_node.mempool, state, ptx,
+                nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */));
+    BOOST_CHECK(m_node.mempool->exists(ptx->GetHash()));
+
+    state = TxValidationState();
+    BOOST_CHECK(!AcceptToMemoryPoolStaged(*m_node.mempool, state, ptx,
+                nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "txn-already-in-mempool");
+}
+
+/**
+ * Ensure that staged acceptance notices the mempool changing while the
+ * scripts are verified: the transaction is still accepted if the change does
+ * not affect it, and validated again under the locks otherwise.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_accept_staged_recheck, TestChain100Setup)
+{
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CTxMemPool& pool = *m_node.mempool;
+
+    // Make the first three coinbases mature.
+    CreateAndProcessBlock({}, scriptPubKey);
+    CreateAndProcessBlock({}, scriptPubKey);
+    const auto accept = [&](const CTransactionRef& tx) {
+        LOCK(cs_main);
+        TxValidationState state;
+        BOOST_CHECK(AcceptToMemoryPool(pool, state, tx, nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */));
+    };
+    const CTransactionRef parent = MakeTransactionRef(CreateSignedSpend({{m_coinbase_txns[0], 0}}, 10 * CENT));
+    accept(parent);
+
+    // An unrelated transaction leaves the ancestors and inputs of the child
+    // as they were, so it is accepted without starting over.
+    const CTransactionRef child = MakeTransactionRef(CreateSignedSpend({{parent, 0}}, 1000));
+    const CTransactionRef other = MakeTransactionRef(CreateSignedSpend({{m_coinbase_txns[1], 0}}, 10 * CENT));
+    g_staged_accept_unlocked_hook = [&] { accept(other); };
+    TxValidationState state;
+    BOOST_CHECK(AcceptToMemoryPoolStaged(pool, state, child, nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */));
+    BOOST_CHECK(pool.exists(child->GetHash()));
+    BOOST_CHECK(pool.exists(other->GetHash()));
+
+    // A transaction spending the same coin makes it start over, and the
+    // conflict is found, as the first one does not signal replaceability.
+    const CTransactionRef spend = MakeTransactionRef(CreateSignedSpend({{m_coinbase_txns[2], 0}}, 10 * CENT));
+    const CTransactionRef conflict = MakeTransactionRef(CreateSignedSpend({{m_coinbase_txns[2], 0}}, 20 * CENT));
+    g_staged_accept_unlocked_hook = [&] { accept(conflict); };
+    state = TxValidationState();
+    BOOST_CHECK(!AcceptToMemoryPoolStaged(pool, state, spend, nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "txn-mempool-conflict");
+    BOOST_CHECK(!pool.exists(spend->GetHash()));
+
+    // A parent leaving the mempool makes it start over, and the input is
+    // found missing.
+    const CTransactionRef grandchild = MakeTransactionRef(CreateSignedSpend({{child, 0}}, 1000));
+    g_staged_accept_unlocked_hook = [&] {
+        LOCK(pool.cs);
+        pool.removeRecursive(*child, MemPoolRemovalReason::CONFLICT);
+    };
+    state = TxValidationState();
+    BOOST_CHECK(!AcceptToMemoryPoolStaged(pool, state, grandchild, nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */));
+    BOOST_CHECK(state.GetResult() == TxValidationResult::TX_MISSING_INPUTS);
+    BOOST_CHECK(!pool.exists(grandchild->GetHash()));
+    BOOST_CHECK(pool.exists(parent->GetHash()));
+
+    g_staged_accept_unlocked_hook = nullptr;
+}
+
+/**
+ * Ensure that a mempool saved to disk is loaded back, with children admitted
+ * after the parents they share a loading batch with, and after parents that
+ * were loaded in an earlier batch.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_dump_load, TestChain100Setup)
+{
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // A batch is 1000 transactions. Transactions are saved parents first, so
+    // 1000 independent ones fill the first batch and their children go into
+    // the second one.
+    const CMutableTransaction fan_out = CreateSignedSpend({{m_coinbase_txns[0], 0}}, 10 * CENT, 1000);
+    CreateAndProcessBlock({fan_out}, scriptPubKey);
+    const CTransactionRef fan_out_tx = MakeTransactionRef(fan_out);
+    std::vector<CTransactionRef> txs;
+    for (uint32_t n = 0; n < fan_out.vout.size(); ++n) {
+        txs.push_back(MakeTransactionRef(CreateSignedSpend({{fan_out_tx, n}}, 1000)));
+    }
+    const CTransactionRef child = MakeTransactionRef(CreateSignedSpend({{txs.back(), 0}}, 1000));
+    txs.push_back(child);
+    const CTransactionRef grandchild = MakeTransactionRef(CreateSignedSpend({{child, 0}}, 1000));
+    txs.push_back(grandchild);
+
+    LOCK(cs_main);
+    for (const CTransactionRef& tx : txs) {
+        TxValidationState state;
+        BOOST_REQUIRE(AcceptToMemoryPool(*m_node.mempool, state, tx,
+                    nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */));
+    }
+    BOOST_CHECK(DumpMempool(*m_node.mempool));
+
+    m_node.mempool->clear();
+    BOOST_CHECK(LoadMempool(*m_node.mempool));
+    BOOST_CHECK_EQUAL(m_node.mempool->size(), txs.size());
+    for (const CTransactionRef& tx : txs) {
+        BOOST_CHECK(m_node.mempool->exists(tx->GetHash()));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include <test/util/setup_common.h>
 
+#include <algo/hash_algos.h>
 #include <banman.h>
 #include <chainparams.h>
 #include <consensus/consensus.h>
@@ -19,6 +20,7 @@
 #include <rpc/blockchain.h>
 #include <rpc/register.h>
 #include <rpc/server.h>
+#include <script/interpreter.h>
 #include <script/sigcache.h>
 #include <streams.h>
 #include <txdb.h>
@@ -96,6 +98,7 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName, const std::ve
     AppInitParameterInteraction();
     LogInstance().StartLogging();
     SHA256AutoDetect();
+    X16RAutoDetect();
     ECC_Start();
     SetupEnvironment();
     SetupNetworking();
@@ -150,10 +153,13 @@ TestingSetup::TestingSetup(const std::string& chainName, const std::vector<const
         throw std::runtime_error(strprintf("ActivateBestChain failed. (%s)", state.ToString()));
     }
 
-    // Start script-checking threads. Set g_parallel_script_checks to true so they are used.
+    // Start script-checking, header hashing and input prefetching threads. Set g_parallel_script_checks to true so they are used.
     constexpr int script_check_threads = 2;
     for (int i = 0; i < script_check_threads; ++i) {
         threadGroup.create_thread([i]() { return ThreadScriptCheck(i); });
+        threadGroup.create_thread([i]() { return ThreadMempoolScriptCheck(i); });
+        threadGroup.create_thread([i]() { return ThreadHeaderHashCheck(i); });
+        threadGroup.create_thread([i]() { return ThreadCoinPrefetch(i); });
     }
     g_parallel_script_checks = true;
 
@@ -187,7 +193,7 @@ TestingSetup::~TestingSetup()
     pblocktree.reset();
 }
 
-TestChain100Setup::TestChain100Setup()
+TestChain100Setup::TestChain100Setup(bool deterministic) : m_deterministic(deterministic)
 {
     // CreateAndProcessBlock() does not support building SegWit blocks, so don't activate in these tests.
     // TODO: fix the code to support SegWit blocks.
@@ -195,13 +201,29 @@ TestChain100Setup::TestChain100Setup()
     // Need to recreate chainparams
     SelectParams(CBaseChainParams::REGTEST);
 
+    if (m_deterministic) {
+        SetMockTime(1598887952);
+        static const unsigned char key[32] = {
+            0x22, 0x12, 0xb8, 0x54, 0xa1, 0x06, 0x31, 0x83, 0x8d, 0x38, 0xa4, 0x87, 0x32, 0x83, 0x27, 0x63,
+            0xbe, 0x4d, 0x45, 0x0e, 0x43, 0x50, 0x78, 0x9f, 0x02, 0x46, 0x72, 0x1c, 0x84, 0x19, 0x3d, 0x0c,
+        };
+        coinbaseKey.Set(key, key + sizeof(key), true);
+    } else {
+        coinbaseKey.MakeNewKey(true);
+    }
+
     // Generate a 100-block chain:
-    coinbaseKey.MakeNewKey(true);
+    MineBlocks(COINBASE_MATURITY);
+}
+
+void TestChain100Setup::MineBlocks(int num_blocks)
+{
     CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
-    for (int i = 0; i < COINBASE_MATURITY; i++)
+    for (int i = 0; i < num_blocks; i++)
     {
         std::vector<CMutableTransaction> noTxns;
         CBlock b = CreateAndProcessBlock(noTxns, scriptPubKey);
+        if (m_deterministic) SetMockTime(GetTime() + 1);
         m_coinbase_txns.push_back(b.vtx[0]);
     }
 }
@@ -234,9 +256,37 @@ CBlock TestChain100Setup::CreateAndProcessBlock(const std::vector<CMutableTransa
     return result;
 }
 
+CMutableTransaction TestChain100Setup::CreateSignedSpend(const std::vector<std::pair<CTransactionRef, uint32_t>>& inputs,
+                                                         CAmount fee, unsigned int num_outputs)
+{
+    const CScript script_pub_key = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    CAmount in_value = 0;
+    for (const auto& input : inputs) {
+        spend.vin.emplace_back(COutPoint(input.first->GetHash(), input.second));
+        in_value += input.first->vout[input.second].nValue;
+    }
+    spend.vout.resize(num_outputs);
+    for (CTxOut& out : spend.vout) {
+        out.nValue = (in_value - fee) / num_outputs;
+        out.scriptPubKey = script_pub_key;
+    }
+    for (unsigned int i = 0; i < spend.vin.size(); ++i) {
+        std::vector<unsigned char> sig;
+        const uint256 hash = SignatureHash(script_pub_key, spend, i, SIGHASH_ALL, 0, SigVersion::BASE);
+        const bool signed_ok = coinbaseKey.Sign(hash, sig);
+        assert(signed_ok);
+        sig.push_back((unsigned char)SIGHASH_ALL);
+        spend.vin[i].scriptSig = CScript() << sig;
+    }
+    return spend;
+}
+
 TestChain100Setup::~TestChain100Setup()
 {
     gArgs.ForceSetArg("-segwitheight", "0");
+    if (m_deterministic) SetMockTime(0);
 }
 
 
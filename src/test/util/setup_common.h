@@ -107,17 +107,36 @@ class CScript;
 // 100-block REGTEST-mode block chain
 //
 struct TestChain100Setup : public RegTestingSetup {
-    TestChain100Setup();
+    /**
+     * @param deterministic  Mine with a fixed key and mock time, so that the
+     *                       chain and its UTXO set hash are the same every run.
+     */
+    explicit TestChain100Setup(bool deterministic = false);
+
+    // Mine num_blocks empty blocks paying to coinbaseKey, advancing the mock
+    // time by a second per block when deterministic.
+    void MineBlocks(int num_blocks);
 
     // Create a new block with just given transactions, coinbase paying to
     // scriptPubKey, and try to add it to the current chain.
     CBlock CreateAndProcessBlock(const std::vector<CMutableTransaction>& txns,
                                  const CScript& scriptPubKey);
 
+    // Create a transaction spending the given outputs, which pay to coinbaseKey
+    // in a P2PK script like the coinbases do, to num_outputs equal outputs
+    // paying to that script again, less fee, and sign it.
+    CMutableTransaction CreateSignedSpend(const std::vector<std::pair<CTransactionRef, uint32_t>>& inputs,
+                                          CAmount fee, unsigned int num_outputs = 1);
+
     ~TestChain100Setup();
 
     std::vector<CTransactionRef> m_coinbase_txns; // For convenience, coinbase transactions
     CKey coinbaseKey; // private/public key needed to spend coinbase transactions
+    bool m_deterministic;
+};
+
+struct TestChain100DeterministicSetup : public TestChain100Setup {
+    TestChain100DeterministicSetup() : TestChain100Setup(true) {}
 };
 
 class CTxMemPoolEntry;
@@ -5,12 +5,14 @@
 #include <boost/test/unit_test.hpp>
 
 #include <chainparams.h>
+#include <clientversion.h>
 #include <consensus/merkle.h>
 #include <consensus/validation.h>
 #include <miner.h>
 #include <pow.h>
 #include <random.h>
 #include <script/standard.h>
+#include <streams.h>
 #include <test/util/setup_common.h>
 #include <util/time.h>
 #include <validation.h>
@@ -339,6 +341,70 @@ BOOST_AUTO_TEST_CASE(mempool_locks_reorg)
     }
 }
 
+BOOST_AUTO_TEST_CASE(load_external_block_file)
+{
+    // A chain that is only known from a block file, as during a reindex.
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    uint256 prev_hash = Params().GetConsensus().hashGenesisBlock;
+    for (int i = 0; i < 21; ++i) {
+        blocks.push_back(GoodBlock(prev_hash));
+        prev_hash = blocks.back()->GetHash();
+    }
+
+    // Some children come before their parents, a record in the middle does
+    // not deserialize, and the last one is cut short.
+    const std::vector<int> order{0, 2, 1, -1, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 19, 18, 17};
+    const FlatFilePos file_pos(1, 0);
+    std::map<uint256, unsigned int> data_pos;
+    {
+        CAutoFile file(OpenBlockFile(file_pos), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!file.IsNull());
+        unsigned int offset = 0;
+        const auto write_record = [&](const std::vector<unsigned char>& data, unsigned int size) {
+            file << Params().MessageStart() << size;
+            file.write((const char*)data.data(), data.size());
+            offset += CMessageHeader::MESSAGE_START_SIZE + sizeof(size) + data.size();
+        };
+        for (int i : order) {
+            std::vector<unsigned char> data;
+            if (i < 0) {
+                // A header followed by an impossible number of transactions
+                data.assign(80, 0);
+                data.insert(data.end(), 9, 0xff);
+            } else {
+                CVectorWriter(SER_DISK, CLIENT_VERSION, data, 0, *blocks[i]);
+                data_pos[blocks[i]->GetHash()] = offset + CMessageHeader::MESSAGE_START_SIZE + sizeof(unsigned int);
+            }
+            write_record(data, data.size());
+        }
+        std::vector<unsigned char> data;
+        CVectorWriter(SER_DISK, CLIENT_VERSION, data, 0, *blocks.back());
+        const unsigned int size = data.size();
+        data.resize(size / 2);
+        write_record(data, size);
+    }
+
+    FlatFilePos pos = file_pos;
+    LoadExternalBlockFile(Params(), OpenBlockFile(file_pos, true), &pos);
+    BlockValidationState state;
+    BOOST_REQUIRE(ActivateBestChain(state, Params()));
+
+    // Every complete block was accepted at the position the serial reader
+    // recorded for it, and the chain is complete up to the truncated one.
+    LOCK(cs_main);
+    for (size_t i = 0; i + 1 < blocks.size(); ++i) {
+        const CBlockIndex* pindex = LookupBlockIndex(blocks[i]->GetHash());
+        BOOST_REQUIRE(pindex);
+        BOOST_CHECK(pindex->nStatus & BLOCK_HAVE_DATA);
+        BOOST_CHECK_EQUAL(pindex->nFile, file_pos.nFile);
+        BOOST_CHECK_EQUAL(pindex->nDataPos, data_pos.at(blocks[i]->GetHash()));
+        BOOST_CHECK_EQUAL(pindex->nHeight, int(i) + 1);
+    }
+    BOOST_CHECK(!LookupBlockIndex(blocks.back()->GetHash()));
+    BOOST_CHECK_EQUAL(::ChainActive().Height(), int(blocks.size()) - 1);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() == blocks[blocks.size() - 2]->GetHash());
+}
+
 BOOST_AUTO_TEST_CASE(witness_commitment_index)
 {
     CScript pubKey;
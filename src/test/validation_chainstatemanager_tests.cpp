@@ -4,10 +4,15 @@
 //
 #include <chainparams.h>
 #include <consensus/validation.h>
+#include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <random.h>
+#include <rpc/blockchain.h>
+#include <streams.h>
 #include <sync.h>
 #include <test/util/setup_common.h>
 #include <uint256.h>
+#include <univalue.h>
 #include <validation.h>
 #include <validationinterface.h>
 
@@ -104,4 +109,235 @@ BOOST_AUTO_TEST_CASE(chainstatemanager)
     WITH_LOCK(::cs_main, manager.Unload());
 }
 
+namespace {
+typedef std::vector<std::pair<COutPoint, Coin>> SnapshotCoins;
+
+void WriteSnapshot(const fs::path& path, const SnapshotMetadata& metadata, const SnapshotCoins& coins)
+{
+    CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+    file << metadata;
+    for (const auto& coin : coins) {
+        file << coin.first << coin.second;
+    }
+}
+
+bool ActivateSnapshot(ChainstateManager& chainman, const fs::path& path)
+{
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    SnapshotMetadata metadata;
+    file >> metadata;
+    return chainman.ActivateSnapshot(file, metadata, /* in_memory */ true);
+}
+
+//! Rewind the chain to the given height and drop everything but the headers
+//! above it, as on a node that has only synced headers that far. Returns the
+//! dropped blocks.
+std::vector<std::shared_ptr<const CBlock>> ForgetBlocksAbove(CChainState& chainstate, int height)
+{
+    CBlockIndex* tip = WITH_LOCK(::cs_main, return chainstate.m_chain.Tip());
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    for (CBlockIndex* index = tip; index->nHeight > height; index = index->pprev) {
+        auto block = std::make_shared<CBlock>();
+        BOOST_REQUIRE(ReadBlockFromDisk(*block, index, Params().GetConsensus()));
+        blocks.insert(blocks.begin(), block);
+    }
+
+    BlockValidationState state;
+    BOOST_REQUIRE(InvalidateBlock(state, Params(), tip->GetAncestor(height + 1)));
+    LOCK(::cs_main);
+    ResetBlockFailureFlags(tip->GetAncestor(height + 1));
+    for (CBlockIndex* index = tip; index->nHeight > height; index = index->pprev) {
+        index->nStatus = (index->nStatus & ~(BLOCK_VALID_MASK | BLOCK_HAVE_MASK)) | BLOCK_VALID_TREE;
+        index->nTx = 0;
+        index->nChainTx = 0;
+        index->nSequenceId = 0;
+        chainstate.setBlockIndexCandidates.erase(index);
+    }
+    BOOST_CHECK_EQUAL(chainstate.m_chain.Height(), height);
+    return blocks;
+}
+} // namespace
+
+//! Load a snapshot of the chain that the regtest assumeutxo data describes
+//! into a node that only has the headers of the last blocks below its base.
+BOOST_FIXTURE_TEST_CASE(chainstatemanager_activate_snapshot, TestChain100DeterministicSetup)
+{
+    ChainstateManager& chainman = *m_node.chainman;
+    CChainState& ibd_chainstate = ::ChainstateActive();
+    const int base_height = 110;
+
+    MineBlocks(base_height - COINBASE_MATURITY);
+    const fs::path path = GetDataDir() / "utxo.dat";
+    {
+        CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        UniValue result = CreateUTXOSnapshot(ibd_chainstate, file, [] {});
+        BOOST_CHECK_EQUAL(result["base_height"].get_int(), base_height);
+    }
+
+    CCoinsStats stats;
+    BOOST_REQUIRE(GetUTXOStats(&WITH_LOCK(::cs_main, return std::ref(ibd_chainstate.CoinsDB())).get(), stats, [] {}));
+    const AssumeutxoData* au_data = ExpectedAssumeutxo(base_height, Params());
+    BOOST_REQUIRE(au_data);
+    BOOST_CHECK_EQUAL(stats.hashSerialized.ToString(), au_data->hash_serialized.ToString());
+    BOOST_CHECK(!ExpectedAssumeutxo(base_height - 1, Params()));
+
+    SnapshotMetadata metadata;
+    SnapshotCoins coins;
+    {
+        CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        file >> metadata;
+        for (uint64_t i = 0; i < metadata.m_coins_count; ++i) {
+            COutPoint outpoint;
+            Coin coin;
+            file >> outpoint >> coin;
+            coins.emplace_back(outpoint, std::move(coin));
+        }
+    }
+    BOOST_CHECK_EQUAL(metadata.m_coins_count, (uint64_t)base_height);
+
+    CBlockIndex* base = WITH_LOCK(::cs_main, return ::ChainActive().Tip());
+    ForgetBlocksAbove(ibd_chainstate, COINBASE_MATURITY);
+
+    // Snapshots that are truncated, too long, for an unknown base or with
+    // different contents are all rejected.
+    auto check_rejected = [&](const SnapshotMetadata& bad_metadata, const SnapshotCoins& bad_coins) {
+        WriteSnapshot(path, bad_metadata, bad_coins);
+        BOOST_CHECK(!ActivateSnapshot(chainman, path));
+        BOOST_CHECK(!chainman.IsSnapshotActive());
+        BOOST_CHECK_EQUAL(&::ChainstateActive(), &ibd_chainstate);
+    };
+    {
+        SnapshotMetadata bad = metadata;
+        bad.m_coins_count += 1;
+        check_rejected(bad, coins);
+        bad.m_coins_count -= 2;
+        check_rejected(bad, coins);
+        bad = metadata;
+        bad.m_base_blockhash = base->pprev->GetBlockHash();
+        check_rejected(bad, coins);
+        bad.m_base_blockhash = InsecureRand256();
+        check_rejected(bad, coins);
+    }
+    {
+        SnapshotCoins bad = coins;
+        bad[0].second.out.nValue += 1;
+        check_rejected(metadata, bad);
+        bad = coins;
+        bad[0].second.nHeight = base_height + 1;
+        check_rejected(metadata, bad);
+    }
+
+    WriteSnapshot(path, metadata, coins);
+    BOOST_REQUIRE(ActivateSnapshot(chainman, path));
+    BOOST_CHECK(!ActivateSnapshot(chainman, path));
+
+    CChainState& snapshot_chainstate = ::ChainstateActive();
+    BOOST_CHECK(&snapshot_chainstate != &ibd_chainstate);
+    BOOST_CHECK(chainman.IsSnapshotActive());
+    BOOST_CHECK(chainman.IsBackgroundIBD(&ibd_chainstate));
+    BOOST_CHECK_EQUAL(chainman.SnapshotBlockhash()->ToString(), base->GetBlockHash().ToString());
+    {
+        LOCK(::cs_main);
+        BOOST_CHECK_EQUAL(chainman.ActiveTip(), base);
+        BOOST_CHECK_EQUAL(ibd_chainstate.m_chain.Height(), COINBASE_MATURITY);
+        BOOST_CHECK(snapshot_chainstate.CoinsTip().HaveCoin(COutPoint(m_coinbase_txns.back()->GetHash(), 0)));
+        BOOST_CHECK_EQUAL(base->nChainTx, au_data->nChainTx);
+        for (CBlockIndex* index = base; index->pprev; index = index->pprev) {
+            BOOST_CHECK(index->HaveTxsDownloaded());
+            BOOST_CHECK_EQUAL(bool(index->nStatus & BLOCK_ASSUMED_VALID), index->nHeight > COINBASE_MATURITY);
+        }
+    }
+
+    // The snapshot chainstate connects the blocks that follow its base.
+    MineBlocks(10);
+    BOOST_CHECK_EQUAL(chainman.ActiveHeight(), base_height + 10);
+    BOOST_CHECK_EQUAL(WITH_LOCK(::cs_main, return ibd_chainstate.m_chain.Height()), COINBASE_MATURITY);
+}
+
+//! Validate the blocks below a loaded snapshot as they arrive and compare the
+//! resulting UTXO set with the snapshot.
+BOOST_FIXTURE_TEST_CASE(chainstatemanager_background_validation, TestChain100DeterministicSetup)
+{
+    ChainstateManager& chainman = *m_node.chainman;
+    CChainState& ibd_chainstate = ::ChainstateActive();
+
+    MineBlocks(10);
+    const fs::path path = GetDataDir() / "utxo.dat";
+    {
+        CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        CreateUTXOSnapshot(ibd_chainstate, file, [] {});
+    }
+    CBlockIndex* base = WITH_LOCK(::cs_main, return ::ChainActive().Tip());
+    const auto blocks = ForgetBlocksAbove(ibd_chainstate, COINBASE_MATURITY);
+    BOOST_REQUIRE(ActivateSnapshot(chainman, path));
+    CChainState& snapshot_chainstate = ::ChainstateActive();
+    {
+        LOCK(::cs_main);
+        const size_t background_size = nCoinCacheUsage / 100 * DEFAULT_BACKGROUND_VALIDATION_CACHE_PERCENT;
+        BOOST_CHECK_EQUAL(ibd_chainstate.m_coinstip_cache_size_bytes, background_size);
+        BOOST_CHECK_EQUAL(snapshot_chainstate.m_coinstip_cache_size_bytes, nCoinCacheUsage - background_size);
+    }
+
+    // Blocks are connected in order once all of their ancestors arrived.
+    BOOST_CHECK(!chainman.ConnectBackgroundBlocks(Params()));
+    for (size_t i = 1; i < blocks.size(); ++i) {
+        BOOST_CHECK(chainman.ProcessNewBlock(Params(), blocks[i], /* fForceProcessing */ true, nullptr));
+    }
+    BOOST_CHECK(!chainman.ConnectBackgroundBlocks(Params()));
+    BOOST_CHECK_EQUAL(WITH_LOCK(::cs_main, return ibd_chainstate.m_chain.Height()), COINBASE_MATURITY);
+    BOOST_CHECK(chainman.ProcessNewBlock(Params(), blocks[0], /* fForceProcessing */ true, nullptr));
+    while (chainman.ConnectBackgroundBlocks(Params())) {}
+
+    BOOST_CHECK(chainman.IsSnapshotValidated());
+    {
+        LOCK(::cs_main);
+        BOOST_CHECK_EQUAL(ibd_chainstate.m_chain.Tip(), base);
+        BOOST_CHECK_EQUAL(chainman.GetAll().size(), 1U);
+        BOOST_CHECK_EQUAL(&chainman.ValidatedChainstate(), &snapshot_chainstate);
+        BOOST_CHECK_EQUAL(snapshot_chainstate.m_coinstip_cache_size_bytes, nCoinCacheUsage);
+        for (CBlockIndex* index = base; index->pprev; index = index->pprev) {
+            BOOST_CHECK(index->IsValid(BLOCK_VALID_SCRIPTS));
+            BOOST_CHECK(!(index->nStatus & BLOCK_ASSUMED_VALID));
+        }
+    }
+
+    // The snapshot chainstate carries on as the only chainstate.
+    MineBlocks(1);
+    BOOST_CHECK_EQUAL(chainman.ActiveHeight(), base->nHeight + 1);
+    BOOST_CHECK(!chainman.ConnectBackgroundBlocks(Params()));
+}
+
+BOOST_AUTO_TEST_CASE(chainstatemanager_detect_snapshot)
+{
+    const uint256 complete = InsecureRand256();
+    const uint256 incomplete = InsecureRand256();
+    const fs::path complete_dir = GetDataDir() / ("chainstate_" + complete.ToString());
+    const fs::path incomplete_dir = GetDataDir() / ("chainstate_" + incomplete.ToString());
+    fs::create_directories(complete_dir);
+    fs::create_directories(incomplete_dir);
+    {
+        CAutoFile file(fsbridge::fopen(complete_dir / "base_blockhash", "wb"), SER_DISK, CLIENT_VERSION);
+        file << complete;
+    }
+
+    LOCK(::cs_main);
+    {
+        ChainstateManager manager;
+        manager.InitializeChainstate();
+        BOOST_CHECK(manager.DetectSnapshotChainstate(/* wipe */ false));
+        BOOST_CHECK(manager.IsSnapshotActive());
+        BOOST_CHECK_EQUAL(manager.SnapshotBlockhash()->ToString(), complete.ToString());
+        BOOST_CHECK(fs::exists(complete_dir));
+        BOOST_CHECK(!fs::exists(incomplete_dir));
+    }
+    {
+        // -reindex and -reindex-chainstate drop the snapshot.
+        ChainstateManager manager;
+        manager.InitializeChainstate();
+        BOOST_CHECK(!manager.DetectSnapshotChainstate(/* wipe */ true));
+        BOOST_CHECK(!manager.IsSnapshotActive());
+        BOOST_CHECK(!fs::exists(complete_dir));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
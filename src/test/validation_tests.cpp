@@ -3,7 +3,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chainparams.h>
+#include <consensus/validation.h>
+#include <headerhashcache.h>
+#include <key.h>
 #include <net.h>
+#include <node/coinstats.h>
+#include <script/interpreter.h>
 #include <validation.h>
 
 #include <test/util/setup_common.h>
@@ -74,4 +79,137 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+BOOST_AUTO_TEST_CASE(read_block_from_disk_checks_index_header)
+{
+    const CBlockIndex* genesis = WITH_LOCK(cs_main, return ::ChainActive().Genesis());
+    BOOST_REQUIRE(genesis);
+
+    CBlock block;
+    BOOST_CHECK(ReadBlockFromDisk(block, genesis, Params().GetConsensus()));
+    BOOST_CHECK(block.GetHash() == genesis->GetBlockHash());
+
+    // A block on disk that does not match the indexed header is rejected.
+    CBlockIndex mismatched = *genesis;
+    mismatched.nNonce++;
+    BOOST_CHECK(!ReadBlockFromDisk(block, &mismatched, Params().GetConsensus()));
+}
+
+BOOST_AUTO_TEST_CASE(precompute_header_hashes)
+{
+    std::vector<CBlockHeader> headers(200);
+    for (CBlockHeader& header : headers) {
+        header.nVersion = 4;
+        header.hashPrevBlock = InsecureRand256();
+        header.hashMerkleRoot = InsecureRand256();
+        header.nTime = InsecureRand32();
+        header.nBits = 0x207fffff;
+        header.nNonce = InsecureRand32();
+    }
+    PrecomputeHeaderHashes(headers);
+    for (const CBlockHeader& header : headers) {
+        BOOST_CHECK(GetCachedHeaderHash(header) == header.GetHash());
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(connect_block_prefetches_inputs, TestChain100Setup)
+{
+    // Mature the first three coinbases, and write the coins out so that they
+    // are only in the database.
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CreateAndProcessBlock({}, scriptPubKey);
+    CreateAndProcessBlock({}, scriptPubKey);
+    ::ChainstateActive().ForceFlushStateToDisk();
+    WITH_LOCK(cs_main, ::ChainstateActive().CoinsTip().EvictToSize(0));
+
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(3);
+    for (int i = 0; i < 3; ++i) {
+        spend.vin[i].prevout = COutPoint(m_coinbase_txns[i]->GetHash(), 0);
+        BOOST_CHECK(WITH_LOCK(cs_main, return !::ChainstateActive().CoinsTip().HaveCoinInCache(spend.vin[i].prevout)));
+    }
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+    for (int i = 0; i < 3; ++i) {
+        std::vector<unsigned char> vchSig;
+        const uint256 hash = SignatureHash(scriptPubKey, spend, i, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        spend.vin[i].scriptSig << vchSig;
+    }
+
+    const CBlock block = CreateAndProcessBlock({spend}, scriptPubKey);
+    LOCK(cs_main);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() == block.GetHash());
+    for (const CTxIn& txin : spend.vin) {
+        BOOST_CHECK(!::ChainstateActive().CoinsTip().HaveCoin(txin.prevout));
+    }
+}
+
+//! Check the rolling UTXO set statistics against a scan of the coins database.
+static void CheckRollingCoinsStats(CChainState& chainstate)
+{
+    CCoinsStats rolling;
+    BOOST_REQUIRE(chainstate.GetRollingCoinsStats(rolling, [] {}));
+    BOOST_CHECK(rolling.from_rolling_stats);
+
+    chainstate.ForceFlushStateToDisk();
+    RollingCoinsStats scanned;
+    uint256 best_block;
+    BOOST_REQUIRE(ComputeRollingCoinsStats(WITH_LOCK(cs_main, return &chainstate.CoinsDB()), scanned, best_block, [] {}));
+    CCoinsStats expected;
+    scanned.GetStats(expected);
+    BOOST_CHECK(best_block == rolling.hashBlock);
+    BOOST_CHECK(expected.hashSerialized == rolling.hashSerialized);
+    BOOST_CHECK_EQUAL(expected.coins_count, rolling.coins_count);
+    BOOST_CHECK_EQUAL(expected.nBogoSize, rolling.nBogoSize);
+    BOOST_CHECK_EQUAL(expected.nTotalAmount, rolling.nTotalAmount);
+}
+
+BOOST_FIXTURE_TEST_CASE(rolling_coins_stats, TestChain100Setup)
+{
+    CChainState& chainstate = ::ChainstateActive();
+    CheckRollingCoinsStats(chainstate);
+    CCoinsStats before;
+    BOOST_REQUIRE(chainstate.GetRollingCoinsStats(before, [] {}));
+
+    // Connect a block that spends a coin.
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHash(), 0);
+    spend.vout.resize(2);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+    spend.vout[1].nValue = 0;
+    spend.vout[1].scriptPubKey = CScript() << OP_RETURN;
+    std::vector<unsigned char> vchSig;
+    const uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+    CreateAndProcessBlock({spend}, scriptPubKey);
+    CheckRollingCoinsStats(chainstate);
+
+    // Disconnecting it restores the statistics.
+    BlockValidationState state;
+    CBlockIndex* tip = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    BOOST_REQUIRE(chainstate.InvalidateBlock(state, Params(), tip));
+    CheckRollingCoinsStats(chainstate);
+    CCoinsStats after;
+    BOOST_REQUIRE(chainstate.GetRollingCoinsStats(after, [] {}));
+    BOOST_CHECK(before.hashSerialized == after.hashSerialized);
+    BOOST_CHECK_EQUAL(before.coins_count, after.coins_count);
+
+    // Missing statistics are recomputed once, then stored with the coins.
+    WITH_LOCK(cs_main, chainstate.m_rolling_stats = nullopt);
+    CheckRollingCoinsStats(chainstate);
+    BOOST_CHECK(WITH_LOCK(cs_main, return chainstate.m_rolling_stats.is_initialized()));
+    RollingCoinsStats stored;
+    BOOST_CHECK(WITH_LOCK(cs_main, return chainstate.CoinsDB().GetRollingStats(stored)));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include <coins.h>
 #include <dbwrapper.h>
 #include <chain.h>
+#include <node/coinstats.h>
 #include <primitives/block.h>
 
 #include <memory>
@@ -36,6 +37,8 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxTxIndexCache = 1024;
 //! Max memory allocated to all block filter index caches combined in MiB.
 static const int64_t max_filter_index_cache = 1024;
+//! Max memory allocated to the script index cache in MiB.
+static const int64_t max_script_index_cache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
 
@@ -44,6 +47,10 @@ class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+
+    //! Rolling statistics to write along with the coins for m_rolling_stats_block.
+    std::unique_ptr<RollingCoinsStats> m_rolling_stats;
+    uint256 m_rolling_stats_block;
 public:
     /**
      * @param[in] ldb_path    Location in the filesystem where leveldb data will be stored.
@@ -54,12 +61,18 @@ public:
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase = true) override;
     CCoinsViewCursor *Cursor() const override;
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    //! Have the next BatchWrite() for best_block store stats along with the
+    //! coins. Any other write, or a null stats, drops the stored statistics.
+    void SetRollingStats(const uint256& best_block, const RollingCoinsStats* stats);
+    //! Read the rolling statistics, if they were stored for the best block.
+    bool GetRollingStats(RollingCoinsStats& stats) const;
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -97,7 +110,12 @@ public:
     void ReadReindexing(bool &fReindexing);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /**
+     * Load all block index entries. Each entry takes the block hash from its
+     * database key; the header is only re-hashed to check that key when
+     * fTrustStoredHash is false.
+     */
+    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, bool fTrustStoredHash = false);
 };
 
 #endif // PEXA_TXDB_H
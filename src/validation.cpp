@@ -17,9 +17,12 @@
 #include <cuckoocache.h>
 #include <flatfile.h>
 #include <hash.h>
+#include <headerhashcache.h>
 #include <index/txindex.h>
 #include <logging.h>
 #include <logging/timer.h>
+#include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <optional.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
@@ -47,7 +50,12 @@
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <condition_variable>
+#include <deque>
+#include <map>
 #include <string>
+#include <thread>
+#include <unordered_set>
 
 #include <boost/algorithm/string/replace.hpp>
 
@@ -74,6 +82,8 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static constexpr std::chrono::hours DATABASE_WRITE_INTERVAL{1};
 /** Time to wait between flushing chainstate to disk. */
 static constexpr std::chrono::hours DATABASE_FLUSH_INTERVAL{24};
+/** Share of the coins cache that is kept warm after a flush that was triggered by its size. */
+static constexpr int COINS_CACHE_RETAIN_PERCENT = 25;
 /** Maximum age of our tip for us to be considered current for fee estimation */
 static constexpr std::chrono::hours MAX_FEE_ESTIMATION_TIP_AGE{3};
 const std::vector<std::string> CHECKLEVEL_DOC {
@@ -206,6 +216,8 @@ std::unique_ptr<CBlockTreeDB> pblocktree;
 static void FindFilesToPruneManual(ChainstateManager& chainman, std::set<int>& setFilesToPrune, int nManualPruneHeight);
 static void FindFilesToPrune(ChainstateManager& chainman, std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
 bool CheckInputScripts(const CTransaction& tx, TxValidationState &state, const CCoinsViewCache &inputs, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr);
+static bool RunInputScripts(const CTransaction& tx, TxValidationState& state, const CCoinsViewCache& inputs, unsigned int flags, bool cacheSigStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck>* pvChecks);
+static bool RunMempoolInputScripts(const CTransaction& tx, TxValidationState& state, const CCoinsViewCache& inputs, unsigned int flags, PrecomputedTransactionData& txdata);
 static FILE* OpenUndoFile(const FlatFilePos &pos, bool fReadOnly = false);
 static FlatFileSeq BlockFileSeq();
 static FlatFileSeq UndoFileSeq();
@@ -378,6 +390,12 @@ static void UpdateMempoolForReorg(DisconnectedBlockTransactions& disconnectpool,
 {
     AssertLockHeld(cs_main);
     std::vector<uint256> vHashUpdate;
+    std::vector<CTransactionRef> vtxRemove;
+    // Only the mempool bookkeeping is batched here: the removals below, and
+    // linking the transactions added back to their in-mempool children in
+    // UpdateTransactionsFromBlock. Each transaction is still validated and
+    // added by its own AcceptToMemoryPool call, which dominates (see the
+    // MempoolReorg benchmark for the bookkeeping alone).
     // disconnectpool's insertion_order index sorts the entries from
     // oldest to newest, but the oldest entry will be the last tx from the
     // latest mined block that was disconnected.
@@ -393,13 +411,16 @@ static void UpdateMempoolForReorg(DisconnectedBlockTransactions& disconnectpool,
                                 nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */)) {
             // If the transaction doesn't make it in to the mempool, remove any
             // transactions that depend on it (which would now be orphans).
-            mempool.removeRecursive(**it, MemPoolRemovalReason::REORG);
+            // None of the transactions added back can depend on those, so
+            // they are removed for all such transactions at once below.
+            vtxRemove.push_back(*it);
         } else if (mempool.exists((*it)->GetHash())) {
             vHashUpdate.push_back((*it)->GetHash());
         }
         ++it;
     }
     disconnectpool.queuedTx.clear();
+    mempool.removeRecursive(vtxRemove, MemPoolRemovalReason::REORG);
     // AcceptToMemoryPool/addUnchecked all assume that new mempool entries have
     // no in-mempool children, which is generally not true when adding
     // previously-confirmed transactions back to the mempool.
@@ -484,6 +505,12 @@ public:
     // Single transaction acceptance
     bool AcceptSingleTransaction(const CTransactionRef& ptx, ATMPArgs& args) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    // Single transaction acceptance that releases cs_main and the mempool lock
+    // while the scripts are verified. If the mempool changed in the meantime,
+    // what PreChecks() found is checked again; only if that no longer holds,
+    // or the chain changed, is the transaction validated from scratch.
+    bool AcceptSingleTransactionStaged(const CTransactionRef& ptx, ATMPArgs& args) LOCKS_EXCLUDED(cs_main);
+
 private:
     // All the intermediate state that gets passed between the various levels
     // of checking a given transaction.
@@ -511,7 +538,8 @@ private:
 
     // Run the script checks using our policy flags. As this can be slow, we should
     // only invoke this on transactions that have otherwise passed policy checks.
-    bool PolicyScriptChecks(ATMPArgs& args, Workspace& ws, PrecomputedTransactionData& txdata) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    // Only uses the inputs PreChecks() cached in m_view, so does not need cs_main.
+    bool PolicyScriptChecks(ATMPArgs& args, Workspace& ws, PrecomputedTransactionData& txdata);
 
     // Re-run the script checks, using consensus flags, and try to cache the
     // result in the scriptcache. This should be done after
@@ -524,6 +552,14 @@ private:
     // limiting is performed, false otherwise.
     bool Finalize(ATMPArgs& args, Workspace& ws) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
 
+    // Check that what PreChecks() found still holds after the locks were
+    // released and retaken, with the tip unchanged but the mempool possibly
+    // changed: the inputs are still unspent, the ancestors and the
+    // transactions to replace are the ones PreChecks() found (given by hash),
+    // and the package limits and fees are still met. Refreshes the mempool
+    // iterators in ws.
+    bool RecheckStaged(ATMPArgs& args, Workspace& ws, const std::set<uint256>& ancestors, const std::set<uint256>& all_conflicting) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
     // Compare a package's feerate against minimum allowed.
     bool CheckFeeRate(size_t package_size, CAmount package_fee, TxValidationState& state)
     {
@@ -933,13 +969,15 @@ bool MemPoolAccept::PolicyScriptChecks(ATMPArgs& args, Workspace& ws, Precompute
 
     // Check input scripts and signatures.
     // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-    if (!CheckInputScripts(tx, state, m_view, scriptVerifyFlags, true, false, txdata)) {
+    // The script execution cache is skipped: it only holds results for the
+    // consensus flags of the tip, which ConsensusScriptChecks() looks up.
+    if (!RunMempoolInputScripts(tx, state, m_view, scriptVerifyFlags, txdata)) {
         // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
         // need to turn both off, and compare against just turning off CLEANSTACK
         // to see if the failure is specifically due to witness validation.
-        TxValidationState state_dummy; // Want reported failures to be from first CheckInputScripts
-        if (!tx.HasWitness() && CheckInputScripts(tx, state_dummy, m_view, scriptVerifyFlags & ~(SCRIPT_VERIFY_WITNESS | SCRIPT_VERIFY_CLEANSTACK), true, false, txdata) &&
-                !CheckInputScripts(tx, state_dummy, m_view, scriptVerifyFlags & ~SCRIPT_VERIFY_CLEANSTACK, true, false, txdata)) {
+        TxValidationState state_dummy; // Want reported failures to be from first RunMempoolInputScripts
+        if (!tx.HasWitness() && RunInputScripts(tx, state_dummy, m_view, scriptVerifyFlags & ~(SCRIPT_VERIFY_WITNESS | SCRIPT_VERIFY_CLEANSTACK), true, txdata, nullptr) &&
+                !RunInputScripts(tx, state_dummy, m_view, scriptVerifyFlags & ~SCRIPT_VERIFY_CLEANSTACK, true, txdata, nullptr)) {
             // Only the witness is missing, so the transaction itself may be fine.
             state.Invalid(TxValidationResult::TX_WITNESS_MUTATED,
                     state.GetRejectReason(), state.GetDebugMessage());
@@ -1058,17 +1096,112 @@ bool MemPoolAccept::AcceptSingleTransaction(const CTransactionRef& ptx, ATMPArgs
     return true;
 }
 
+static std::set<uint256> GetEntryHashes(const CTxMemPool::setEntries& entries)
+{
+    std::set<uint256> hashes;
+    for (CTxMemPool::txiter it : entries) {
+        hashes.insert(it->GetTx().GetHash());
+    }
+    return hashes;
+}
+
+bool MemPoolAccept::RecheckStaged(ATMPArgs& args, Workspace& ws, const std::set<uint256>& ancestors, const std::set<uint256>& all_conflicting)
+{
+    const CTransaction& tx = *ws.m_ptx;
+    if (m_pool.exists(ws.m_hash)) return false;
+
+    // With the same tip, the coins PreChecks() found in the UTXO set are
+    // still there, unless a mempool transaction other than the ones to be
+    // replaced spends them now. Coins from the mempool need their
+    // transaction to still be in it.
+    for (const CTxIn& txin : tx.vin) {
+        const CTransaction* spender = m_pool.GetConflictTx(txin.prevout);
+        if (spender && !ws.m_conflicts.count(spender->GetHash())) return false;
+        if (m_view.AccessCoin(txin.prevout).nHeight == MEMPOOL_HEIGHT && !m_pool.exists(txin.prevout.hash)) return false;
+    }
+    for (const uint256& hash : ws.m_conflicts) {
+        if (!m_pool.exists(hash)) return false;
+    }
+
+    // The ancestors may have gained descendants, so the limits are checked
+    // again. The CPFP carve-out is left to the full path.
+    CTxMemPool::setEntries setAncestors;
+    std::string dummy_err_string;
+    if (!m_pool.CalculateMemPoolAncestors(*ws.m_entry, setAncestors, m_limit_ancestors, m_limit_ancestor_size, m_limit_descendants, m_limit_descendant_size, dummy_err_string) ||
+        GetEntryHashes(setAncestors) != ancestors) {
+        return false;
+    }
+
+    CTxMemPool::setEntries setAllConflicting;
+    for (CTxMemPool::txiter it : m_pool.GetIterSet(ws.m_conflicts)) {
+        m_pool.CalculateDescendants(it, setAllConflicting);
+    }
+    if (GetEntryHashes(setAllConflicting) != all_conflicting) return false;
+
+    // Fee deltas and the mempool minimum fee may have changed.
+    CAmount nModifiedFees = ws.m_entry->GetFee();
+    m_pool.ApplyDelta(ws.m_hash, nModifiedFees);
+    CAmount nConflictingFees = 0;
+    for (CTxMemPool::txiter it : setAllConflicting) {
+        nConflictingFees += it->GetModifiedFee();
+    }
+    if (nModifiedFees != ws.m_modified_fees || nConflictingFees != ws.m_conflicting_fees) return false;
+    TxValidationState state_dummy;
+    if (!args.m_bypass_limits && !CheckFeeRate(ws.m_entry->GetTxSize(), nModifiedFees, state_dummy)) return false;
+
+    ws.m_ancestors = std::move(setAncestors);
+    ws.m_all_conflicting = std::move(setAllConflicting);
+    return true;
+}
+
+bool MemPoolAccept::AcceptSingleTransactionStaged(const CTransactionRef& ptx, ATMPArgs& args)
+{
+    Workspace workspace(ptx);
+    const CBlockIndex* tip;
+    unsigned int transactions_updated;
+    std::set<uint256> ancestors, all_conflicting;
+    {
+        LOCK2(cs_main, m_pool.cs);
+        if (!PreChecks(args, workspace)) return false;
+        tip = ::ChainActive().Tip();
+        transactions_updated = m_pool.GetTransactionsUpdated();
+        ancestors = GetEntryHashes(workspace.m_ancestors);
+        all_conflicting = GetEntryHashes(workspace.m_all_conflicting);
+    }
+
+    // PreChecks() left every input in m_view, detached from the coins cache
+    // and the mempool, so the scripts can be verified without the locks.
+    PrecomputedTransactionData txdata;
+    if (!PolicyScriptChecks(args, workspace, txdata)) return false;
+    if (g_staged_accept_unlocked_hook) g_staged_accept_unlocked_hook();
+
+    LOCK2(cs_main, m_pool.cs);
+    if (tip != ::ChainActive().Tip() ||
+        (transactions_updated != m_pool.GetTransactionsUpdated() && !RecheckStaged(args, workspace, ancestors, all_conflicting))) {
+        // The inputs may have been spent, or the conflicts and ancestors
+        // found by PreChecks() may have changed. Start over under the locks;
+        // the signatures verified above are in the signature cache by now.
+        return MemPoolAccept(m_pool).AcceptSingleTransaction(ptx, args);
+    }
+
+    if (!ConsensusScriptChecks(args, workspace, txdata)) return false;
+
+    // Tx was accepted, but not added
+    if (args.m_test_accept) return true;
+
+    if (!Finalize(args, workspace)) return false;
+
+    GetMainSignals().TransactionAddedToMempool(ptx);
+
+    return true;
+}
+
 } // anon namespace
 
-/** (try to) add transaction to memory pool with a specified acceptance time **/
-static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPool& pool, TxValidationState &state, const CTransactionRef &tx,
-                        int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                        bool bypass_limits, const CAmount nAbsurdFee, bool test_accept) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+/** Remove the coins a rejected transaction brought into the coins cache, and flush the cache if it grew too large. */
+static void FinishAcceptToMemoryPool(const CChainParams& chainparams, bool accepted, const std::vector<COutPoint>& coins_to_uncache) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    std::vector<COutPoint> coins_to_uncache;
-    MemPoolAccept::ATMPArgs args { chainparams, state, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache, test_accept };
-    bool res = MemPoolAccept(pool).AcceptSingleTransaction(tx, args);
-    if (!res) {
+    if (!accepted) {
         // Remove coins that were not present in the coins cache before calling ATMPW;
         // this is to prevent memory DoS in case we receive a large number of
         // invalid transactions that attempt to overrun the in-memory coins cache
@@ -1080,6 +1213,17 @@ static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPo
     // After we've (potentially) uncached entries, ensure our coins cache is still within its size limits
     BlockValidationState state_dummy;
     ::ChainstateActive().FlushStateToDisk(chainparams, state_dummy, FlushStateMode::PERIODIC);
+}
+
+/** (try to) add transaction to memory pool with a specified acceptance time **/
+static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPool& pool, TxValidationState &state, const CTransactionRef &tx,
+                        int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
+                        bool bypass_limits, const CAmount nAbsurdFee, bool test_accept) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    std::vector<COutPoint> coins_to_uncache;
+    MemPoolAccept::ATMPArgs args { chainparams, state, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache, test_accept };
+    bool res = MemPoolAccept(pool).AcceptSingleTransaction(tx, args);
+    FinishAcceptToMemoryPool(chainparams, res, coins_to_uncache);
     return res;
 }
 
@@ -1091,6 +1235,21 @@ bool AcceptToMemoryPool(CTxMemPool& pool, TxValidationState &state, const CTrans
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, GetTime(), plTxnReplaced, bypass_limits, nAbsurdFee, test_accept);
 }
 
+std::function<void()> g_staged_accept_unlocked_hook;
+
+bool AcceptToMemoryPoolStaged(CTxMemPool& pool, TxValidationState &state, const CTransactionRef &tx,
+                              std::list<CTransactionRef>* plTxnReplaced,
+                              bool bypass_limits, const CAmount nAbsurdFee, bool test_accept)
+{
+    const CChainParams& chainparams = Params();
+    std::vector<COutPoint> coins_to_uncache;
+    MemPoolAccept::ATMPArgs args { chainparams, state, GetTime(), plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache, test_accept };
+    bool res = MemPoolAccept(pool).AcceptSingleTransactionStaged(tx, args);
+    LOCK(cs_main);
+    FinishAcceptToMemoryPool(chainparams, res, coins_to_uncache);
+    return res;
+}
+
 /**
  * Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock.
  * If blockIndex is provided, the transaction is fetched from the corresponding block.
@@ -1156,7 +1315,7 @@ static bool WriteBlockToDisk(const CBlock& block, FlatFilePos& pos, const CMessa
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams)
+static bool ReadBlockDataFromDisk(CBlock& block, const FlatFilePos& pos)
 {
     block.SetNull();
 
@@ -1173,6 +1332,14 @@ bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::P
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
+    return true;
+}
+
+bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams)
+{
+    if (!ReadBlockDataFromDisk(block, pos))
+        return false;
+
     // Check the header
     if (!CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
@@ -1188,11 +1355,19 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
         blockPos = pindex->GetBlockPos();
     }
 
-    if (!ReadBlockFromDisk(block, blockPos, consensusParams))
+    if (!ReadBlockDataFromDisk(block, blockPos))
         return false;
-    if (block.GetHash() != pindex->GetBlockHash())
-        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
-                pindex->ToString(), pindex->GetBlockPos().ToString());
+
+    // The proof of work of an indexed block was checked when its header was
+    // accepted (or when the index was loaded), so a header identical to the
+    // indexed one needs no re-hash to prove the right block was read.
+    const CBlockHeader header = pindex->GetBlockHeader();
+    if (block.nVersion != header.nVersion || block.hashPrevBlock != header.hashPrevBlock ||
+        block.hashMerkleRoot != header.hashMerkleRoot || block.nTime != header.nTime ||
+        block.nBits != header.nBits || block.nNonce != header.nNonce)
+        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): header doesn't match index for %s at %s",
+                pindex->ToString(), blockPos.ToString());
+    block.SetCachedHash(pindex->GetBlockHash());
     return true;
 }
 
@@ -1288,12 +1463,72 @@ void CChainState::InitCoinsDB(
 
     m_coins_views = MakeUnique<CoinsViews>(
         leveldb_name, cache_size_bytes, in_memory, should_wipe);
+    m_coinsdb_cache_size_bytes = cache_size_bytes;
 }
 
 void CChainState::InitCoinsCache()
 {
     assert(m_coins_views != nullptr);
     m_coins_views->InitCache();
+    m_coinstip_cache_size_bytes = nCoinCacheUsage;
+
+    RollingCoinsStats rolling_stats;
+    if (CoinsDB().GetBestBlock().IsNull()) {
+        // An empty coins database: the statistics start out empty as well.
+        m_rolling_stats = rolling_stats;
+    } else if (CoinsDB().GetRollingStats(rolling_stats)) {
+        m_rolling_stats = std::move(rolling_stats);
+    } else {
+        LogPrintf("Rolling UTXO set statistics of the %s chainstate are missing or stale, they will be recomputed when first requested\n",
+            m_from_snapshot_blockhash.IsNull() ? "ibd" : "snapshot");
+        m_rolling_stats = nullopt;
+    }
+}
+
+bool CChainState::GetRollingCoinsStats(CCoinsStats& stats, const std::function<void()>& interruption_point)
+{
+    CCoinsViewDB* coins_db;
+    {
+        LOCK(::cs_main);
+        coins_db = &CoinsDB();
+        // The best block of the coins may not be indexed (yet), e.g. while a
+        // UTXO snapshot is loaded; then scan the coins database instead.
+        const CBlockIndex* pindex = LookupBlockIndex(CoinsTip().GetBestBlock());
+        if (m_rolling_stats && pindex) {
+            stats = CCoinsStats();
+            m_rolling_stats->GetStats(stats);
+            stats.hashBlock = pindex->GetBlockHash();
+            stats.nHeight = pindex->nHeight;
+            stats.nDiskSize = coins_db->EstimateSize();
+            return true;
+        }
+    }
+
+    // Bring the coins database up to the tip and scan it once.
+    ForceFlushStateToDisk();
+    RollingCoinsStats rolling_stats;
+    uint256 best_block;
+    if (!ComputeRollingCoinsStats(coins_db, rolling_stats, best_block, interruption_point)) {
+        return false;
+    }
+
+    LOCK(::cs_main);
+    // Only keep the result if no blocks were connected during the scan, as
+    // their coins are not part of it.
+    if (!m_rolling_stats && CoinsTip().GetBestBlock() == best_block) {
+        LogPrintf("Recomputed the rolling UTXO set statistics at block %s\n", best_block.ToString());
+        m_rolling_stats = rolling_stats;
+    }
+    const CBlockIndex* pindex = LookupBlockIndex(best_block);
+    if (!pindex) {
+        return error("%s: best block %s of the coins database is not in the block index", __func__, best_block.ToString());
+    }
+    stats = CCoinsStats();
+    rolling_stats.GetStats(stats);
+    stats.hashBlock = best_block;
+    stats.nHeight = pindex->nHeight;
+    stats.nDiskSize = coins_db->EstimateSize();
+    return true;
 }
 
 // Note that though this is marked const, we may end up modifying `m_cached_finished_ibd`, which
@@ -1512,45 +1747,13 @@ void InitScriptExecutionCache() {
 }
 
 /**
- * Check whether all of this transaction's input scripts succeed.
- *
- * This involves ECDSA signature checks so can be computationally intensive. This function should
- * only be called after the cheap sanity checks in CheckTxInputs passed.
- *
- * If pvChecks is not nullptr, script checks are pushed onto it instead of being performed inline. Any
- * script checks which are not necessary (eg due to script execution cache hits) are, obviously,
- * not pushed onto pvChecks/run.
- *
- * Setting cacheSigStore/cacheFullScriptStore to false will remove elements from the corresponding cache
- * which are matched. This is useful for checking blocks where we will likely never need the cache
- * entry again.
- *
- * Note that we may set state.reason to NOT_STANDARD for extra soft-fork flags in flags, block-checking
- * callers should probably reset it to CONSENSUS in such cases.
- *
- * Non-static (and re-declared) in src/test/txvalidationcache_tests.cpp
+ * Run the script checks of CheckInputScripts(), without consulting or
+ * updating the script execution cache. Unlike CheckInputScripts() this does
+ * not require cs_main, so that mempool acceptance can verify scripts without
+ * holding it.
  */
-bool CheckInputScripts(const CTransaction& tx, TxValidationState &state, const CCoinsViewCache &inputs, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+static bool RunInputScripts(const CTransaction& tx, TxValidationState& state, const CCoinsViewCache& inputs, unsigned int flags, bool cacheSigStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck>* pvChecks)
 {
-    if (tx.IsCoinBase()) return true;
-
-    if (pvChecks) {
-        pvChecks->reserve(tx.vin.size());
-    }
-
-    // First check if script executions have been cached with the same
-    // flags. Note that this assumes that the inputs provided are
-    // correct (ie that the transaction hash which is in tx's prevouts
-    // properly commits to the scriptPubKey in the inputs view of that
-    // transaction).
-    uint256 hashCacheEntry;
-    CSHA256 hasher = g_scriptExecutionCacheHasher;
-    hasher.Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
-    AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
-    if (g_scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
-        return true;
-    }
-
     if (!txdata.m_ready) {
         txdata.Init(tx);
     }
@@ -1598,6 +1801,50 @@ bool CheckInputScripts(const CTransaction& tx, TxValidationState &state, const C
             return state.Invalid(TxValidationResult::TX_CONSENSUS, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
         }
     }
+    return true;
+}
+
+/**
+ * Check whether all of this transaction's input scripts succeed.
+ *
+ * This involves ECDSA signature checks so can be computationally intensive. This function should
+ * only be called after the cheap sanity checks in CheckTxInputs passed.
+ *
+ * If pvChecks is not nullptr, script checks are pushed onto it instead of being performed inline. Any
+ * script checks which are not necessary (eg due to script execution cache hits) are, obviously,
+ * not pushed onto pvChecks/run.
+ *
+ * Setting cacheSigStore/cacheFullScriptStore to false will remove elements from the corresponding cache
+ * which are matched. This is useful for checking blocks where we will likely never need the cache
+ * entry again.
+ *
+ * Note that we may set state.reason to NOT_STANDARD for extra soft-fork flags in flags, block-checking
+ * callers should probably reset it to CONSENSUS in such cases.
+ *
+ * Non-static (and re-declared) in src/test/txvalidationcache_tests.cpp
+ */
+bool CheckInputScripts(const CTransaction& tx, TxValidationState &state, const CCoinsViewCache &inputs, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (tx.IsCoinBase()) return true;
+
+    if (pvChecks) {
+        pvChecks->reserve(tx.vin.size());
+    }
+
+    // First check if script executions have been cached with the same
+    // flags. Note that this assumes that the inputs provided are
+    // correct (ie that the transaction hash which is in tx's prevouts
+    // properly commits to the scriptPubKey in the inputs view of that
+    // transaction).
+    uint256 hashCacheEntry;
+    CSHA256 hasher = g_scriptExecutionCacheHasher;
+    hasher.Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+    AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
+    if (g_scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
+        return true;
+    }
+
+    if (!RunInputScripts(tx, state, inputs, flags, cacheSigStore, txdata, pvChecks)) return false;
 
     if (cacheFullScriptStore && !pvChecks) {
         // We executed all of the provided scripts, and were told to
@@ -1722,7 +1969,7 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  When FAILED is returned, view is left in an indeterminate state. */
-DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view)
+DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, RollingCoinsStats* rolling_stats)
 {
     bool fClean = true;
 
@@ -1737,6 +1984,16 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
         return DISCONNECT_FAILED;
     }
 
+    // The undo data is moved into the view below, so update a copy of the
+    // rolling statistics now and only keep it if the block disconnects cleanly.
+    Optional<RollingCoinsStats> updated_stats;
+    if (rolling_stats) {
+        updated_stats = *rolling_stats;
+        if (!updated_stats->ApplyBlock(block, blockUndo, pindex->nHeight, /* connect */ false)) {
+            updated_stats = nullopt;
+        }
+    }
+
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction &tx = *(block.vtx[i]);
@@ -1776,6 +2033,8 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
+    if (fClean && updated_stats) *rolling_stats = std::move(*updated_stats);
+
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
@@ -1835,6 +2094,167 @@ void ThreadScriptCheck(int worker_num) {
     scriptcheckqueue.Thread();
 }
 
+/** Script checks of transactions submitted to the mempool, which run without cs_main and so may overlap with block validation. */
+static CCheckQueue<CScriptCheck> mempoolscriptcheckqueue(128);
+
+void ThreadMempoolScriptCheck(int worker_num) {
+    util::ThreadRename(strprintf("mempsc.%i", worker_num));
+    mempoolscriptcheckqueue.Thread();
+}
+
+/**
+ * Verify the input scripts of a transaction submitted to the mempool, spread
+ * over the mempool script check threads. A transaction with a single input
+ * is verified on the calling thread, as the queue would only add overhead.
+ * Does not require cs_main, and does not use the script execution cache.
+ */
+static bool RunMempoolInputScripts(const CTransaction& tx, TxValidationState& state, const CCoinsViewCache& inputs, unsigned int flags, PrecomputedTransactionData& txdata)
+{
+    if (!g_parallel_script_checks || tx.vin.size() < 2) {
+        return RunInputScripts(tx, state, inputs, flags, /* cacheSigStore */ true, txdata, nullptr);
+    }
+
+    std::vector<CScriptCheck> checks;
+    checks.reserve(tx.vin.size());
+    RunInputScripts(tx, state, inputs, flags, /* cacheSigStore */ true, txdata, &checks);
+    CCheckQueueControl<CScriptCheck> control(&mempoolscriptcheckqueue);
+    control.Add(checks);
+    if (control.Wait()) return true;
+
+    // Find out which input failed and why. The signatures that were valid
+    // are in the signature cache by now.
+    return RunInputScripts(tx, state, inputs, flags, /* cacheSigStore */ true, txdata, nullptr);
+}
+
+/** Script checks of the background chainstate, so that they don't compete with the tip for the same threads. */
+static CCheckQueue<CScriptCheck> background_scriptcheckqueue(128);
+
+void ThreadBackgroundScriptCheck(int worker_num) {
+    util::ThreadRename(strprintf("bgscrch.%i", worker_num));
+    ScheduleBatchPriority();
+    background_scriptcheckqueue.Thread();
+}
+
+/** Computes the hash of one header so that it is cached in the header. */
+class CHeaderHashCheck
+{
+private:
+    const CBlockHeader* m_header{nullptr};
+
+public:
+    CHeaderHashCheck() {}
+    explicit CHeaderHashCheck(const CBlockHeader& header) : m_header(&header) {}
+
+    bool operator()()
+    {
+        GetCachedHeaderHash(*m_header);
+        return true;
+    }
+
+    void swap(CHeaderHashCheck& check) { std::swap(m_header, check.m_header); }
+};
+
+static CCheckQueue<CHeaderHashCheck> headerhashqueue(16);
+
+void ThreadHeaderHashCheck(int worker_num) {
+    util::ThreadRename(strprintf("hdrhash.%i", worker_num));
+    headerhashqueue.Thread();
+}
+
+void PrecomputeHeaderHashes(const std::vector<CBlockHeader>& headers)
+{
+    if (headers.size() == 1) {
+        GetCachedHeaderHash(headers[0]);
+        return;
+    }
+    std::vector<CHeaderHashCheck> checks;
+    checks.reserve(headers.size());
+    for (const CBlockHeader& header : headers) {
+        checks.emplace_back(header);
+    }
+    // Without worker threads the calling thread does all of the work.
+    CCheckQueueControl<CHeaderHashCheck> control(&headerhashqueue);
+    control.Add(checks);
+    control.Wait();
+}
+
+/** Reads one coin from the coins database so that block connection does not wait for it. */
+class CCoinPrefetch
+{
+private:
+    const CCoinsView* m_db{nullptr};
+    const COutPoint* m_outpoint{nullptr};
+    Coin* m_coin{nullptr};
+
+public:
+    CCoinPrefetch() {}
+    CCoinPrefetch(const CCoinsView& db, const COutPoint& outpoint, Coin& coin) : m_db(&db), m_outpoint(&outpoint), m_coin(&coin) {}
+
+    bool operator()()
+    {
+        try {
+            if (!m_db->GetCoin(*m_outpoint, *m_coin)) m_coin->Clear();
+        } catch (const std::runtime_error&) {
+            // Leave it to the serial read in ConnectBlock to report database errors.
+            m_coin->Clear();
+        }
+        return true;
+    }
+
+    void swap(CCoinPrefetch& check)
+    {
+        std::swap(m_db, check.m_db);
+        std::swap(m_outpoint, check.m_outpoint);
+        std::swap(m_coin, check.m_coin);
+    }
+};
+
+static CCheckQueue<CCoinPrefetch> coinprefetchqueue(16);
+
+void ThreadCoinPrefetch(int worker_num) {
+    util::ThreadRename(strprintf("coinpref.%i", worker_num));
+    coinprefetchqueue.Thread();
+}
+
+/**
+ * Read the inputs of block that are missing from cache from the database in
+ * parallel, and add them to cache. Inputs that are created earlier in the
+ * same block are skipped.
+ */
+static void PrefetchBlockInputs(const CBlock& block, CCoinsViewCache& cache, const CCoinsView& db) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    // Without worker threads this would only do the reads ConnectBlock does anyway.
+    if (!g_parallel_script_checks) return;
+
+    std::unordered_set<uint256, SaltedTxidHasher> txids;
+    std::vector<COutPoint> outpoints;
+    for (const auto& tx : block.vtx) {
+        if (!tx->IsCoinBase()) {
+            for (const CTxIn& txin : tx->vin) {
+                if (!txids.count(txin.prevout.hash) && !cache.HaveCoinInCache(txin.prevout)) {
+                    outpoints.push_back(txin.prevout);
+                }
+            }
+        }
+        txids.insert(tx->GetHash());
+    }
+    if (outpoints.size() < 2) return;
+
+    std::vector<Coin> coins(outpoints.size());
+    std::vector<CCoinPrefetch> checks;
+    checks.reserve(outpoints.size());
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        checks.emplace_back(db, outpoints[i], coins[i]);
+    }
+    CCheckQueueControl<CCoinPrefetch> control(&coinprefetchqueue);
+    control.Add(checks);
+    control.Wait();
+
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        if (!coins[i].IsSpent()) cache.EmplaceFetchedCoin(outpoints[i], std::move(coins[i]));
+    }
+}
+
 VersionBitsCache versionbitscache GUARDED_BY(cs_main);
 
 int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
@@ -1957,7 +2377,8 @@ static int64_t nBlocksTotal = 0;
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
 bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state, CBlockIndex* pindex,
-                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck)
+                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck,
+                  RollingCoinsStats* rolling_stats)
 {
     AssertLockHeld(cs_main);
     assert(pindex);
@@ -2144,7 +2565,8 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     // in multiple threads). Preallocate the vector size so a new allocation
     // doesn't invalidate pointers into the vector, and keep txsdata in scope
     // for as long as `control`.
-    CCheckQueueControl<CScriptCheck> control(fScriptChecks && g_parallel_script_checks ? &scriptcheckqueue : nullptr);
+    CCheckQueue<CScriptCheck>& check_queue = g_chainman.IsBackgroundIBD(this) ? background_scriptcheckqueue : scriptcheckqueue;
+    CCheckQueueControl<CScriptCheck> control(fScriptChecks && g_parallel_script_checks ? &check_queue : nullptr);
     std::vector<PrecomputedTransactionData> txsdata(block.vtx.size());
 
     std::vector<int> prevheights;
@@ -2241,8 +2663,15 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     if (!WriteUndoDataForBlock(blockundo, state, pindex, chainparams))
         return false;
 
+    if (rolling_stats) {
+        bool applied = rolling_stats->ApplyBlock(block, blockundo, pindex->nHeight, /* connect */ true);
+        assert(applied);
+    }
+
     if (!pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
         pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+        // The block is no longer just assumed valid below a UTXO snapshot.
+        pindex->nStatus &= ~BLOCK_ASSUMED_VALID;
         setDirtyBlockIndex.insert(pindex);
     }
 
@@ -2261,10 +2690,11 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
 
 CoinsCacheSizeState CChainState::GetCoinsCacheSizeState(const CTxMemPool& tx_pool)
 {
+    // The background chainstate doesn't share in the unused mempool space.
     return this->GetCoinsCacheSizeState(
         tx_pool,
-        nCoinCacheUsage,
-        gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
+        m_coinstip_cache_size_bytes,
+        g_chainman.IsBackgroundIBD(this) ? 0 : gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
 }
 
 CoinsCacheSizeState CChainState::GetCoinsCacheSizeState(
@@ -2405,13 +2835,22 @@ bool CChainState::FlushStateToDisk(
                 return AbortNode(state, "Disk space is too low!", _("Disk space is too low!"));
             }
             // Flush the chainstate (which may refer to block index entries).
-            if (!CoinsTip().Flush())
+            // Only modified coins are written, and the rest of the cache stays
+            // warm. When the flush is for memory, the oldest coins are evicted.
+            // Store the rolling UTXO set statistics in the same batch as the
+            // coins they describe, so that they are never out of step on disk.
+            CoinsDB().SetRollingStats(CoinsTip().GetBestBlock(), m_rolling_stats.get_ptr());
+            if (!CoinsTip().Sync())
                 return AbortNode(state, "Failed to write to coin database");
+            if (fCacheLarge || fCacheCritical) {
+                CoinsTip().EvictToSize(m_coinstip_cache_size_bytes / 100 * COINS_CACHE_RETAIN_PERCENT);
+                LogPrint(BCLog::COINDB, "Kept %u coins (%.2fkB) in the coins cache\n", CoinsTip().GetCacheSize(), CoinsTip().DynamicMemoryUsage() / 1000.0);
+            }
             nLastFlush = nNow;
             full_flush_completed = true;
         }
     }
-    if (full_flush_completed) {
+    if (full_flush_completed && !g_chainman.IsBackgroundIBD(this)) {
         // Update best block in wallet (so we can detect restored wallets).
         GetMainSignals().ChainStateFlushed(m_chain.GetLocator());
     }
@@ -2530,7 +2969,7 @@ bool CChainState::DisconnectTip(BlockValidationState& state, const CChainParams&
     {
         CCoinsViewCache view(&CoinsTip());
         assert(view.GetBestBlock() == pindexDelete->GetBlockHash());
-        if (DisconnectBlock(block, pindexDelete, view) != DISCONNECT_OK)
+        if (DisconnectBlock(block, pindexDelete, view, m_rolling_stats.get_ptr()) != DISCONNECT_OK)
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         bool flushed = view.Flush();
         assert(flushed);
@@ -2555,6 +2994,9 @@ bool CChainState::DisconnectTip(BlockValidationState& state, const CChainParams&
 
     m_chain.SetTip(pindexDelete->pprev);
 
+    // Nothing outside of validation follows the background chainstate.
+    if (g_chainman.IsBackgroundIBD(this)) return true;
+
     UpdateTip(pindexDelete->pprev, chainparams);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
@@ -2563,6 +3005,7 @@ bool CChainState::DisconnectTip(BlockValidationState& state, const CChainParams&
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2633,18 +3076,21 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    PrefetchBlockInputs(blockConnecting, CoinsTip(), CoinsDB());
+    int64_t nTimePrefetched = GetTimeMicros(); nTimePrefetch += nTimePrefetched - nTime2;
+    LogPrint(BCLog::BENCH, "  - Prefetch inputs: %.2fms [%.2fs]\n", (nTimePrefetched - nTime2) * MILLI, nTimePrefetch * MICRO);
     {
         CCoinsViewCache view(&CoinsTip());
-        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
+        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams, /* fJustCheck */ false, m_rolling_stats.get_ptr());
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
                 InvalidBlockFound(pindexNew, state);
             return error("%s: ConnectBlock %s failed, %s", __func__, pindexNew->GetBlockHash().ToString(), state.ToString());
         }
-        nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
+        nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTimePrefetched;
         assert(nBlocksTotal > 0);
-        LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
+        LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTimePrefetched) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
         bool flushed = view.Flush();
         assert(flushed);
     }
@@ -2655,13 +3101,24 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
         return false;
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
     LogPrint(BCLog::BENCH, "  - Writing chainstate: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime5 - nTime4) * MILLI, nTimeChainState * MICRO, nTimeChainState * MILLI / nBlocksTotal);
-    // Remove conflicting transactions from the mempool.;
-    mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
-    disconnectpool.removeForBlock(blockConnecting.vtx);
+    // The background chainstate validates historic blocks; the mempool and
+    // the notifications for a new tip follow the active chainstate only.
+    const bool background = g_chainman.IsBackgroundIBD(this);
+    if (!background) {
+        // Remove conflicting transactions from the mempool.;
+        mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
+        disconnectpool.removeForBlock(blockConnecting.vtx);
+    }
     // Update m_chain & related variables.
     m_chain.SetTip(pindexNew);
-    UpdateTip(pindexNew, chainparams);
-
+    if (background) {
+        LogPrintf("[background validation] new best=%s height=%d tx=%lu date='%s' cache=%.1fMiB(%utxo)\n",
+            pindexNew->GetBlockHash().ToString(), pindexNew->nHeight, (unsigned long)pindexNew->nChainTx,
+            FormatISO8601DateTime(pindexNew->GetBlockTime()), CoinsTip().DynamicMemoryUsage() * (1.0 / (1<<20)), CoinsTip().GetCacheSize());
+    } else {
+        UpdateTip(pindexNew, chainparams);
+    }
+
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
@@ -2753,15 +3210,17 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, const CChai
 
     const CBlockIndex *pindexOldTip = m_chain.Tip();
     const CBlockIndex *pindexFork = m_chain.FindFork(pindexMostWork);
+    // The mempool follows the active chainstate only.
+    const bool background = g_chainman.IsBackgroundIBD(this);
 
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
     DisconnectedBlockTransactions disconnectpool;
     while (m_chain.Tip() && m_chain.Tip() != pindexFork) {
-        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+        if (!DisconnectTip(state, chainparams, background ? nullptr : &disconnectpool)) {
             // This is likely a fatal error, but keep the mempool consistent,
             // just in case. Only remove from the mempool in this case.
-            UpdateMempoolForReorg(disconnectpool, false);
+            if (!background) UpdateMempoolForReorg(disconnectpool, false);
 
             // If we're unable to disconnect a block during normal operation,
             // then that is a failure of our local system -- we should abort
@@ -2805,7 +3264,7 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, const CChai
                     // A system error occurred (disk space, database error, ...).
                     // Make the mempool consistent with the current tip, just in case
                     // any observers try to use it before shutdown.
-                    UpdateMempoolForReorg(disconnectpool, false);
+                    if (!background) UpdateMempoolForReorg(disconnectpool, false);
                     return false;
                 }
             } else {
@@ -2819,6 +3278,8 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, const CChai
         }
     }
 
+    if (background) return true;
+
     if (fBlocksDisconnected) {
         // If any blocks were disconnected, disconnectpool may be non empty.  Add
         // any disconnected transactions back to the mempool.
@@ -2888,6 +3349,9 @@ bool CChainState::ActivateBestChain(BlockValidationState &state, const CChainPar
     CBlockIndex *pindexMostWork = nullptr;
     CBlockIndex *pindexNewTip = nullptr;
     int nStopAtHeight = gArgs.GetArg("-stopatheight", DEFAULT_STOPATHEIGHT);
+    // Only the active chainstate notifies listeners about its blocks.
+    const bool background = WITH_LOCK(::cs_main, return g_chainman.IsBackgroundIBD(this));
+    if (background) nStopAtHeight = 0;
     do {
         // Block until the validation queue drains. This should largely
         // never happen in normal operation, however may happen during
@@ -2931,7 +3395,7 @@ bool CChainState::ActivateBestChain(BlockValidationState &state, const CChainPar
 
                 for (const PerBlockConnectTrace& trace : connectTrace.GetBlocksConnected()) {
                     assert(trace.pblock && trace.pindex);
-                    GetMainSignals().BlockConnected(trace.pblock, trace.pindex);
+                    if (!background) GetMainSignals().BlockConnected(trace.pblock, trace.pindex);
                 }
             } while (!m_chain.Tip() || (starting_tip && CBlockIndexWorkComparator()(m_chain.Tip(), starting_tip)));
             if (!blocks_connected) return true;
@@ -2941,7 +3405,7 @@ bool CChainState::ActivateBestChain(BlockValidationState &state, const CChainPar
 
             // Notify external listeners about the new tip.
             // Enqueue while holding cs_main to ensure that UpdatedBlockTip is called in the order in which blocks are connected
-            if (pindexFork != pindexNewTip) {
+            if (pindexFork != pindexNewTip && !background) {
                 // Notify ValidationInterface subscribers
                 GetMainSignals().UpdatedBlockTip(pindexNewTip, pindexFork, fInitialDownload);
 
@@ -3183,12 +3647,11 @@ void ResetBlockFailureFlags(CBlockIndex *pindex) {
     return ::ChainstateActive().ResetBlockFailureFlags(pindex);
 }
 
-CBlockIndex* BlockManager::AddToBlockIndex(const CBlockHeader& block)
+CBlockIndex* BlockManager::AddToBlockIndex(const CBlockHeader& block, const uint256& hash)
 {
     AssertLockHeld(cs_main);
 
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator it = m_block_index.find(hash);
     if (it != m_block_index.end())
         return it->second;
@@ -3342,10 +3805,10 @@ static bool FindUndoPos(BlockValidationState &state, int nFile, FlatFilePos &pos
     return true;
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
+static bool CheckBlockHeader(const CBlockHeader& block, const uint256& hash, BlockValidationState& state, const Consensus::Params& consensusParams)
 {
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
+    if (!CheckProofOfWork(hash, block.nBits, consensusParams))
         return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "high-hash", "proof of work failed");
 
     return true;
@@ -3360,7 +3823,7 @@ bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensu
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
+    if (fCheckPOW && !CheckBlockHeader(block, block.GetHash(), state, consensusParams))
         return false;
 
     // Check the merkle root.
@@ -3649,11 +4112,10 @@ static bool ContextualCheckBlock(const CBlock& block, BlockValidationState& stat
     return true;
 }
 
-bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, const uint256& hash, BlockValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator miSelf = m_block_index.find(hash);
     CBlockIndex *pindex = nullptr;
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
@@ -3669,7 +4131,7 @@ bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationS
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, hash, state, chainparams.GetConsensus()))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), state.ToString());
 
         // Get prev block index
@@ -3727,7 +4189,7 @@ bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationS
         }
     }
     if (pindex == nullptr)
-        pindex = AddToBlockIndex(block);
+        pindex = AddToBlockIndex(block, hash);
 
     if (ppindex)
         *ppindex = pindex;
@@ -3739,12 +4201,16 @@ bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationS
 bool ChainstateManager::ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, BlockValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex)
 {
     AssertLockNotHeld(cs_main);
+    // Run the proof-of-work hashes for the whole batch in parallel before
+    // taking cs_main; the serial checks below then find them in the header
+    // hash cache.
+    PrecomputeHeaderHashes(headers);
     {
         LOCK(cs_main);
         for (const CBlockHeader& header : headers) {
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
             bool accepted = m_blockman.AcceptBlockHeader(
-                header, state, chainparams, &pindex);
+                header, GetCachedHeaderHash(header), state, chainparams, &pindex);
             ::ChainstateActive().CheckBlockIndex(chainparams.GetConsensus());
 
             if (!accepted) {
@@ -3793,7 +4259,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, Block
     CBlockIndex *pindexDummy = nullptr;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    bool accepted_header = m_blockman.AcceptBlockHeader(block, state, chainparams, &pindex);
+    bool accepted_header = m_blockman.AcceptBlockHeader(block, block.GetHash(), state, chainparams, &pindex);
     CheckBlockIndex(chainparams.GetConsensus());
 
     if (!accepted_header)
@@ -3869,6 +4335,7 @@ bool ChainstateManager::ProcessNewBlock(const CChainParams& chainparams, const s
 {
     AssertLockNotHeld(cs_main);
 
+    bool for_background{false};
     {
         CBlockIndex *pindex = nullptr;
         if (fNewBlock) *fNewBlock = false;
@@ -3889,9 +4356,12 @@ bool ChainstateManager::ProcessNewBlock(const CChainParams& chainparams, const s
             GetMainSignals().BlockChecked(*pblock, state);
             return error("%s: AcceptBlock FAILED (%s)", __func__, state.ToString());
         }
+        // Blocks below an unvalidated snapshot are connected by the background chainstate.
+        for_background = pindex && (pindex->nStatus & BLOCK_ASSUMED_VALID) && IsSnapshotActive() && !m_snapshot_validated;
     }
 
     NotifyHeaderTip();
+    if (for_background) NotifyBackgroundValidation();
 
     BlockValidationState state; // Only used to report errors, not invalidity - ignore it
     if (!::ChainstateActive().ActivateBestChain(state, chainparams, pblock))
@@ -3987,6 +4457,18 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 }
 
 /* Calculate the block/rev files to delete based on height specified by user with RPC command pruneblockchain */
+/**
+ * Lower the height up to which blocks may be pruned so that the blocks the
+ * background chainstate has yet to connect below an unvalidated UTXO snapshot
+ * are kept. They would otherwise have to be downloaded again.
+ */
+static unsigned int CapPruneHeightForSnapshot(const ChainstateManager& chainman, unsigned int prune_height) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (!chainman.IsSnapshotActive() || chainman.IsSnapshotValidated()) return prune_height;
+    const CBlockIndex* background_tip = chainman.ValidatedChainstate().m_chain.Tip();
+    return std::min<unsigned int>(prune_height, background_tip ? background_tip->nHeight : 0);
+}
+
 static void FindFilesToPruneManual(ChainstateManager& chainman, std::set<int>& setFilesToPrune, int nManualPruneHeight)
 {
     assert(fPruneMode && nManualPruneHeight > 0);
@@ -3997,6 +4479,7 @@ static void FindFilesToPruneManual(ChainstateManager& chainman, std::set<int>& s
 
     // last block to prune is the lesser of (user-specified height, MIN_BLOCKS_TO_KEEP from the tip)
     unsigned int nLastBlockWeCanPrune = std::min((unsigned)nManualPruneHeight, ::ChainActive().Tip()->nHeight - MIN_BLOCKS_TO_KEEP);
+    nLastBlockWeCanPrune = CapPruneHeightForSnapshot(chainman, nLastBlockWeCanPrune);
     int count=0;
     for (int fileNumber = 0; fileNumber < nLastBlockFile; fileNumber++) {
         if (vinfoBlockFile[fileNumber].nSize == 0 || vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
@@ -4028,7 +4511,8 @@ void PruneBlockFilesManual(int nManualPruneHeight)
  * Pruning functions are called from FlushStateToDisk when the global fCheckForPruning flag has been set.
  * Block and undo files are deleted in lock-step (when blk00003.dat is deleted, so is rev00003.dat.)
  * Pruning cannot take place until the longest chain is at least a certain length (100000 on mainnet, 1000 on testnet, 1000 on regtest).
- * Pruning will never delete a block within a defined distance (currently 288) from the active chain's tip.
+ * Pruning will never delete a block within a defined distance (currently 288) from the active chain's tip,
+ * nor one the background chainstate still has to connect below an unvalidated UTXO snapshot.
  * The block index is updated by unsetting HAVE_DATA and HAVE_UNDO for any blocks that were stored in the deleted files.
  * A db flag records the fact that at least some block files have been pruned.
  *
@@ -4044,7 +4528,7 @@ static void FindFilesToPrune(ChainstateManager& chainman, std::set<int>& setFile
         return;
     }
 
-    unsigned int nLastBlockWeCanPrune = ::ChainActive().Tip()->nHeight - MIN_BLOCKS_TO_KEEP;
+    const unsigned int nLastBlockWeCanPrune = CapPruneHeightForSnapshot(chainman, ::ChainActive().Tip()->nHeight - MIN_BLOCKS_TO_KEEP);
     uint64_t nCurrentUsage = CalculateCurrentUsage();
     // We don't check to prune until after we've allocated new space for files
     // So we should leave a buffer under our target to account for another allocation
@@ -4139,7 +4623,8 @@ bool BlockManager::LoadBlockIndex(
     CBlockTreeDB& blocktree,
     std::set<CBlockIndex*, CBlockIndexWorkComparator>& block_index_candidates)
 {
-    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
+    const bool fTrustStoredHash = gArgs.GetBoolArg("-trustblockindex", DEFAULT_TRUST_BLOCK_INDEX);
+    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }, fTrustStoredHash))
         return false;
 
     // Calculate nChainWork
@@ -4186,6 +4671,29 @@ bool BlockManager::LoadBlockIndex(
             pindexBestHeader = pindex;
     }
 
+    if (fTrustStoredHash && !vSortedByHeight.empty()) {
+        // The stored hashes were taken as-is; re-hash the most recent entries
+        // and a random sample of the older ones as a spot check.
+        const int nDepth = std::max(0, (int)gArgs.GetArg("-blockindexpowdepth", DEFAULT_BLOCK_INDEX_POW_DEPTH));
+        const int nSample = std::max(0, (int)gArgs.GetArg("-blockindexpowsample", DEFAULT_BLOCK_INDEX_POW_SAMPLE));
+        const int nMinHeight = vSortedByHeight.back().first - nDepth;
+        FastRandomContext rng;
+        int nChecked = 0;
+        for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight)
+        {
+            if (ShutdownRequested()) return false;
+            const CBlockIndex* pindex = item.second;
+            // Entries only referenced as a parent have no header data.
+            if ((pindex->nStatus & BLOCK_VALID_MASK) == BLOCK_VALID_UNKNOWN) continue;
+            if (item.first <= nMinHeight && (nSample == 0 || rng.randrange(nSample) != 0)) continue;
+            if (pindex->GetBlockHeader().GetHash() != pindex->GetBlockHash()) {
+                return error("%s: stored block hash mismatch: %s", __func__, pindex->ToString());
+            }
+            ++nChecked;
+        }
+        LogPrintf("Trusted stored block index hashes, re-hashed %d of %u entries\n", nChecked, vSortedByHeight.size());
+    }
+
     return true;
 }
 
@@ -4208,6 +4716,18 @@ bool static LoadBlockIndexDB(ChainstateManager& chainman, const CChainParams& ch
         return false;
     }
 
+    // The background chainstate of a snapshot only connects the blocks
+    // leading to the snapshot base, and has validated all but the assumed
+    // valid ones.
+    if (chainman.IsSnapshotActive()) {
+        const CBlockIndex* base = LookupBlockIndex(*chainman.SnapshotBlockhash());
+        for (CBlockIndex* pindex : ::ChainstateActive().setBlockIndexCandidates) {
+            if (base && !(pindex->nStatus & BLOCK_ASSUMED_VALID) && base->GetAncestor(pindex->nHeight) == pindex) {
+                chainman.ValidatedChainstate().setBlockIndexCandidates.insert(pindex);
+            }
+        }
+    }
+
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
     vinfoBlockFile.resize(nLastBlockFile + 1);
@@ -4326,6 +4846,11 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
         }
+        if (pindex->nStatus & BLOCK_ASSUMED_VALID) {
+            // Blocks below a UTXO snapshot base were never downloaded.
+            LogPrintf("VerifyDB(): block verification stopping at height %d (snapshot base)\n", pindex->nHeight);
+            break;
+        }
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
@@ -4682,7 +5207,7 @@ bool CChainState::LoadGenesisBlock(const CChainParams& chainparams)
         FlatFilePos blockPos = SaveBlockToDisk(block, 0, chainparams, nullptr);
         if (blockPos.IsNull())
             return error("%s: writing genesis block to disk failed", __func__);
-        CBlockIndex *pindex = m_blockman.AddToBlockIndex(block);
+        CBlockIndex *pindex = m_blockman.AddToBlockIndex(block, block.GetHash());
         ReceivedBlockTransactions(block, pindex, blockPos, chainparams.GetConsensus());
     } catch (const std::runtime_error& e) {
         return error("%s: failed to write genesis block: %s", __func__, e.what());
@@ -4696,6 +5221,211 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return ::ChainstateActive().LoadGenesisBlock(chainparams);
 }
 
+namespace {
+/** Most blocks the import pipeline reads ahead of the block being accepted */
+static const size_t IMPORT_MAX_BLOCKS_IN_FLIGHT = 1024;
+/** Most serialized bytes the import pipeline reads ahead of the block being accepted */
+static const size_t IMPORT_MAX_BYTES_IN_FLIGHT = 64 << 20;
+/** Upper bound on the number of import deserialization threads */
+static const int MAX_IMPORT_THREADS = 8;
+
+/**
+ * Reads blocks from an external block file in a pipeline: a reader thread
+ * locates blocks in the file and reads their bytes ahead, worker threads
+ * deserialize them, hash their headers and run the context-free checks,
+ * and Next() hands them out in file order.
+ */
+class BlockImporter
+{
+public:
+    struct Item {
+        uint64_t seq{0};
+        //! Position of the block in the file
+        unsigned int pos{0};
+        size_t size{0};
+        std::vector<unsigned char> raw;
+        //! The deserialized block, or null with error set
+        std::shared_ptr<CBlock> block;
+        std::string error;
+    };
+
+    BlockImporter(const CChainParams& chainparams, FILE* file) : m_chainparams(chainparams)
+    {
+        m_threads.emplace_back([this, file] {
+            util::ThreadRename("loadblk.read");
+            ReadThread(file);
+        });
+        const int workers = std::max(1, std::min(GetNumCores() - 1, MAX_IMPORT_THREADS));
+        for (int i = 0; i < workers; ++i) {
+            m_threads.emplace_back([this, i] {
+                util::ThreadRename(strprintf("loadblk.%i", i));
+                WorkerThread();
+            });
+        }
+    }
+
+    ~BlockImporter()
+    {
+        {
+            LOCK(m_mutex);
+            m_stop = true;
+        }
+        m_cv_read.notify_all();
+        m_cv_work.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    /** Wait for the next block in file order. Returns false once the file is exhausted. */
+    bool Next(Item& item)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        m_cv_ready.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+            return m_ready.count(m_next_seq) || (m_read_done && m_next_seq == m_read_seq);
+        });
+        auto it = m_ready.find(m_next_seq);
+        if (it == m_ready.end()) return false;
+        item = std::move(it->second);
+        m_ready.erase(it);
+        ++m_next_seq;
+        m_bytes_in_flight -= item.size;
+        m_cv_read.notify_one();
+        return true;
+    }
+
+    /** The error that stopped the reader early, if any. */
+    std::string ReadError()
+    {
+        LOCK(m_mutex);
+        return m_read_error;
+    }
+
+private:
+    const CChainParams& m_chainparams;
+    Mutex m_mutex;
+    //! Signalled when there is room to read ahead
+    std::condition_variable m_cv_read;
+    //! Signalled when there are blocks to deserialize
+    std::condition_variable m_cv_work;
+    //! Signalled when a deserialized block is ready
+    std::condition_variable m_cv_ready;
+    std::deque<Item> m_raw GUARDED_BY(m_mutex);
+    std::map<uint64_t, Item> m_ready GUARDED_BY(m_mutex);
+    uint64_t m_read_seq GUARDED_BY(m_mutex){0};
+    uint64_t m_next_seq GUARDED_BY(m_mutex){0};
+    size_t m_bytes_in_flight GUARDED_BY(m_mutex){0};
+    bool m_read_done GUARDED_BY(m_mutex){false};
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::string m_read_error GUARDED_BY(m_mutex);
+    std::vector<std::thread> m_threads;
+
+    /** Queue a block for deserialization, waiting for room. Returns false when stopped. */
+    bool Push(Item&& item)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        m_cv_read.wait(lock, [this, &item]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+            const uint64_t in_flight = m_read_seq - m_next_seq;
+            return m_stop || in_flight == 0 || (in_flight < IMPORT_MAX_BLOCKS_IN_FLIGHT && m_bytes_in_flight + item.size <= IMPORT_MAX_BYTES_IN_FLIGHT);
+        });
+        if (m_stop) return false;
+        item.seq = m_read_seq++;
+        m_bytes_in_flight += item.size;
+        m_raw.push_back(std::move(item));
+        m_cv_work.notify_one();
+        return true;
+    }
+
+    void ReadThread(FILE* file)
+    {
+        try {
+            // This takes over file and calls fclose() on it in the CBufferedFile destructor
+            CBufferedFile blkdat(file, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
+            uint64_t nRewind = blkdat.GetPos();
+            while (!blkdat.eof()) {
+                if (ShutdownRequested()) break;
+
+                blkdat.SetPos(nRewind);
+                nRewind++; // start one byte further next time, in case of failure
+                blkdat.SetLimit(); // remove former limit
+                unsigned int nSize = 0;
+                try {
+                    // locate a header
+                    unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+                    blkdat.FindByte(m_chainparams.MessageStart()[0]);
+                    nRewind = blkdat.GetPos()+1;
+                    blkdat >> buf;
+                    if (memcmp(buf, m_chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+                        continue;
+                    // read size
+                    blkdat >> nSize;
+                    if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                        continue;
+                } catch (const std::exception&) {
+                    // no valid block header found; don't complain
+                    break;
+                }
+                Item item;
+                try {
+                    // read block
+                    item.pos = blkdat.GetPos();
+                    item.size = nSize;
+                    blkdat.SetLimit(item.pos + nSize);
+                    item.raw.resize(nSize);
+                    blkdat.read((char*)item.raw.data(), nSize);
+                    nRewind = blkdat.GetPos();
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+                    continue;
+                }
+                if (!Push(std::move(item))) break;
+            }
+        } catch (const std::runtime_error& e) {
+            LOCK(m_mutex);
+            m_read_error = e.what();
+        }
+        {
+            LOCK(m_mutex);
+            m_read_done = true;
+        }
+        m_cv_work.notify_all();
+        m_cv_ready.notify_all();
+    }
+
+    void WorkerThread()
+    {
+        while (true) {
+            Item item;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                m_cv_work.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || m_read_done || !m_raw.empty(); });
+                if (m_stop || m_raw.empty()) return;
+                item = std::move(m_raw.front());
+                m_raw.pop_front();
+            }
+            try {
+                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+                VectorReader(SER_DISK, CLIENT_VERSION, item.raw, 0, *pblock);
+                pblock->GetHash();
+                // Caches a successful result in the block; AcceptBlock repeats
+                // a failed check and reports it.
+                BlockValidationState state;
+                CheckBlock(*pblock, state, m_chainparams.GetConsensus());
+                item.block = std::move(pblock);
+            } catch (const std::exception& e) {
+                item.error = e.what();
+            }
+            item.raw = std::vector<unsigned char>();
+            {
+                LOCK(m_mutex);
+                m_ready.emplace(item.seq, std::move(item));
+            }
+            m_cv_ready.notify_one();
+        }
+    }
+};
+} // namespace
+
 void LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFilePos* dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
@@ -4703,115 +5433,92 @@ void LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFi
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
-    try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            if (ShutdownRequested()) return;
-
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> buf;
-                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
-            }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
+    BlockImporter importer(chainparams, fileIn);
+    BlockImporter::Item item;
+    while (importer.Next(item)) {
+        if (ShutdownRequested()) return;
 
-                uint256 hash = block.GetHash();
-                {
-                    LOCK(cs_main);
-                    // detect out of order blocks, and store them for later
-                    if (hash != chainparams.GetConsensus().hashGenesisBlock && !LookupBlockIndex(block.hashPrevBlock)) {
-                        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                                block.hashPrevBlock.ToString());
-                        if (dbp)
-                            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                        continue;
-                    }
+        if (!item.block) {
+            LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, item.error);
+            continue;
+        }
+        try {
+            if (dbp)
+                dbp->nPos = item.pos;
+            std::shared_ptr<CBlock> pblock = std::move(item.block);
+            CBlock& block = *pblock;
 
-                    // process in case the block isn't known yet
-                    CBlockIndex* pindex = LookupBlockIndex(hash);
-                    if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                      BlockValidationState state;
-                      if (::ChainstateActive().AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
-                          nLoaded++;
-                      }
-                      if (state.IsError()) {
-                          break;
-                      }
-                    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
-                      LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
-                    }
+            uint256 hash = block.GetHash();
+            {
+                LOCK(cs_main);
+                // detect out of order blocks, and store them for later
+                if (hash != chainparams.GetConsensus().hashGenesisBlock && !LookupBlockIndex(block.hashPrevBlock)) {
+                    LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                            block.hashPrevBlock.ToString());
+                    if (dbp)
+                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+                    continue;
                 }
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    BlockValidationState state;
-                    if (!ActivateBestChain(state, chainparams, nullptr)) {
-                        break;
-                    }
+                // process in case the block isn't known yet
+                CBlockIndex* pindex = LookupBlockIndex(hash);
+                if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
+                  BlockValidationState state;
+                  if (::ChainstateActive().AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
+                      nLoaded++;
+                  }
+                  if (state.IsError()) {
+                      break;
+                  }
+                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
+                  LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
+                }
+            }
+
+            // Activate the genesis block so normal node progress can continue
+            if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+                BlockValidationState state;
+                if (!ActivateBestChain(state, chainparams, nullptr)) {
+                    break;
                 }
+            }
 
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, FlatFilePos>::iterator, std::multimap<uint256, FlatFilePos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, FlatFilePos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
+            NotifyHeaderTip();
+
+            // Recursively process earlier encountered successors of this block
+            std::deque<uint256> queue;
+            queue.push_back(hash);
+            while (!queue.empty()) {
+                uint256 head = queue.front();
+                queue.pop_front();
+                std::pair<std::multimap<uint256, FlatFilePos>::iterator, std::multimap<uint256, FlatFilePos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+                while (range.first != range.second) {
+                    std::multimap<uint256, FlatFilePos>::iterator it = range.first;
+                    std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+                    if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
+                    {
+                        LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                                head.ToString());
+                        LOCK(cs_main);
+                        BlockValidationState dummy;
+                        if (::ChainstateActive().AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
                         {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            BlockValidationState dummy;
-                            if (::ChainstateActive().AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
+                            nLoaded++;
+                            queue.push_back(pblockrecursive->GetHash());
                         }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
                     }
+                    range.first++;
+                    mapBlocksUnknownParent.erase(it);
+                    NotifyHeaderTip();
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
         }
-    } catch (const std::runtime_error& e) {
-        AbortNode(std::string("System error: ") + e.what());
+    }
+    const std::string error = importer.ReadError();
+    if (!error.empty()) {
+        AbortNode(std::string("System error: ") + error);
     }
     LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
 }
@@ -4822,6 +5529,12 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
         return;
     }
 
+    // A chainstate left behind by a UTXO snapshot does not track candidates
+    // for the blocks below the snapshot base.
+    if (g_chainman.IsBackgroundIBD(this)) {
+        return;
+    }
+
     LOCK(cs_main);
 
     // During a reindex, we read the genesis block and call CheckBlockIndex before ActivateBestChain,
@@ -4860,12 +5573,14 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
     while (pindex != nullptr) {
         nNodes++;
         if (pindexFirstInvalid == nullptr && pindex->nStatus & BLOCK_FAILED_VALID) pindexFirstInvalid = pindex;
-        if (pindexFirstMissing == nullptr && !(pindex->nStatus & BLOCK_HAVE_DATA)) pindexFirstMissing = pindex;
+        // Blocks below a UTXO snapshot base count as fully valid and present.
+        const bool assumed_valid = pindex->nStatus & BLOCK_ASSUMED_VALID;
+        if (pindexFirstMissing == nullptr && !(pindex->nStatus & BLOCK_HAVE_DATA) && !assumed_valid) pindexFirstMissing = pindex;
         if (pindexFirstNeverProcessed == nullptr && pindex->nTx == 0) pindexFirstNeverProcessed = pindex;
         if (pindex->pprev != nullptr && pindexFirstNotTreeValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TREE) pindexFirstNotTreeValid = pindex;
-        if (pindex->pprev != nullptr && pindexFirstNotTransactionsValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TRANSACTIONS) pindexFirstNotTransactionsValid = pindex;
-        if (pindex->pprev != nullptr && pindexFirstNotChainValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN) pindexFirstNotChainValid = pindex;
-        if (pindex->pprev != nullptr && pindexFirstNotScriptsValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS) pindexFirstNotScriptsValid = pindex;
+        if (pindex->pprev != nullptr && pindexFirstNotTransactionsValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TRANSACTIONS && !assumed_valid) pindexFirstNotTransactionsValid = pindex;
+        if (pindex->pprev != nullptr && pindexFirstNotChainValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN && !assumed_valid) pindexFirstNotChainValid = pindex;
+        if (pindex->pprev != nullptr && pindexFirstNotScriptsValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS && !assumed_valid) pindexFirstNotScriptsValid = pindex;
 
         // Begin: actual consistency checks.
         if (pindex->pprev == nullptr) {
@@ -4878,14 +5593,14 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
         // HAVE_DATA is only equivalent to nTx > 0 (or VALID_TRANSACTIONS) if no pruning has occurred.
         if (!fHavePruned) {
             // If we've never pruned, then HAVE_DATA should be equivalent to nTx > 0
-            assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
+            if (!assumed_valid) assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
             assert(pindexFirstMissing == pindexFirstNeverProcessed);
         } else {
             // If we have pruned, then we can only say that HAVE_DATA implies nTx > 0
             if (pindex->nStatus & BLOCK_HAVE_DATA) assert(pindex->nTx > 0);
         }
         if (pindex->nStatus & BLOCK_HAVE_UNDO) assert(pindex->nStatus & BLOCK_HAVE_DATA);
-        assert(((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TRANSACTIONS) == (pindex->nTx > 0)); // This is pruning-independent.
+        if (!assumed_valid) assert(((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TRANSACTIONS) == (pindex->nTx > 0)); // This is pruning-independent.
         // All parents having had data (at some point) is equivalent to all parents being VALID_TRANSACTIONS, which is equivalent to HaveTxsDownloaded().
         assert((pindexFirstNeverProcessed == nullptr) == pindex->HaveTxsDownloaded());
         assert((pindexFirstNotTransactionsValid == nullptr) == pindex->HaveTxsDownloaded());
@@ -5040,6 +5755,68 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
 
 static const uint64_t MEMPOOL_DUMP_VERSION = 1;
 
+/** Number of transactions read from mempool.dat whose scripts are verified together before they are admitted */
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 1000;
+
+/**
+ * Verify the input scripts of a batch of transactions read from mempool.dat
+ * on the mempool script check threads, so that the signatures end up in the
+ * signature cache before the transactions are admitted one by one under
+ * cs_main. Admission still validates each transaction in full; it just finds
+ * most of its signatures already checked. Transactions whose inputs cannot be
+ * found are left to admission to reject, and a failing script only stops the
+ * remaining checks of the batch from warming the cache.
+ */
+static void PreloadMempoolScripts(const CTxMemPool& pool, const std::vector<CTransactionRef>& txs)
+{
+    if (!g_parallel_script_checks) return;
+
+    std::vector<PrecomputedTransactionData> txdata(txs.size());
+    std::vector<CScriptCheck> checks;
+    {
+        LOCK(cs_main);
+        // Parents earlier in the batch are not in the mempool yet
+        std::map<uint256, const CTransaction*> batch_txs;
+        const CCoinsViewCache& coins_tip = ::ChainstateActive().CoinsTip();
+        CCoinsViewDB& coins_db = ::ChainstateActive().CoinsDB();
+        for (size_t i = 0; i < txs.size(); ++i) {
+            const CTransaction& tx = *txs[i];
+            batch_txs.emplace(tx.GetHash(), &tx);
+            std::vector<CTxOut> spent_outputs;
+            for (const CTxIn& txin : tx.vin) {
+                const COutPoint& prevout = txin.prevout;
+                auto parent = batch_txs.find(prevout.hash);
+                CTransactionRef pool_parent;
+                if (parent != batch_txs.end() && prevout.n < parent->second->vout.size()) {
+                    spent_outputs.push_back(parent->second->vout[prevout.n]);
+                } else if ((pool_parent = pool.get(prevout.hash)) && prevout.n < pool_parent->vout.size()) {
+                    spent_outputs.push_back(pool_parent->vout[prevout.n]);
+                } else {
+                    // Look the coin up without pulling it into the coins
+                    // cache, which admission would not clean up if the
+                    // transaction turns out to be rejected.
+                    Coin coin;
+                    if (coins_tip.HaveCoinInCache(prevout)) {
+                        coin = coins_tip.AccessCoin(prevout);
+                    } else if (!coins_db.GetCoin(prevout, coin)) {
+                        break;
+                    }
+                    spent_outputs.push_back(coin.out);
+                }
+            }
+            if (spent_outputs.size() != tx.vin.size()) continue;
+            txdata[i].Init(tx);
+            for (unsigned int n = 0; n < tx.vin.size(); ++n) {
+                checks.emplace_back(spent_outputs[n], tx, n, STANDARD_SCRIPT_VERIFY_FLAGS, /* cacheIn */ true, &txdata[i]);
+            }
+        }
+    }
+
+    CCheckQueueControl<CScriptCheck> control(&mempoolscriptcheckqueue);
+    control.Add(checks);
+    control.Wait();
+}
+
 bool LoadMempool(CTxMemPool& pool)
 {
     const CChainParams& chainparams = Params();
@@ -5057,6 +5834,7 @@ bool LoadMempool(CTxMemPool& pool)
     int64_t already_there = 0;
     int64_t unbroadcast = 0;
     int64_t nNow = GetTime();
+    int64_t start = GetTimeMicros();
 
     try {
         uint64_t version;
@@ -5066,24 +5844,45 @@ bool LoadMempool(CTxMemPool& pool)
         }
         uint64_t num;
         file >> num;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
-            if (amountdelta) {
-                pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
+        std::vector<CTransactionRef> batch;
+        std::vector<int64_t> batch_times;
+        while (num) {
+            // Read the next batch of unexpired transactions, verify their
+            // scripts in parallel, then admit them in the order of the file,
+            // which has parents before their children.
+            batch.clear();
+            batch_times.clear();
+            while (num && batch.size() < MEMPOOL_LOAD_BATCH_SIZE) {
+                --num;
+                CTransactionRef tx;
+                int64_t nTime;
+                int64_t nFeeDelta;
+                file >> tx;
+                file >> nTime;
+                file >> nFeeDelta;
+
+                CAmount amountdelta = nFeeDelta;
+                if (amountdelta) {
+                    pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
+                }
+                if (nTime + nExpiryTimeout > nNow) {
+                    batch.push_back(std::move(tx));
+                    batch_times.push_back(nTime);
+                } else {
+                    ++expired;
+                }
             }
-            TxValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, nTime,
-                                           nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */,
-                                           false /* test_accept */);
+            PreloadMempoolScripts(pool, batch);
+
+            for (size_t i = 0; i < batch.size(); ++i) {
+                const CTransactionRef& tx = batch[i];
+                TxValidationState state;
+                {
+                    LOCK(cs_main);
+                    AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, batch_times[i],
+                                               nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */,
+                                               false /* test_accept */);
+                }
                 if (state.IsValid()) {
                     ++count;
                 } else {
@@ -5097,11 +5896,9 @@ bool LoadMempool(CTxMemPool& pool)
                         ++failed;
                     }
                 }
-            } else {
-                ++expired;
+                if (ShutdownRequested())
+                    return false;
             }
-            if (ShutdownRequested())
-                return false;
         }
         std::map<uint256, CAmount> mapDeltas;
         file >> mapDeltas;
@@ -5129,7 +5926,7 @@ bool LoadMempool(CTxMemPool& pool)
         return false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there, %i waiting for initial broadcast\n", count, failed, expired, already_there, unbroadcast);
+    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there, %i waiting for initial broadcast (%.2fs)\n", count, failed, expired, already_there, unbroadcast, (GetTimeMicros() - start) * MICRO);
     return true;
 }
 
@@ -5288,6 +6085,282 @@ CChainState& ChainstateManager::InitializeChainstate(const uint256& snapshot_blo
     return *to_modify;
 }
 
+const AssumeutxoData* ExpectedAssumeutxo(const int height, const CChainParams& chainparams)
+{
+    const MapAssumeutxo& valid_assumeutxos_map = chainparams.Assumeutxo();
+    const auto assumeutxo_found = valid_assumeutxos_map.find(height);
+
+    if (assumeutxo_found != valid_assumeutxos_map.end()) {
+        return &assumeutxo_found->second;
+    }
+    return nullptr;
+}
+
+/** File in a snapshot chainstate directory that marks the snapshot as completely loaded */
+static const char* const SNAPSHOT_BLOCKHASH_FILENAME = "base_blockhash";
+
+static fs::path SnapshotChainstateDir(const uint256& base_blockhash)
+{
+    return GetDataDir() / ("chainstate_" + base_blockhash.ToString());
+}
+
+bool ChainstateManager::ActivateSnapshot(CAutoFile& coins_file, const SnapshotMetadata& metadata, bool in_memory)
+{
+    const uint256& base_blockhash = metadata.m_base_blockhash;
+    size_t coinsdb_cache_size;
+
+    {
+        LOCK(::cs_main);
+        if (m_snapshot_chainstate) {
+            LogPrintf("[snapshot] can't activate a snapshot-based chainstate more than once\n");
+            return false;
+        }
+        if (fPruneMode) {
+            // The blocks below the snapshot could be pruned before they are
+            // validated in the background.
+            LogPrintf("[snapshot] can't activate a snapshot with pruning enabled\n");
+            return false;
+        }
+        const CBlockIndex* base = LookupBlockIndex(base_blockhash);
+        if (!base) {
+            LogPrintf("[snapshot] did not find snapshot start blockheader %s\n", base_blockhash.ToString());
+            return false;
+        }
+        if (ActiveTip() && ActiveTip()->nChainWork >= base->nChainWork) {
+            LogPrintf("[snapshot] the active chain is already at or past snapshot base %s\n", base_blockhash.ToString());
+            return false;
+        }
+        if (::mempool.size() > 0) {
+            LogPrintf("[snapshot] can't activate a snapshot while the mempool is not empty\n");
+            return false;
+        }
+
+        // The IBD chainstate stops connecting blocks once the snapshot is
+        // active; write out its cache to make room for the snapshot's coins.
+        m_active_chainstate->ForceFlushStateToDisk();
+        m_active_chainstate->CoinsTip().EvictToSize(0);
+        coinsdb_cache_size = m_active_chainstate->m_coinsdb_cache_size_bytes;
+    }
+
+    std::unique_ptr<CChainState> snapshot_chainstate = MakeUnique<CChainState>(m_blockman, base_blockhash);
+    {
+        LOCK(::cs_main);
+        // Wipe whatever an interrupted earlier attempt left behind.
+        snapshot_chainstate->InitCoinsDB(coinsdb_cache_size, in_memory, /* should_wipe */ true);
+        snapshot_chainstate->InitCoinsCache();
+    }
+
+    if (!PopulateAndValidateSnapshot(*snapshot_chainstate, coins_file, metadata)) {
+        snapshot_chainstate->ResetCoinsViews();
+        if (!in_memory) {
+            fs::remove_all(SnapshotChainstateDir(base_blockhash));
+        }
+        return false;
+    }
+
+    LOCK(::cs_main);
+    if (m_snapshot_chainstate) {
+        LogPrintf("[snapshot] another snapshot was activated while loading %s\n", base_blockhash.ToString());
+        return false;
+    }
+
+    // Persist the snapshot's coins and the faked block index entries before
+    // marking the snapshot as complete.
+    BlockValidationState state;
+    if (!snapshot_chainstate->FlushStateToDisk(Params(), state, FlushStateMode::ALWAYS)) {
+        return false;
+    }
+    if (!in_memory) {
+        CAutoFile file(fsbridge::fopen(SnapshotChainstateDir(base_blockhash) / SNAPSHOT_BLOCKHASH_FILENAME, "wb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            return AbortNode("Failed to write snapshot base blockhash");
+        }
+        file << base_blockhash;
+        if (fflush(file.Get()) != 0 || !FileCommit(file.Get())) {
+            return AbortNode("Failed to write snapshot base blockhash");
+        }
+    }
+
+    m_snapshot_chainstate.swap(snapshot_chainstate);
+    m_active_chainstate = m_snapshot_chainstate.get();
+    LogPrintf("[snapshot] successfully activated snapshot %s\n", base_blockhash.ToString());
+    LogPrintf("Switching active chainstate to %s\n", m_active_chainstate->ToString());
+
+    MaybeRebalanceCaches();
+    NotifyBackgroundValidation();
+    return true;
+}
+
+bool ChainstateManager::PopulateAndValidateSnapshot(CChainState& snapshot_chainstate, CAutoFile& coins_file, const SnapshotMetadata& metadata)
+{
+    // Nothing else knows about snapshot_chainstate yet, so its coins can be
+    // used without holding cs_main.
+    CCoinsViewCache& coins_cache = *WITH_LOCK(::cs_main, return &snapshot_chainstate.CoinsTip());
+    CCoinsViewDB& coins_db = *WITH_LOCK(::cs_main, return &snapshot_chainstate.CoinsDB());
+
+    const uint256& base_blockhash = metadata.m_base_blockhash;
+    CBlockIndex* snapshot_start_block = WITH_LOCK(::cs_main, return LookupBlockIndex(base_blockhash));
+    if (!snapshot_start_block) {
+        LogPrintf("[snapshot] did not find snapshot start blockheader %s\n", base_blockhash.ToString());
+        return false;
+    }
+
+    const int base_height = snapshot_start_block->nHeight;
+    const AssumeutxoData* au_data = ExpectedAssumeutxo(base_height, Params());
+    if (!au_data) {
+        LogPrintf("[snapshot] assumeutxo height in snapshot metadata not recognized (%d) - refusing to load snapshot\n", base_height);
+        return false;
+    }
+
+    COutPoint outpoint;
+    Coin coin;
+    const uint64_t coins_count = metadata.m_coins_count;
+    uint64_t coins_left = coins_count;
+
+    LogPrintf("[snapshot] loading coins from snapshot %s\n", base_blockhash.ToString());
+    int64_t nStart = GetTimeMillis();
+
+    while (coins_left > 0) {
+        try {
+            coins_file >> outpoint;
+            coins_file >> coin;
+        } catch (const std::ios_base::failure&) {
+            LogPrintf("[snapshot] bad snapshot format or truncated snapshot after deserializing %d coins\n", coins_count - coins_left);
+            return false;
+        }
+        if (coin.nHeight > (uint32_t)base_height || outpoint.n == std::numeric_limits<uint32_t>::max()) {
+            LogPrintf("[snapshot] bad snapshot data after deserializing %d coins\n", coins_count - coins_left);
+            return false;
+        }
+
+        coins_cache.EmplaceCoinInternalDANGER(std::move(outpoint), std::move(coin));
+        --coins_left;
+        const uint64_t coins_processed = coins_count - coins_left;
+
+        if (coins_processed % 1000000 == 0) {
+            LogPrintf("[snapshot] %d coins loaded (%.2f%%, %.2f MB)\n", coins_processed,
+                coins_processed * 100.0 / coins_count, coins_cache.DynamicMemoryUsage() / (1000.0 * 1000.0));
+        }
+
+        // Write out the cache when it grows too large. At an average of
+        // about 40 bytes per coin, checking every 120000 coins keeps the
+        // overshoot under 5MB.
+        if (coins_processed % 120000 == 0) {
+            if (ShutdownRequested()) {
+                return false;
+            }
+            if (WITH_LOCK(::cs_main, return snapshot_chainstate.GetCoinsCacheSizeState(::mempool)) >= CoinsCacheSizeState::CRITICAL) {
+                // The best block is not known to be reached until all coins are
+                // loaded; any hash other than the base's will do for now.
+                coins_cache.SetBestBlock(GetRandHash());
+                coins_cache.Flush();
+            }
+        }
+    }
+
+    coins_cache.SetBestBlock(base_blockhash);
+
+    bool out_of_coins = false;
+    try {
+        coins_file >> outpoint;
+    } catch (const std::ios_base::failure&) {
+        // We expect an exception since we should be out of coins.
+        out_of_coins = true;
+    }
+    if (!out_of_coins) {
+        LogPrintf("[snapshot] bad snapshot - coins left over after deserializing %d coins\n", coins_count);
+        return false;
+    }
+
+    // Keep the loaded coins cached for the blocks that follow the snapshot.
+    if (!coins_cache.Sync()) {
+        LogPrintf("[snapshot] failed to write coins to disk\n");
+        return false;
+    }
+    LogPrintf("[snapshot] loaded %d coins (%.2f MB) from snapshot %s in %dms\n", coins_count,
+        coins_cache.DynamicMemoryUsage() / (1000.0 * 1000.0), base_blockhash.ToString(), GetTimeMillis() - nStart);
+
+    CCoinsStats stats;
+    if (!GetUTXOStats(&coins_db, stats, [] {})) {
+        LogPrintf("[snapshot] failed to generate coins stats\n");
+        return false;
+    }
+    if (stats.hashSerialized != au_data->hash_serialized) {
+        LogPrintf("[snapshot] bad snapshot content hash: expected %s, got %s\n",
+            au_data->hash_serialized.ToString(), stats.hashSerialized.ToString());
+        return false;
+    }
+
+    LOCK(::cs_main);
+    snapshot_chainstate.m_chain.SetTip(snapshot_start_block);
+
+    // The coins were loaded without going through ConnectBlock(), so leave the
+    // rolling statistics to be recomputed from the database when requested
+    // rather than spending the time on every snapshot load.
+    snapshot_chainstate.m_rolling_stats = nullopt;
+
+    // Fake the block index state the snapshot stands in for, so that the
+    // blocks above the base can be connected and sync progress is reported:
+    // the entries below the base count as holding transactions and are marked
+    // as assumed valid until they are validated in the background. Set the
+    // witness flag so RewindBlockIndex() keeps them on startup. The genesis
+    // block is never connected, so it is skipped.
+    const Consensus::Params& consensus = Params().GetConsensus();
+    for (int i = 1; i <= base_height; ++i) {
+        CBlockIndex* index = snapshot_chainstate.m_chain[i];
+        if (!index->nTx) {
+            index->nTx = 1;
+        }
+        if (!index->IsValid(BLOCK_VALID_SCRIPTS)) {
+            index->nStatus |= BLOCK_ASSUMED_VALID;
+        }
+        if (index->pprev && IsWitnessEnabled(index->pprev, consensus)) {
+            index->nStatus |= BLOCK_OPT_WITNESS;
+        }
+        if (index == snapshot_start_block && (index->nStatus & BLOCK_ASSUMED_VALID)) {
+            // Carry the real transaction count of the chain into the base.
+            index->nTx = std::max<int64_t>(1, (int64_t)au_data->nChainTx - index->pprev->nChainTx);
+        }
+        index->nChainTx = index->pprev->nChainTx + index->nTx;
+        setDirtyBlockIndex.insert(index);
+    }
+    snapshot_chainstate.setBlockIndexCandidates.insert(snapshot_start_block);
+
+    LogPrintf("[snapshot] validated snapshot (%.2f MB)\n", coins_cache.DynamicMemoryUsage() / (1000.0 * 1000.0));
+    return true;
+}
+
+bool ChainstateManager::DetectSnapshotChainstate(bool wipe)
+{
+    std::vector<fs::path> dirs;
+    for (fs::directory_iterator it(GetDataDir()); it != fs::directory_iterator(); ++it) {
+        if (fs::is_directory(it->path()) && it->path().filename().string().compare(0, 11, "chainstate_") == 0) {
+            dirs.push_back(it->path());
+        }
+    }
+
+    bool found = false;
+    for (const fs::path& dir : dirs) {
+        uint256 base_blockhash;
+        CAutoFile file(fsbridge::fopen(dir / SNAPSHOT_BLOCKHASH_FILENAME, "rb"), SER_DISK, CLIENT_VERSION);
+        try {
+            if (!file.IsNull()) file >> base_blockhash;
+        } catch (const std::exception&) {
+            base_blockhash.SetNull();
+        }
+        file.fclose();
+
+        if (wipe || found || base_blockhash.IsNull() || dir != SnapshotChainstateDir(base_blockhash)) {
+            LogPrintf("[snapshot] removing %s snapshot chainstate %s\n", base_blockhash.IsNull() ? "incomplete" : "unused", dir.string());
+            fs::remove_all(dir);
+            continue;
+        }
+        InitializeChainstate(base_blockhash);
+        found = true;
+    }
+    return found;
+}
+
 CChain& ChainstateManager::ActiveChain() const
 {
     assert(m_active_chainstate);
@@ -5313,6 +6386,210 @@ bool ChainstateManager::IsBackgroundIBD(CChainState* chainstate) const
     return (m_snapshot_chainstate && chainstate == m_ibd_chainstate.get());
 }
 
+void ChainstateManager::MaybeRebalanceCaches()
+{
+    if (!m_snapshot_chainstate || !m_ibd_chainstate) return;
+
+    const size_t background_size = m_snapshot_validated ? 0 : nCoinCacheUsage / 100 * m_background_cache_percent;
+    m_ibd_chainstate->m_coinstip_cache_size_bytes = background_size;
+    m_snapshot_chainstate->m_coinstip_cache_size_bytes = nCoinCacheUsage - background_size;
+    LogPrintf("[snapshot] using %.1f MiB of the coins cache for background validation\n", background_size * (1.0 / 1024 / 1024));
+
+    for (CChainState* chainstate : {m_ibd_chainstate.get(), m_snapshot_chainstate.get()}) {
+        if (chainstate->CanFlushToDisk() && chainstate->CoinsTip().DynamicMemoryUsage() > chainstate->m_coinstip_cache_size_bytes) {
+            chainstate->ForceFlushStateToDisk();
+            chainstate->CoinsTip().EvictToSize(chainstate->m_coinstip_cache_size_bytes / 100 * COINS_CACHE_RETAIN_PERCENT);
+        }
+    }
+}
+
+void ChainstateManager::StartBackgroundValidation()
+{
+    assert(!m_background_thread.joinable());
+    m_background_thread = std::thread(&TraceThread<std::function<void()>>, "bgvalid", [this] { ThreadBackgroundValidation(); });
+}
+
+void ChainstateManager::StopBackgroundValidation()
+{
+    {
+        LOCK(m_background_mutex);
+        m_background_interrupt = true;
+    }
+    m_background_cv.notify_all();
+    if (m_background_thread.joinable()) m_background_thread.join();
+    LOCK(m_background_mutex);
+    m_background_interrupt = false;
+}
+
+void ChainstateManager::NotifyBackgroundValidation()
+{
+    {
+        LOCK(m_background_mutex);
+        m_background_pending = true;
+    }
+    m_background_cv.notify_one();
+}
+
+void ChainstateManager::ThreadBackgroundValidation()
+{
+    // Validating the historic chain must not slow down the tip.
+    ScheduleBatchPriority();
+    const CChainParams& chainparams = Params();
+    // Pick up a snapshot loaded in an earlier run.
+    NotifyBackgroundValidation();
+    while (true) {
+        {
+            WAIT_LOCK(m_background_mutex, lock);
+            m_background_cv.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_background_mutex) {
+                return m_background_interrupt || m_background_pending;
+            });
+            if (m_background_interrupt) return;
+            m_background_pending = false;
+        }
+        while (!ShutdownRequested() && !WITH_LOCK(m_background_mutex, return m_background_interrupt) &&
+               ConnectBackgroundBlocks(chainparams)) {}
+    }
+}
+
+bool ChainstateManager::ConnectBackgroundBlocks(const CChainParams& chainparams)
+{
+    //! Blocks made candidates for the background chainstate at a time
+    static constexpr int MAX_BACKGROUND_BLOCKS_PER_ROUND = 1024;
+
+    CChainState* chainstate;
+    CBlockIndex* base;
+    bool at_base;
+    {
+        LOCK(::cs_main);
+        if (!m_snapshot_chainstate || !m_ibd_chainstate || m_snapshot_validated) return false;
+        chainstate = m_ibd_chainstate.get();
+        base = LookupBlockIndex(m_snapshot_chainstate->m_from_snapshot_blockhash);
+        assert(base);
+        at_base = chainstate->m_chain.Tip() == base;
+    }
+    if (at_base) {
+        CompleteSnapshotValidation(base);
+        return false;
+    }
+    {
+        LOCK(::cs_main);
+        // Only the blocks leading to the snapshot base are of interest, and
+        // they are connected in order as their data arrives.
+        auto& candidates = chainstate->setBlockIndexCandidates;
+        for (auto it = candidates.begin(); it != candidates.end();) {
+            if (base->GetAncestor((*it)->nHeight) != *it) {
+                it = candidates.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        const CBlockIndex* fork = chainstate->m_chain.FindFork(base);
+        const int end_height = std::min(base->nHeight, fork->nHeight + MAX_BACKGROUND_BLOCKS_PER_ROUND);
+        CBlockIndex* target = nullptr;
+        for (int height = fork->nHeight + 1; height <= end_height; ++height) {
+            CBlockIndex* pindex = base->GetAncestor(height);
+            if (pindex->nStatus & BLOCK_FAILED_MASK) {
+                // Nothing can be done about an invalid chain below the
+                // snapshot, as the snapshot's coins build on it.
+                AbortNode(strprintf("Block %s below the UTXO snapshot is invalid", pindex->GetBlockHash().ToString()),
+                    _("The blocks below the UTXO snapshot are invalid. Restart with -reindex-chainstate to discard the snapshot."));
+                return false;
+            }
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA)) break;
+            target = pindex;
+        }
+        if (!target) return false;
+        candidates.insert(target);
+    }
+
+    const CBlockIndex* old_tip = WITH_LOCK(::cs_main, return chainstate->m_chain.Tip());
+    BlockValidationState state;
+    if (!chainstate->ActivateBestChain(state, chainparams, nullptr)) {
+        LogPrintf("[background validation] failed to connect blocks (%s)\n", state.ToString());
+        return false;
+    }
+
+    const CBlockIndex* new_tip = WITH_LOCK(::cs_main, return chainstate->m_chain.Tip());
+    if (new_tip == base) {
+        CompleteSnapshotValidation(base);
+        return false;
+    }
+    return new_tip != old_tip;
+}
+
+bool ChainstateManager::CompleteSnapshotValidation(const CBlockIndex* base)
+{
+    CChainState& chainstate = *m_ibd_chainstate;
+    CCoinsView* coins_db;
+    {
+        LOCK(::cs_main);
+        if (m_snapshot_validated) return true;
+        chainstate.ForceFlushStateToDisk();
+        coins_db = &chainstate.CoinsDB();
+    }
+
+    // Nothing connects to the background chainstate past the base, so its
+    // coins can be hashed from a database snapshot without holding cs_main,
+    // as gettxoutsetinfo does.
+    CCoinsStats stats;
+    try {
+        const auto interruption_point = [this] {
+            if (ShutdownRequested() || WITH_LOCK(m_background_mutex, return m_background_interrupt)) {
+                throw std::runtime_error("interrupted");
+            }
+        };
+        if (!GetUTXOStats(coins_db, stats, interruption_point)) {
+            LogPrintf("[snapshot] failed to hash the UTXO set of the background chainstate\n");
+            return false;
+        }
+    } catch (const std::runtime_error& e) {
+        LogPrintf("[snapshot] stopped hashing the UTXO set of the background chainstate: %s\n", e.what());
+        return false;
+    }
+    const AssumeutxoData* au_data = ExpectedAssumeutxo(base->nHeight, Params());
+    if (!au_data || stats.hashBlock != base->GetBlockHash() || stats.hashSerialized != au_data->hash_serialized) {
+        return AbortNode(strprintf("UTXO set hash %s of the validated chain does not match the snapshot at height %d",
+                             stats.hashSerialized.ToString(), base->nHeight),
+            _("The UTXO snapshot does not match the validated chain. Restart with -reindex-chainstate to discard the snapshot."));
+    }
+
+    LOCK(::cs_main);
+    m_snapshot_validated = true;
+    LogPrintf("[snapshot] snapshot beginning at %s has been fully validated\n", base->GetBlockHash().ToString());
+
+    // The background chainstate is done; its coins cache goes to the active one.
+    chainstate.CoinsTip().EvictToSize(0);
+    MaybeRebalanceCaches();
+    return true;
+}
+
+void ChainstateManager::CleanUpValidatedSnapshot()
+{
+    if (!m_snapshot_validated || !m_snapshot_chainstate->CanFlushToDisk()) return;
+    const fs::path snapshot_dir = SnapshotChainstateDir(m_snapshot_chainstate->m_from_snapshot_blockhash);
+    if (!fs::exists(snapshot_dir)) return; // in-memory (tests)
+
+    m_ibd_chainstate->ForceFlushStateToDisk();
+    m_ibd_chainstate->ResetCoinsViews();
+    m_snapshot_chainstate->ForceFlushStateToDisk();
+    m_snapshot_chainstate->ResetCoinsViews();
+
+    // A crash in between leaves either the snapshot chainstate with its
+    // marker, or the old chainstate without one, which is then removed.
+    const fs::path chainstate_dir = GetDataDir() / "chainstate";
+    const fs::path old_dir = GetDataDir() / "chainstate_background";
+    try {
+        fs::rename(chainstate_dir, old_dir);
+        fs::rename(snapshot_dir, chainstate_dir);
+        fs::remove(chainstate_dir / SNAPSHOT_BLOCKHASH_FILENAME);
+        fs::remove_all(old_dir);
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("[snapshot] failed to replace the background chainstate: %s\n", fsbridge::get_filesystem_error_message(e));
+        return;
+    }
+    LogPrintf("[snapshot] the validated snapshot chainstate is now the chainstate\n");
+}
+
 void ChainstateManager::Unload()
 {
     for (CChainState* chainstate : this->GetAll()) {
@@ -5325,6 +6602,7 @@ void ChainstateManager::Unload()
 
 void ChainstateManager::Reset()
 {
+    StopBackgroundValidation();
     m_ibd_chainstate.reset();
     m_snapshot_chainstate.reset();
     m_active_chainstate = nullptr;
@@ -14,6 +14,7 @@
 #include <coins.h>
 #include <crypto/common.h> // for ReadLE64
 #include <fs.h>
+#include <node/coinstats.h>
 #include <optional.h>
 #include <policy/feerate.h>
 #include <protocol.h> // For CMessageHeader::MessageStartChars
@@ -25,14 +26,18 @@
 #include <serialize.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+class CAutoFile;
 class CChainState;
 class BlockValidationState;
 class CBlockIndex;
@@ -45,7 +50,9 @@ class CScriptCheck;
 class CBlockPolicyEstimator;
 class CTxMemPool;
 class ChainstateManager;
+class SnapshotMetadata;
 class TxValidationState;
+struct AssumeutxoData;
 struct ChainTxData;
 
 struct DisconnectedBlockTransactions;
@@ -70,6 +77,10 @@ static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 15;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -bgvalidationpar default (number of script-checking threads for background validation, 0 = half of -par) */
+static const int DEFAULT_BACKGROUND_SCRIPTCHECK_THREADS = 0;
+/** -bgvalidationdbcache default (percentage of the coins cache used for background validation) */
+static const int DEFAULT_BACKGROUND_VALIDATION_CACHE_PERCENT = 10;
 static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = false;
@@ -77,6 +88,8 @@ static const char* const DEFAULT_BLOCKFILTERINDEX = "0";
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -persistmempoolinterval, minutes between periodic mempool snapshots */
+static const int64_t DEFAULT_PERSIST_MEMPOOL_INTERVAL = 15;
 /** Default for using fee filter */
 static const bool DEFAULT_FEEFILTER = true;
 /** Default for -stopatheight */
@@ -84,6 +97,12 @@ static const int DEFAULT_STOPATHEIGHT = 0;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of ::ChainActive().Tip() will not be pruned. */
 static const unsigned int MIN_BLOCKS_TO_KEEP = 288;
 static const signed int DEFAULT_CHECKBLOCKS = 6;
+/** Default for -trustblockindex */
+static const bool DEFAULT_TRUST_BLOCK_INDEX = false;
+/** Default for -blockindexpowdepth, number of most recent block index entries re-hashed when trusting the index */
+static const int DEFAULT_BLOCK_INDEX_POW_DEPTH = 1440;
+/** Default for -blockindexpowsample, one in this many older entries is re-hashed when trusting the index (0 = none) */
+static const int DEFAULT_BLOCK_INDEX_POW_SAMPLE = 1000;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
 // Require that user allocate at least 550 MiB for block & undo files (blk???.dat and rev???.dat)
 // At 1MB per block, 288 blocks = 288MB.
@@ -165,6 +184,16 @@ bool LoadGenesisBlock(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck(int worker_num);
+/** Run an instance of the script checking thread used for transactions submitted to the mempool */
+void ThreadMempoolScriptCheck(int worker_num);
+/** Run an instance of the script checking thread used while validating the chain below a UTXO snapshot */
+void ThreadBackgroundScriptCheck(int worker_num);
+/** Run an instance of the header hashing thread */
+void ThreadHeaderHashCheck(int worker_num);
+/** Compute the hashes of a batch of headers on the header hashing threads, caching them in the header hash cache */
+void PrecomputeHeaderHashes(const std::vector<CBlockHeader>& headers);
+/** Run an instance of the thread that reads block inputs from the coins database ahead of ConnectBlock */
+void ThreadCoinPrefetch(int worker_num);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransactionRef& tx, const Consensus::Params& params, uint256& hashBlock, const CBlockIndex* const blockIndex = nullptr);
 /**
@@ -196,6 +225,22 @@ bool AcceptToMemoryPool(CTxMemPool& pool, TxValidationState &state, const CTrans
                         std::list<CTransactionRef>* plTxnReplaced,
                         bool bypass_limits, const CAmount nAbsurdFee, bool test_accept=false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/** Like AcceptToMemoryPool, but verifies the scripts of the transaction
+ * without holding cs_main or the mempool lock, so that blocks, RPC calls and
+ * the wallet are not held up meanwhile. Transactions from peers still come in
+ * one at a time on the message handler thread; only transactions with two or
+ * more inputs have their scripts spread over the script check threads. The
+ * script execution cache is not looked up, so a transaction whose scripts
+ * were verified before only saves the signature checks. The transaction is
+ * revalidated if the chain or the mempool changed during the verification. **/
+bool AcceptToMemoryPoolStaged(CTxMemPool& pool, TxValidationState &state, const CTransactionRef &tx,
+                              std::list<CTransactionRef>* plTxnReplaced,
+                              bool bypass_limits, const CAmount nAbsurdFee, bool test_accept=false) LOCKS_EXCLUDED(cs_main);
+
+/** Called by AcceptToMemoryPoolStaged() after the scripts were verified,
+ * before the locks are taken again. Only for tests. */
+extern std::function<void()> g_staged_accept_unlocked_hook;
+
 /** Get the BIP9 state for a given deployment at the current tip. */
 ThresholdState VersionBitsTipState(const Consensus::Params& params, Consensus::DeploymentPos pos);
 
@@ -278,7 +323,9 @@ void InitScriptExecutionCache();
 
 
 /** Functions for disk access for blocks */
+/** Read a block at an arbitrary position; its proof of work is re-checked. */
 bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams);
+/** Read an indexed block; its header is compared against the index instead of being re-hashed. */
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
@@ -395,7 +442,7 @@ public:
     /** Clear all data members. */
     void Unload() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
-    CBlockIndex* AddToBlockIndex(const CBlockHeader& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /** Create a new block index entry for a given block hash */
     CBlockIndex* InsertBlockIndex(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
@@ -405,6 +452,7 @@ public:
      */
     bool AcceptBlockHeader(
         const CBlockHeader& block,
+        const uint256& hash,
         BlockValidationState& state,
         const CChainParams& chainparams,
         CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -524,6 +572,26 @@ public:
     //! is verified).
     void InitCoinsCache() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
+    //! The LevelDB cache size the coins database was opened with.
+    size_t m_coinsdb_cache_size_bytes{0};
+
+    //! The size the in-memory coins cache is flushed at; nCoinCacheUsage
+    //! unless ChainstateManager splits the cache between chainstates.
+    size_t m_coinstip_cache_size_bytes{0};
+
+    //! Rolling statistics of the coins in CoinsTip(), updated as blocks are
+    //! connected and disconnected. Unset when they have to be recomputed from
+    //! the coins database, e.g. after a crash recovery or a snapshot load.
+    Optional<RollingCoinsStats> m_rolling_stats GUARDED_BY(::cs_main);
+
+    /**
+     * Get the statistics of the UTXO set at the tip from m_rolling_stats. If
+     * those are unset, scan the coins database once to recompute them.
+     *
+     * @returns false if the coins database could not be read
+     */
+    bool GetRollingCoinsStats(CCoinsStats& stats, const std::function<void()>& interruption_point) LOCKS_EXCLUDED(::cs_main);
+
     //! @returns whether or not the CoinsViews object has been fully initialized and we can
     //!          safely flush this object to disk.
     bool CanFlushToDisk() EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
@@ -617,9 +685,12 @@ public:
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, BlockValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const FlatFilePos* dbp, bool* fNewBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block (dis)connection on a given view:
-    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view);
+    // When rolling_stats is given, it is updated with the coins the block
+    // spends and creates once the view has been updated successfully.
+    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, RollingCoinsStats* rolling_stats = nullptr);
     bool ConnectBlock(const CBlock& block, BlockValidationState& state, CBlockIndex* pindex,
-                      CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+                      CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false,
+                      RollingCoinsStats* rolling_stats = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Apply the effects of a block disconnection on the UTXO set.
     bool DisconnectTip(BlockValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions* disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::mempool.cs);
@@ -782,6 +853,31 @@ private:
     friend CChainState& ChainstateActive();
     friend CChain& ChainActive();
 
+    //! Load the coins of a UTXO snapshot into snapshot_chainstate, check them
+    //! against the assumeutxo data for the base block's height and fake the
+    //! block index state below the base.
+    bool PopulateAndValidateSnapshot(
+        CChainState& snapshot_chainstate,
+        CAutoFile& coins_file,
+        const SnapshotMetadata& metadata) LOCKS_EXCLUDED(::cs_main);
+
+    //! Compare the UTXO set of the background chainstate, which has reached
+    //! the snapshot base, with the assumeutxo data and mark the snapshot as
+    //! validated. Aborts the node on a mismatch. Only flushes under cs_main;
+    //! the coins are hashed without it.
+    bool CompleteSnapshotValidation(const CBlockIndex* base) LOCKS_EXCLUDED(::cs_main);
+
+    //! Drives background validation; see StartBackgroundValidation().
+    void ThreadBackgroundValidation();
+
+    std::thread m_background_thread;
+    Mutex m_background_mutex;
+    std::condition_variable m_background_cv;
+    //! Set to stop the background validation thread
+    bool m_background_interrupt GUARDED_BY(m_background_mutex){false};
+    //! Set when there may be new blocks for the background chainstate
+    bool m_background_pending GUARDED_BY(m_background_mutex){false};
+
 public:
     //! A single BlockManager instance is shared across each constructed
     //! chainstate to avoid duplicating block metadata.
@@ -798,6 +894,60 @@ public:
     //! Get all chainstates currently being used.
     std::vector<CChainState*> GetAll();
 
+    /**
+     * Load a UTXO snapshot written by dumptxoutset and make it the active
+     * chainstate. The snapshot's coins must hash to the value in the
+     * chainparams for the height of its base block, whose header must
+     * already be known.
+     *
+     * @param[in] in_memory  Keep the snapshot's coins database in memory (for testing).
+     * @returns true if the snapshot chainstate was activated
+     */
+    bool ActivateSnapshot(CAutoFile& coins_file, const SnapshotMetadata& metadata, bool in_memory) LOCKS_EXCLUDED(::cs_main);
+
+    //! Initialize the snapshot chainstate ActivateSnapshot() left in the data
+    //! directory, removing those that were not completely loaded (or all of
+    //! them if wipe is set, for -reindex). Returns whether one was found.
+    bool DetectSnapshotChainstate(bool wipe) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    //! Percentage of the coins cache given to the background chainstate
+    //! while a snapshot is being validated (-bgvalidationdbcache).
+    int m_background_cache_percent{DEFAULT_BACKGROUND_VALIDATION_CACHE_PERCENT};
+
+    //! Split nCoinCacheUsage between the chainstates: the background
+    //! chainstate gets m_background_cache_percent of it until the snapshot
+    //! is validated, the active chainstate the rest. Flushes the caches that
+    //! are over their new size.
+    void MaybeRebalanceCaches() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    /**
+     * Start a thread that validates the chain below an active UTXO snapshot
+     * at a lower scheduling priority, using its own script check threads.
+     * The IBD chainstate connects the blocks up to the snapshot base as they
+     * are downloaded, after which its UTXO set hash is compared with the
+     * snapshot's and the snapshot is marked as validated.
+     */
+    void StartBackgroundValidation();
+    void StopBackgroundValidation();
+
+    //! Wake the background validation thread, e.g. because a block arrived.
+    void NotifyBackgroundValidation();
+
+    /**
+     * Connect the downloaded blocks the background chainstate is missing,
+     * up to the snapshot base, and complete the validation of the snapshot
+     * once the base is reached.
+     *
+     * @returns whether there may be more blocks to connect right away
+     */
+    bool ConnectBackgroundBlocks(const CChainParams& chainparams) LOCKS_EXCLUDED(::cs_main);
+
+    //! After a snapshot has been validated, delete the background chainstate
+    //! and make the snapshot's coins database the regular one, so that the
+    //! next start uses a single chainstate. Called on shutdown, once nothing
+    //! uses the coins databases anymore.
+    void CleanUpValidatedSnapshot() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
     //! The most-work chain.
     CChain& ActiveChain() const;
     int ActiveHeight() const { return ActiveChain().Height(); }
@@ -876,6 +1026,12 @@ public:
     void Reset();
 };
 
+/**
+ * The assumeutxo data for a UTXO snapshot with its base block at the given
+ * height, or nullptr if no such snapshot may be loaded.
+ */
+const AssumeutxoData* ExpectedAssumeutxo(int height, const CChainParams& chainparams);
+
 /** DEPRECATED! Please use node.chainman instead. May only be used in validation.cpp internally */
 extern ChainstateManager g_chainman GUARDED_BY(::cs_main);
 